@@ -0,0 +1,312 @@
+#ifndef BILINEAR_H
+#define BILINEAR_H
+
+#include <math.h>
+#include <stdlib.h>
+#include "mex.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Define the modulo in a more coherent forme than the one from math.h
+#define MOD(x, y) ((x) - (y) * floor((double)(x) / (double)(y)))
+
+// The bilinear interpolation of nvals pixels of an image of any type
+template<typename T>
+void interpolate(const T *img, mwSize h, mwSize w, const double *x_indx,
+                 const double *y_indx, mwSize nvals, int boundary_x, int boundary_y,
+                 double *values) {
+
+  // Declare variable
+  mwSize i;
+  int xf, yf, xc, yc;
+  double dxf, dyf, dxc, dyc, x, y, nanval;
+
+  // The size of the image, signed to be compared with the indexes
+  mwSignedIndex sw = (mwSignedIndex)w, sh = (mwSignedIndex)h;
+
+  // The value of NaN, without the MATLAB API as this may run in parallel
+  nanval = NAN;
+
+  // The bilinear interpolation
+  for (i=0; i < nvals; i++) {
+
+    // Adjust the indexes
+    x = x_indx[i] - 1;
+    y = y_indx[i] - 1;
+
+    // Get the lower index
+    xf = floor(x);
+    yf = floor(y);
+
+    // Its distance to the index
+    dxf = x - xf;
+    dyf = y - yf;
+
+    // Avoid a singularity when the index are rounds, get the upper indexes
+    if (dxf == 0) {
+      xc = xf;
+      dxc = 1;
+    } else {
+      xc = xf + 1;
+      dxc = xc - x;
+    }
+
+    // Same for y
+    if (dyf == 0) {
+      yc = yf;
+      dyc = 1;
+    } else {
+      yc = yf + 1;
+      dyc = yc - y;
+    }
+
+    // Handle the different types of boundary conditions
+    switch (boundary_x) {
+      // Circular
+      case 1 :
+        xf = MOD(xf, sw);
+        xc = MOD(xc, sw);
+
+        break;
+
+      // Replicate
+      case 2 :
+        if (xf >= sw) {
+          xf = sw-1;
+        } else if (xf < 0) {
+          xf = 0;
+        }
+        if (xc >= sw) {
+          xc = sw-1;
+        } else if (xc < 0) {
+          xc = 0;
+        }
+        break;
+
+      // Symmetric
+      case 3 :
+        xf = MOD(xf, 2*sw);
+        xc = MOD(xc, 2*sw);
+
+        if (xf >= sw) {
+         xf = 2*sw - xf - 1;
+        }
+        if (xc >= sw) {
+         xc = 2*sw - xc - 1;
+        }
+        break;
+
+      // NaN outside
+      default :
+        break;
+    }
+
+    // The same for the y index
+    switch (boundary_y) {
+      // Circular
+      case 1 :
+        yf = MOD(yf, sh);
+        yc = MOD(yc, sh);
+
+        break;
+      // Replicate
+      case 2 :
+        if (yf >= sh) {
+          yf = sh-1;
+        } else if (yf < 0) {
+          yf = 0;
+        }
+        if (yc >= sh) {
+          yc = sh-1;
+        } else if (yc < 0) {
+          yc = 0;
+        }
+        break;
+      // Symmetric
+      case 3 :
+        yf = MOD(yf, 2*sh);
+        yc = MOD(yc, 2*sh);
+
+        if (yf >= sh) {
+         yf = 2*sh - yf - 1;
+        }
+        if (yc >= sh) {
+         yc = 2*sh - yc - 1;
+        }
+        break;
+      // NaN outside
+      default :
+        break;
+    }
+
+    // Check whether all indexes are valid
+    if (xf >= sw || yf >= sh || xc < 0 || yc < 0 || xc >= sw || xf < 0 || yc >= sh || yf < 0) {
+      values[i] = nanval;
+
+    // Compute the bilinear interpolation
+    } else {
+      values[i] = img[xf*h + yf] * dxc * dyc +
+                  img[xc*h + yf] * dxf * dyc +
+                  img[xf*h + yc] * dxc * dyf +
+                  img[xc*h + yc] * dxf * dyf;
+    }
+  }
+
+
+  return;
+}
+
+// The bilinear interpolation of the npix pixels of a window lying fully inside the
+// image, at the coordinates (x_grid, y_grid) relative to (x0, y0). No boundary
+// condition is needed, and round coordinates are handled without branching, the
+// pixel being its own upper neighbor as in interpolate. With SSE2, pairs of pixels
+// are interpolated in parallel.
+template<typename T>
+void interpolate_interior(const T *img, mwSize h, const double *x_grid,
+                          const double *y_grid, mwSize npix, double x0, double y0,
+                          double *values) {
+
+  mwSize i = 0;
+  int xf, yf, xc, yc;
+  double x, y, dxf, dyf, dxc, dyc;
+
+#if defined(__SSE2__)
+  __m128d vx, vy, vdxf, vdyf, vdxc, vdyc, vxf, vyf, mask_x, mask_y;
+  __m128d one = _mm_set1_pd(1), zero = _mm_setzero_pd();
+  __m128d cx = _mm_set1_pd(x0), cy = _mm_set1_pd(y0);
+  __m128i ixf, iyf;
+  int xf2[2], yf2[2], xc2[2], yc2[2], inc_x, inc_y;
+
+  for (; i + 1 < npix; i += 2) {
+    vx = _mm_sub_pd(_mm_add_pd(_mm_loadu_pd(x_grid + i), cx), one);
+    vy = _mm_sub_pd(_mm_add_pd(_mm_loadu_pd(y_grid + i), cy), one);
+
+    // Inside the image, the coordinates are positive and truncating them floors them
+    ixf = _mm_cvttpd_epi32(vx);
+    iyf = _mm_cvttpd_epi32(vy);
+    vxf = _mm_cvtepi32_pd(ixf);
+    vyf = _mm_cvtepi32_pd(iyf);
+    vdxf = _mm_sub_pd(vx, vxf);
+    vdyf = _mm_sub_pd(vy, vyf);
+
+    // The distances to the upper indexes, 1 for round coordinates
+    mask_x = _mm_cmpneq_pd(vdxf, zero);
+    mask_y = _mm_cmpneq_pd(vdyf, zero);
+    vdxc = _mm_or_pd(_mm_and_pd(mask_x, _mm_sub_pd(_mm_add_pd(vxf, one), vx)),
+                     _mm_andnot_pd(mask_x, one));
+    vdyc = _mm_or_pd(_mm_and_pd(mask_y, _mm_sub_pd(_mm_add_pd(vyf, one), vy)),
+                     _mm_andnot_pd(mask_y, one));
+
+    // The indexes of the four neighbors of both pixels
+    inc_x = _mm_movemask_pd(mask_x);
+    inc_y = _mm_movemask_pd(mask_y);
+    xf2[0] = _mm_cvtsi128_si32(ixf);
+    xf2[1] = _mm_cvtsi128_si32(_mm_shuffle_epi32(ixf, 1));
+    yf2[0] = _mm_cvtsi128_si32(iyf);
+    yf2[1] = _mm_cvtsi128_si32(_mm_shuffle_epi32(iyf, 1));
+    xc2[0] = xf2[0] + (inc_x & 1);
+    xc2[1] = xf2[1] + (inc_x >> 1);
+    yc2[0] = yf2[0] + (inc_y & 1);
+    yc2[1] = yf2[1] + (inc_y >> 1);
+
+    // The same operations as in interpolate
+    _mm_storeu_pd(values + i, _mm_add_pd(_mm_add_pd(_mm_add_pd(
+      _mm_mul_pd(_mm_mul_pd(_mm_set_pd((double)img[xf2[1]*h + yf2[1]],
+                                       (double)img[xf2[0]*h + yf2[0]]), vdxc), vdyc),
+      _mm_mul_pd(_mm_mul_pd(_mm_set_pd((double)img[xc2[1]*h + yf2[1]],
+                                       (double)img[xc2[0]*h + yf2[0]]), vdxf), vdyc)),
+      _mm_mul_pd(_mm_mul_pd(_mm_set_pd((double)img[xf2[1]*h + yc2[1]],
+                                       (double)img[xf2[0]*h + yc2[0]]), vdxc), vdyf)),
+      _mm_mul_pd(_mm_mul_pd(_mm_set_pd((double)img[xc2[1]*h + yc2[1]],
+                                       (double)img[xc2[0]*h + yc2[0]]), vdxf), vdyf)));
+  }
+#endif
+
+  // The remaining pixels
+  for (; i < npix; i++) {
+    x = x_grid[i] + x0 - 1;
+    y = y_grid[i] + y0 - 1;
+
+    xf = (int)x;
+    yf = (int)y;
+    dxf = x - xf;
+    dyf = y - yf;
+
+    xc = xf + (dxf != 0);
+    yc = yf + (dyf != 0);
+    dxc = (dxf != 0) ? xc - x : 1;
+    dyc = (dyf != 0) ? yc - y : 1;
+
+    values[i] = img[xf*h + yf] * dxc * dyc +
+                img[xc*h + yf] * dxf * dyc +
+                img[xf*h + yc] * dxc * dyf +
+                img[xc*h + yc] * dxf * dyf;
+  }
+
+  return;
+}
+
+// The bilinear interpolation of ncenters windows, the coordinates (x_grid, y_grid) of
+// the npix pixels of the windows being relative to the Nx2 centers. The windows lying
+// fully inside the image are interpolated without any boundary condition, and the
+// windows are processed in parallel if compiled with OpenMP.
+template<typename T>
+void interpolate_windows(const T *img, mwSize h, mwSize w, const double *x_grid,
+                         const double *y_grid, mwSize npix, const double *centers,
+                         mwSize ncenters, int boundary_x, int boundary_y,
+                         double *windows) {
+
+  mwSize i;
+  mwSignedIndex c;
+  double min_x, max_x, min_y, max_y;
+  bool is_finite = true;
+
+  // The extent of the windows
+  min_x = max_x = (npix > 0) ? x_grid[0] : 0;
+  min_y = max_y = (npix > 0) ? y_grid[0] : 0;
+  for (i = 0; i < npix; i++) {
+    is_finite = is_finite && mxIsFinite(x_grid[i]) && mxIsFinite(y_grid[i]);
+    min_x = (x_grid[i] < min_x) ? x_grid[i] : min_x;
+    max_x = (x_grid[i] > max_x) ? x_grid[i] : max_x;
+    min_y = (y_grid[i] < min_y) ? y_grid[i] : min_y;
+    max_y = (y_grid[i] > max_y) ? y_grid[i] : max_y;
+  }
+
+  #pragma omp parallel
+  {
+    double *x_indx = (double *)malloc(2*npix*sizeof(double));
+    double *y_indx = x_indx + npix;
+    double x0, y0;
+    mwSize j;
+
+    #pragma omp for schedule(static)
+    for (c = 0; c < (mwSignedIndex)ncenters; c++) {
+      x0 = centers[c];
+      y0 = centers[c + ncenters];
+
+      // The upper neighbors are at most one pixel further
+      if (is_finite &&
+          floor(min_x + x0 - 1) >= 0 && floor(max_x + x0 - 1) + 1 < (double)w &&
+          floor(min_y + y0 - 1) >= 0 && floor(max_y + y0 - 1) + 1 < (double)h) {
+        interpolate_interior(img, h, x_grid, y_grid, npix, x0, y0, windows + c*npix);
+
+      // Otherwise, the boundary conditions are required
+      } else {
+        for (j = 0; j < npix; j++) {
+          x_indx[j] = x_grid[j] + x0;
+          y_indx[j] = y_grid[j] + y0;
+        }
+        interpolate(img, h, w, x_indx, y_indx, npix, boundary_x, boundary_y,
+                    windows + c*npix);
+      }
+    }
+
+    free(x_indx);
+  }
+
+  return;
+}
+
+#endif
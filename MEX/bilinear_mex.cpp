@@ -0,0 +1,296 @@
+#include "bilinear.h"
+#include "image_types.h"
+#include "mex.h"
+
+// Retrieves the boundary conditions, which can be provided as any numeric or logical
+// array, a single value being used for both dimensions
+static void get_boundaries(const mxArray *arg, int *boundary_x, int *boundary_y) {
+
+  mwSize i, nvals = mxGetNumberOfElements(arg);
+  int vals[2] = {0, 0};
+  const void *data = mxGetData(arg);
+
+  for (i = 0; i < nvals && i < 2; i++) {
+    switch (mxGetClassID(arg)) {
+      case mxLOGICAL_CLASS:
+        vals[i] = (int)((const mxLogical *)data)[i];
+        break;
+      case mxUINT8_CLASS:
+        vals[i] = (int)((const unsigned char *)data)[i];
+        break;
+      case mxUINT16_CLASS:
+        vals[i] = (int)((const unsigned short *)data)[i];
+        break;
+      case mxSINGLE_CLASS:
+        vals[i] = (int)((const float *)data)[i];
+        break;
+      case mxDOUBLE_CLASS:
+        vals[i] = (int)((const double *)data)[i];
+        break;
+      default:
+        mexErrMsgIdAndTxt("CAST:bilinear:invalidInputs",
+            "The boundary conditions must be of type logical, uint8, uint16, single or double.");
+    }
+  }
+
+  *boundary_x = vals[0];
+  *boundary_y = (nvals > 1) ? vals[1] : vals[0];
+
+  return;
+}
+
+// Interpolates the windows defined by the relative coordinates X and Y around each
+// center, returning a stack of windows (see bilinear_mex.m)
+static void interpolate_batch(mxArray *plhs[], const mxArray *prhs[]) {
+
+  int boundary_x, boundary_y;
+  mwSize h, w, npix, ncenters, dims[3];
+
+  // Ensure the types and sizes of the inputs
+  if (!(is_supported_image(prhs[0]) && mxIsDouble(prhs[1]) && mxIsDouble(prhs[2]) &&
+        mxIsDouble(prhs[4]))) {
+    mexErrMsgIdAndTxt("CAST:bilinear:invalidInputs",
+        "The image must be of type uint8, uint16, single or double, the indexes and the centers of type double.");
+  }
+  npix = mxGetNumberOfElements(prhs[1]);
+  if (mxGetNumberOfElements(prhs[2]) != npix) {
+    mexErrMsgIdAndTxt("CAST:bilinear:invalidInputs",
+        "Both indexes must have the same number of elements");
+  }
+  ncenters = mxGetM(prhs[4]);
+  if (ncenters > 0 && mxGetN(prhs[4]) < 2) {
+    mexErrMsgIdAndTxt("CAST:bilinear:invalidInputs",
+        "Centers should be organized as a Nx2 subpixel coordinates table !");
+  }
+
+  // Retrieve the boundary conditions
+  boundary_x = 0;
+  boundary_y = 0;
+  if (!mxIsEmpty(prhs[3])) {
+    get_boundaries(prhs[3], &boundary_x, &boundary_y);
+  }
+
+  // One window per center, stacked along the third dimension
+  dims[0] = mxGetM(prhs[1]);
+  dims[1] = mxGetN(prhs[1]);
+  dims[2] = ncenters;
+  plhs[0] = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+
+  h = mxGetM(prhs[0]);
+  w = mxGetN(prhs[0]);
+
+  switch (mxGetClassID(prhs[0])) {
+    case mxUINT8_CLASS:
+      interpolate_windows((const unsigned char *)mxGetData(prhs[0]), h, w,
+                          mxGetPr(prhs[1]), mxGetPr(prhs[2]), npix, mxGetPr(prhs[4]),
+                          ncenters, boundary_x, boundary_y, mxGetPr(plhs[0]));
+      break;
+    case mxUINT16_CLASS:
+      interpolate_windows((const unsigned short *)mxGetData(prhs[0]), h, w,
+                          mxGetPr(prhs[1]), mxGetPr(prhs[2]), npix, mxGetPr(prhs[4]),
+                          ncenters, boundary_x, boundary_y, mxGetPr(plhs[0]));
+      break;
+    case mxSINGLE_CLASS:
+      interpolate_windows((const float *)mxGetData(prhs[0]), h, w,
+                          mxGetPr(prhs[1]), mxGetPr(prhs[2]), npix, mxGetPr(prhs[4]),
+                          ncenters, boundary_x, boundary_y, mxGetPr(plhs[0]));
+      break;
+    default:
+      interpolate_windows((const double *)mxGetData(prhs[0]), h, w,
+                          mxGetPr(prhs[1]), mxGetPr(prhs[2]), npix, mxGetPr(prhs[4]),
+                          ncenters, boundary_x, boundary_y, mxGetPr(plhs[0]));
+      break;
+  }
+
+  return;
+}
+
+// Bilinear interpolation, main interface
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+  // Declare variable
+  int boundary_x = 0, boundary_y = 0;
+  mwSize i, w, h, m = 0, n = 0;
+  double *x_indx = NULL, *y_indx = NULL, *tmp, *values;
+  bool free_memory = false;
+
+  // The batched mode, which interpolates the same window around several centers
+  if (nrhs == 5) {
+    interpolate_batch(plhs, prhs);
+    return;
+  }
+
+  // Check for proper number of input and output arguments
+  if (nrhs < 2) {
+    mexErrMsgIdAndTxt("CAST:bilinear:invalidInputs",
+        "Not enough input arguments (2 is the minimum) !");
+
+  // In that case, we got an image and a matrix of coordinates
+  } else if (nrhs == 2) {
+
+    // Get the size of the coordinates
+    m = mxGetM(prhs[1]);
+    n = mxGetN(prhs[1]);
+
+    // In that case, the coordinates are properly organized by rows
+    if (n == 2) {
+      x_indx = mxGetPr(prhs[1]);
+      y_indx = x_indx + m;
+
+      // Correct the size of the output
+      n = 1;
+
+    // Otherwise, we need to transpose the matrix
+    } else if (m == 2) {
+
+      // And thus need to allocate memory for the temporary matrix
+      if ((x_indx = (double *)mxCalloc(n, sizeof(double))) == NULL) {
+        mexErrMsgIdAndTxt("CAST:bilinear:invalidInputs", 
+          "Memory allocation failed !");
+      }
+      if ((y_indx = (double *)mxCalloc(n, sizeof(double))) == NULL) {
+        mexErrMsgIdAndTxt("CAST:bilinear:invalidInputs",
+          "Memory allocation failed !");
+      }
+
+      // Copy the data to the new matrix
+      tmp = mxGetPr(prhs[1]);
+      for (i = 0; i < n; i++) {
+        x_indx[i] = tmp[i*2];
+        y_indx[i] = tmp[i*2 + 1];
+      }
+
+      // Correct the size of the output
+      m = 1;
+
+      free_memory = true;
+
+    // Otherwise, something is wrong in the inputs
+    } else {
+      mexErrMsgIdAndTxt("CAST:bilinear:invalidInputs",
+        "Indexes should be organized as a Nx2 subpixel coordinates table !");
+    }
+
+  // Otherwise, X and Y coordinates are provided separately
+  } else if (nrhs == 3) {
+
+    // Maybe we have both indexes together and the boundary conditions aside...
+    if (mxGetNumberOfElements(prhs[1]) != mxGetNumberOfElements(prhs[2])) {
+
+      // Get the size of the coordinates
+      m = mxGetM(prhs[1]);
+      n = mxGetN(prhs[1]);
+
+      // In that case, the coordinates are properly organized by rows
+      if (n == 2) {
+        x_indx = mxGetPr(prhs[1]);
+        y_indx = x_indx + m;
+
+        // Correct the size of the output
+        n = 1;
+
+      // Otherwise, we need to transpose the matrix
+      } else if (m == 2) {
+
+        // And thus need to allocate memory for the temporary matrix
+        if ((x_indx = (double *)mxCalloc(n, sizeof(double))) == NULL) {
+          mexErrMsgIdAndTxt("CAST:bilinear:invalidInputs", 
+            "Memory allocation failed !");
+        }
+        if ((y_indx = (double *)mxCalloc(n, sizeof(double))) == NULL) {
+          mexErrMsgIdAndTxt("CAST:bilinear:invalidInputs",
+            "Memory allocation failed !");
+        }
+
+        // Copy the data to the new matrix
+        tmp = mxGetPr(prhs[1]);
+        for (i = 0; i < n; i++) {
+          x_indx[i] = tmp[i*2];
+          y_indx[i] = tmp[i*2 + 1];
+        }
+
+        // Correct the size of the output
+        m = 1;
+
+        free_memory = true;
+
+      // Otherwise, something is wrong in the inputs
+      } else {
+        mexErrMsgIdAndTxt("CAST:bilinear:invalidInputs",
+          "Both indexes must have the same number of elements");
+      }
+
+      // Retrieve the boundary conditions, which may not be symmetric
+      get_boundaries(prhs[2], &boundary_x, &boundary_y);
+
+    } else {
+      x_indx = mxGetPr(prhs[1]);
+      y_indx = mxGetPr(prhs[2]);
+
+      m = mxGetM(prhs[1]); 
+      n = mxGetN(prhs[1]);
+    }
+
+  // Finally, maybe the boundary conditions are also provided
+  } else if (nrhs == 4) {
+    if (mxGetNumberOfElements(prhs[1]) != mxGetNumberOfElements(prhs[2])) {
+      mexErrMsgIdAndTxt("CAST:bilinear:invalidInputs",
+        "Both indexes must have the same number of elements");
+    }
+    x_indx = mxGetPr(prhs[1]);
+    y_indx = mxGetPr(prhs[2]);
+
+    m = mxGetM(prhs[1]); 
+    n = mxGetN(prhs[1]);
+
+    // Retrieve the boundary conditions, which may not be symmetric
+    get_boundaries(prhs[3], &boundary_x, &boundary_y);
+
+  // Any other number of arguments is invalid
+  } else {
+    mexErrMsgIdAndTxt("CAST:bilinear:invalidInputs",
+        "Too many input arguments (5 is the maximum) !");
+  }
+
+  // Ensure the types of the two first arrays at least
+  if (!(is_supported_image(prhs[0]) && mxIsDouble(prhs[1]))) {
+    mexErrMsgIdAndTxt("CAST:bilinear:invalidInputs",
+        "The image must be of type uint8, uint16, single or double, the indexes of type double.");
+  }
+
+  // Prepare the output
+  plhs[0] = mxCreateDoubleMatrix(m, n, mxREAL);
+  values = mxGetPr(plhs[0]);
+
+  // The size of the image
+  h = mxGetM(prhs[0]);
+  w = mxGetN(prhs[0]);
+
+  // The bilinear interpolation, depending on the type of the image
+  switch (mxGetClassID(prhs[0])) {
+    case mxUINT8_CLASS:
+      interpolate((const unsigned char *)mxGetData(prhs[0]), h, w, x_indx, y_indx, m*n,
+                  boundary_x, boundary_y, values);
+      break;
+    case mxUINT16_CLASS:
+      interpolate((const unsigned short *)mxGetData(prhs[0]), h, w, x_indx, y_indx, m*n,
+                  boundary_x, boundary_y, values);
+      break;
+    case mxSINGLE_CLASS:
+      interpolate((const float *)mxGetData(prhs[0]), h, w, x_indx, y_indx, m*n,
+                  boundary_x, boundary_y, values);
+      break;
+    default:
+      interpolate((const double *)mxGetData(prhs[0]), h, w, x_indx, y_indx, m*n,
+                  boundary_x, boundary_y, values);
+      break;
+  }
+
+  // Free the allocated memory
+  if (free_memory) {
+    mxFree(x_indx);
+    mxFree(y_indx);
+  }
+
+  return;
+}
@@ -4,7 +4,8 @@
 %   PIXS = BILINEAR_MEX(IMG, XCOORD, YCOORD) returns the bilinear interpolation of the
 %   pixel values PIXS from IMG at the provided coordinates (XCOORD, YCOORD) tuples.
 %   PIXS has the same dimensions as XCOORD. Note that coordinates should be provided
-%   as carthesian coordinates, not as matrix indexes !
+%   as carthesian coordinates, not as matrix indexes ! IMG can be of class uint8,
+%   uint16, single or double, PIXS being always double.
 %
 %   PIXS = BILINEAR_MEX(IMG, COORDS) where COORDS is a Nx2 matrix with each row
 %   corresponding to a [X_coord, X_coord] tuple.
@@ -15,6 +16,15 @@
 %   If BOUNDARY has two elements, X and Y behaviors can be defined separately.
 %   By default, both coordinates are set to 0.
 %
+%   WINDOWS = BILINEAR_MEX(IMG, XCOORD, YCOORD, BOUNDARY, CENTERS) interpolates in a
+%   single call the windows defined by the relative coordinates (XCOORD, YCOORD)
+%   around each of the N rows of CENTERS, which first two columns are the [X_coord,
+%   Y_coord] of the centers. WINDOWS is a stack of size [size(XCOORD) N], identical
+%   to calling BILINEAR_MEX(IMG, XCOORD + CENTERS(i,1), YCOORD + CENTERS(i,2),
+%   BOUNDARY) for each center. The windows are processed in parallel if compiled with
+%   OpenMP, and the ones fully inside the image are interpolated without boundary
+%   conditions.
+%
 % Gonczy & Naef labs, EPFL
 % Simon Blanchoud
 % 07.07.2014
@@ -1,18 +1,197 @@
 #include "gaussian_spots.h"
+#include "spatial_grid.h"
 
 #include "gaussian_spots.c"
+#include "spatial_grid.c"
+
+// The data required to compute one column of the cost matrix. The first set of
+// spots is bucketed by frame, each bucket being indexed by its own spatial grid.
+typedef struct {
+  mwSize m1, n1, m2, n2;
+  double *x1, *y1, *t1, *x2, *y2, *t2;
+  double thresh, thresh_lim, thresh2, thresh3, inverse, eps;
+  double first_frame;
+  mwSize nframes;
+  mwIndex *frames, *order;
+  double *xs, *ys;
+  spatial_grid *grids;
+} bridging_data;
+
+// Sorts the first set of spots by frame and builds the spatial grid of each frame
+static void build_frame_buckets(bridging_data *data) {
+
+  mwIndex i, f, *counts;
+  double last_frame, radius;
+
+  data->nframes = 0;
+  data->first_frame = 0;
+  last_frame = -1;
+
+  // The range of frames
+  for (i = 0; i < data->m1; i++) {
+    if (mxIsFinite(data->t1[i])) {
+      if (data->nframes == 0) {
+        data->first_frame = last_frame = floor(data->t1[i]);
+        data->nframes = 1;
+      } else {
+        data->first_frame = __MIN__(data->first_frame, floor(data->t1[i]));
+        last_frame = __MAX__(last_frame, floor(data->t1[i]));
+      }
+    }
+  }
+  if (data->nframes > 0) {
+    data->nframes = (mwSize)(last_frame - data->first_frame) + 1;
+  }
+
+  data->frames = mxCalloc(data->nframes+1, sizeof(mwIndex));
+  data->order = mxCalloc(__MAX__(data->m1, 1), sizeof(mwIndex));
+  data->xs = mxCalloc(__MAX__(data->m1, 1), sizeof(double));
+  data->ys = mxCalloc(__MAX__(data->m1, 1), sizeof(double));
+  data->grids = mxCalloc(__MAX__(data->nframes, 1), sizeof(spatial_grid));
+  counts = mxCalloc(data->nframes+1, sizeof(mwIndex));
+
+  // A counting sort of the spots into the frames
+  for (i = 0; i < data->m1; i++) {
+    if (mxIsFinite(data->t1[i])) {
+      f = (mwIndex)(floor(data->t1[i]) - data->first_frame);
+      data->frames[f+1]++;
+    }
+  }
+  for (f = 0; f < data->nframes; f++) {
+    data->frames[f+1] += data->frames[f];
+  }
+  for (i = 0; i < data->m1; i++) {
+    if (mxIsFinite(data->t1[i])) {
+      f = (mwIndex)(floor(data->t1[i]) - data->first_frame);
+      data->order[data->frames[f] + counts[f]] = i;
+      data->xs[data->frames[f] + counts[f]] = data->x1[i];
+      data->ys[data->frames[f] + counts[f]] = data->y1[i];
+      counts[f]++;
+    }
+  }
+
+  // The largest distance allowed over the longest gap
+  radius = sqrt(__MIN__(data->thresh*data->thresh2, data->thresh_lim));
+
+  for (f = 0; f < data->nframes; f++) {
+    build_spatial_grid(data->grids + f, data->xs + data->frames[f], data->ys + data->frames[f],
+                       data->frames[f+1] - data->frames[f], radius);
+  }
+
+  mxFree(counts);
+
+  return;
+}
+
+// Frees the memory allocated by build_frame_buckets
+static void free_frame_buckets(bridging_data *data) {
+
+  mwIndex f;
+
+  for (f = 0; f < data->nframes; f++) {
+    free_spatial_grid(data->grids + f);
+  }
+
+  mxFree(data->frames);
+  mxFree(data->order);
+  mxFree(data->xs);
+  mxFree(data->ys);
+  mxFree(data->grids);
+
+  return;
+}
+
+// Computes the costs of bridging spot i from the second set to the first one.
+// Returns the number of valid costs, which are only stored if irs is not NULL.
+static mwSize bridging_column(const bridging_data *data, mwIndex i, mwIndex *irs, double *rs) {
+
+  mwIndex j, k, f, cx, cy, cell, range[4];
+  mwSize count;
+  double dist, dist2, signal1, signal2, weight, gaping, first, last, radius;
+  const spatial_grid *grid;
+
+  count = 0;
+
+  if (data->nframes == 0 || !isfinite(data->t2[i])) {
+    return count;
+  }
+
+  // Only the frames within the allowed gap can be bridged
+  first = __MAX__(floor(data->t2[i] - data->thresh2), data->first_frame) - data->first_frame;
+  last = __MIN__(floor(data->t2[i]) - data->first_frame, data->nframes - 1);
+  if (!(first <= last)) {
+    return count;
+  }
+
+  // Get the signal
+  signal2 = data->x2[i + (data->n2-3)*data->m2];
+
+  // Now parse the other spots, frame by frame
+  for (f = (mwIndex)first; f <= (mwIndex)last; f++) {
+    grid = data->grids + f;
+
+    // The spatial threshold depends on the length of the gap
+    radius = sqrt(__MIN__(data->thresh*(data->t2[i] - (f + data->first_frame)), data->thresh_lim));
+    if (!get_grid_range(grid, data->x2[i], data->y2[i], radius, range)) {
+      continue;
+    }
+
+    for (cx = range[0]; cx <= range[1]; cx++) {
+      for (cy = range[2]; cy <= range[3]; cy++) {
+        cell = cx*grid->ny + cy;
+
+        for (k = grid->cells[cell]; k < grid->cells[cell+1]; k++) {
+          j = data->order[data->frames[f] + grid->indexes[k]];
+          dist2 = data->t2[i]-data->t1[j];
+
+          dist = (__SQR__(data->x2[i]-data->x1[j]) + __SQR__(data->y2[i]-data->y1[j]));
+
+          // Only if it passes the thresholds
+          if (dist <= __MIN__(data->thresh*dist2, data->thresh_lim) && dist2 <= data->thresh2 && dist2 > 0) {
+
+            // Get the other signal
+            signal1 = data->x1[j + (data->n1-3)*data->m1];
+
+            // The weight
+            weight = __WGT__(signal2 / signal1);
+
+            // Enforce the intensity threshold
+            if (weight <= data->thresh3) {
+
+              // Store it in the matrix
+              if (irs != NULL) {
+
+                // Add a time-favoring component
+                gaping = __SQR__(dist2 / data->thresh2);
+
+                rs[count] = __MAX__(data->inverse*(dist + gaping), data->eps);
+                irs[count] = j;
+              }
+
+              count++;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Sparse matrices require sorted row indexes
+  if (irs != NULL) {
+    sort_column(irs, rs, count);
+  }
+
+  return count;
+}
 
 // The main of the MATLAB interface
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 {
   // Declare variable
-  mwSize m1,n1, m2, n2;
-  mwSize nzmax, nzstep, nzfull;
-  mwIndex *irs,*jcs,i,j, count;
-  double *x1,*y1,*t1,*x2,*y2,*t2,*rs;
-  double dist, dist2, thresh, thresh_lim, thresh2, thresh3, signal1, signal2;
-  double weight, gaping, inverse, eps;
-  bool is_test;
+  mwSignedIndex i;
+  mwIndex *irs,*jcs,*counts;
+  double *rs;
+  bridging_data data;
 
   // Check for proper number of input and output arguments
   if (nrhs != 6) {
@@ -27,97 +206,57 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
   }
 
   // Get the size and pointers to input data
-  m1  = mxGetM(prhs[0]);
-  n1  = mxGetN(prhs[0]);
+  data.m1  = mxGetM(prhs[0]);
+  data.n1  = mxGetN(prhs[0]);
 
   // Get the different pointers to the various columns of data
-  x1  = mxGetPr(prhs[0]);
-  y1  = x1 + m1;
-  t1  = x1 + (n1-1)*m1;
+  data.x1  = mxGetPr(prhs[0]);
+  data.y1  = data.x1 + data.m1;
+  data.t1  = data.x1 + (data.n1-1)*data.m1;
 
   // Same for the other matrix
-  m2  = mxGetM(prhs[1]);
-  n2  = mxGetN(prhs[1]);
+  data.m2  = mxGetM(prhs[1]);
+  data.n2  = mxGetN(prhs[1]);
 
-  x2  = mxGetPr(prhs[1]);
-  y2  = x2 + m2;
-  t2  = x2 + (n2-1)*m2;
+  data.x2  = mxGetPr(prhs[1]);
+  data.y2  = data.x2 + data.m2;
+  data.t2  = data.x2 + (data.n2-1)*data.m2;
 
   // Get the thresholds
-  thresh = 2*mxGetScalar(prhs[2]);
-  inverse = __MAX__(1/__SQR__(thresh), 0.001);
-  thresh2 = mxGetScalar(prhs[3]);
-  thresh_lim = __SQR__(mxGetScalar(prhs[4]));
-  thresh3 = mxGetScalar(prhs[5]);
+  data.thresh = 2*mxGetScalar(prhs[2]);
+  data.inverse = __MAX__(1/__SQR__(data.thresh), 0.001);
+  data.thresh2 = mxGetScalar(prhs[3]);
+  data.thresh_lim = __SQR__(mxGetScalar(prhs[4]));
+  data.thresh3 = mxGetScalar(prhs[5]);
 
   // And our zero value
-  eps = mxGetEps();
+  data.eps = mxGetEps();
 
-  // A guess on the number of elements needed
-  nzmax=(mwSize)ceil((double)m1*(double)m2*0.1);
-  nzstep=(mwSize)__MAX__(ceil((double)nzmax*0.25),1);
-  nzfull=m1*m2;
+  // Group the first set of spots by frame, such that each spot of the second set
+  // only compares to the close ones within the allowed gap
+  build_frame_buckets(&data);
+
+  // First count the number of elements in each column, to allocate exactly the
+  // required memory, then fill them. Columns are independent so both passes can
+  // be run in parallel.
+  counts = mxCalloc(data.m2+1, sizeof(mwIndex));
+
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (i = 0; i < (mwSignedIndex)data.m2; i++) {
+    counts[i+1] = bridging_column(&data, i, NULL, NULL);
+  }
 
   // Prepare the output
-  plhs[0] = mxCreateSparse(m1,m2,nzmax,false);
+  plhs[0] = create_sparse_from_counts(data.m1, data.m2, counts);
   rs  = mxGetPr(plhs[0]);
   irs = mxGetIr(plhs[0]);
   jcs = mxGetJc(plhs[0]);
 
-  // Need to count the number of elements inserted in the sparse matrix
-  count = 0;
-  for (i = 0; i < m2; i++) {
-
-    // Get the signal
-    signal2 = x2[i + (n2-3)*m2];
-
-    // The number of elements up to the current column
-    jcs[i] = count;
-
-    // Now parse the other spots
-    for (j = 0; j < m1; j++) {
-      dist2 = t2[i]-t1[j];
-
-      dist = (__SQR__(x2[i]-x1[j]) + __SQR__(y2[i]-y1[j]));
-
-      // Only if it passes the thresholds
-      if (dist <= __MIN__(thresh*dist2, thresh_lim) && dist2 <= thresh2 && dist2 > 0) {
-
-        // Get the other signal
-        signal1 = x1[j + (n1-3)*m1];
-
-        // The weight
-        weight = __WGT__(signal2 / signal1);
-
-        // Enforce the intensity threshold
-        if (weight <= thresh3) {
-
-          // Add a time-favoring component
-          gaping = __SQR__(dist2 / thresh2);
-
-          // Here we might need to increase the number of elements in the matrix
-          if (count >= nzmax){
-            nzmax += nzstep;
-            nzmax = __MIN__(nzmax, nzfull);
-
-            mxSetNzmax(plhs[0], nzmax);
-            mxSetPr(plhs[0], mxRealloc(rs, nzmax*sizeof(double)));
-            mxSetIr(plhs[0], mxRealloc(irs, nzmax*sizeof(mwIndex)));
-
-            rs  = mxGetPr(plhs[0]);
-            irs = mxGetIr(plhs[0]);
-          }
-
-          // Store it in the matrix
-          rs[count] = __MAX__(inverse*(dist + gaping), eps);
-          irs[count] = j;
-
-          count++;
-        }
-      }
-    }
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (i = 0; i < (mwSignedIndex)data.m2; i++) {
+    bridging_column(&data, i, irs + jcs[i], rs + jcs[i]);
   }
 
-  // Requried to finalize the sparse matrix
-  jcs[m2] = count;
+  mxFree(counts);
+  free_frame_buckets(&data);
 }
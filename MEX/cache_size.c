@@ -0,0 +1,57 @@
+#include <stdlib.h>
+#include "cache_size.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#else
+#include <unistd.h>
+#endif
+
+// Retrieves the size of the L2 cache of the processor, in bytes, falling back to
+// DEFAULT_L2_SIZE if the system does not provide it
+unsigned long l2_cache_size(void) {
+
+  unsigned long size = 0;
+
+#if defined(_WIN32)
+  DWORD i, len = 0;
+  SYSTEM_LOGICAL_PROCESSOR_INFORMATION *info;
+
+  // Windows lists the caches along with the other processor informations
+  GetLogicalProcessorInformation(NULL, &len);
+  info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION *)malloc(len);
+  if (info != NULL) {
+    if (GetLogicalProcessorInformation(info, &len)) {
+      for (i = 0; i < len / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION); i++) {
+        if (info[i].Relationship == RelationCache && info[i].Cache.Level == 2) {
+          size = info[i].Cache.Size;
+          break;
+        }
+      }
+    }
+    free(info);
+  }
+#elif defined(__APPLE__)
+  unsigned long long value = 0;
+  size_t len = sizeof(value);
+
+  if (sysctlbyname("hw.l2cachesize", &value, &len, NULL, 0) == 0) {
+    size = (unsigned long)value;
+  }
+#elif defined(_SC_LEVEL2_CACHE_SIZE)
+  long value = sysconf(_SC_LEVEL2_CACHE_SIZE);
+
+  if (value > 0) {
+    size = (unsigned long)value;
+  }
+#endif
+
+  if (size == 0) {
+    size = DEFAULT_L2_SIZE;
+  }
+
+  return size;
+}
@@ -0,0 +1,17 @@
+#ifndef CACHE_SIZE_H
+#define CACHE_SIZE_H
+
+// The L2 size assumed when the system does not provide it, in bytes
+#define DEFAULT_L2_SIZE 256*1024
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+unsigned long l2_cache_size(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
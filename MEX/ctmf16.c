@@ -0,0 +1,272 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ctmf16.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// A 16 bits extension of the constant-time median filter of ctmf.c, see [1]. The
+// histograms have three tiers: the coarse one counts the 4 most significant bits, the
+// medium one the 8 most significant ones and the fine one all of them. As in [1], the
+// coarse and medium tiers are kept for each column, the segments of the medium tier
+// being updated lazily in the kernel. A fine histogram per column would however not
+// fit in any cache (128kB each), hence the fine segment containing the median is
+// updated lazily from the pixels of the columns entering and leaving the kernel,
+// which are buffered for each column. Only the pixels of the columns counting some
+// in this segment are visited, hence this update costs O(r) only when most of the
+// kernel falls into one segment. The fine segments count in addition their pixels
+// per group of 16 values, to find the median quickly.
+//
+// [1] S. Perreault and P. Hebert, "Median Filtering in Constant Time",
+//     IEEE Transactions on Image Processing, September 2007.
+
+// Clamp an index inside [0, n-1], the borders of the image being replicated
+#define CTMF16_CLAMP(x, n) ((x) < 0 ? 0 : ((x) >= (n) ? (n)-1 : (x)))
+
+// The histogram of the kernel, with the last column at which each segment was updated
+typedef struct {
+  uint16_t coarse[16];
+  uint16_t medium[16][16];
+  uint16_t fine[256][16];
+  uint16_t finest[256][256];
+  int luc_medium[16];
+  int luc_fine[256];
+} kernel_histogram;
+
+// Adds (or subtracts) a 16 bins histogram to another one
+static inline void histogram16_add(const uint16_t *x, uint16_t *y) {
+#if defined(__SSE2__)
+  _mm_storeu_si128((__m128i *)(y), _mm_add_epi16(_mm_loadu_si128((const __m128i *)(y)),
+                                                 _mm_loadu_si128((const __m128i *)(x))));
+  _mm_storeu_si128((__m128i *)(y+8), _mm_add_epi16(_mm_loadu_si128((const __m128i *)(y+8)),
+                                                   _mm_loadu_si128((const __m128i *)(x+8))));
+#else
+  int i;
+  for (i = 0; i < 16; i++) {
+    y[i] += x[i];
+  }
+#endif
+}
+static inline void histogram16_sub(const uint16_t *x, uint16_t *y) {
+#if defined(__SSE2__)
+  _mm_storeu_si128((__m128i *)(y), _mm_sub_epi16(_mm_loadu_si128((const __m128i *)(y)),
+                                                 _mm_loadu_si128((const __m128i *)(x))));
+  _mm_storeu_si128((__m128i *)(y+8), _mm_sub_epi16(_mm_loadu_si128((const __m128i *)(y+8)),
+                                                   _mm_loadu_si128((const __m128i *)(x+8))));
+#else
+  int i;
+  for (i = 0; i < 16; i++) {
+    y[i] -= x[i];
+  }
+#endif
+}
+
+// Finds the bin of a 16 bins histogram containing the median, sum being the number
+// of values in the previous bins
+static inline int histogram16_median(const uint16_t *h, int *sum, int thresh) {
+  int b;
+
+  for (b = 0; b < 15; b++) {
+    if (*sum + h[b] > thresh) {
+      break;
+    }
+    *sum += h[b];
+  }
+
+  return b;
+}
+
+// Updates the fine segment "bucket" with the buffered pixels of one column, count of
+// which belonging to this segment, as provided by the medium histogram of the column
+static inline void update_segment(const uint16_t *column, int count, int bucket, int delta,
+                                  kernel_histogram *H) {
+  int k;
+  uint16_t value;
+
+  for (k = 0; count > 0; k++) {
+    value = column[k];
+    if ((value >> 8) == bucket) {
+      H->fine[bucket][(value >> 4) & 0xF] += delta;
+      H->finest[bucket][value & 0xFF] += delta;
+      count--;
+    }
+  }
+}
+
+// Filters the columns [j0, j1) of the image, the kernel spanning the whole image
+static void ctmf16_stripe(const uint16_t *src, uint16_t *dst, int width, int height,
+                          int src_step, int dst_step, int r, int j0, int j1) {
+
+  const int thresh = 2*r*r + 2*r, size = 2*r + 1;
+  int i, j, k, c, m, f, x, xmin, xmax, ncols, slot, sum, from, count, value;
+  const uint16_t *prev, *next;
+  uint16_t *h_coarse, *h_medium, *columns, *col;
+  kernel_histogram *H;
+
+  // The columns of the image required for this stripe
+  xmin = (j0 - r < 0) ? 0 : j0 - r;
+  xmax = (j1 - 1 + r >= width) ? width - 1 : j1 - 1 + r;
+  ncols = xmax - xmin + 1;
+
+  // The histograms of each column, and the pixels of their vertical window
+  h_coarse = (uint16_t *)calloc((size_t)ncols * 16, sizeof(uint16_t));
+  h_medium = (uint16_t *)calloc((size_t)ncols * 256, sizeof(uint16_t));
+  columns = (uint16_t *)malloc((size_t)ncols * size * sizeof(uint16_t));
+  H = (kernel_histogram *)malloc(sizeof(kernel_histogram));
+
+  // Initialize the columns, the first row being replicated. The window position y
+  // is buffered in the slot (y+r) modulo size.
+  for (i = -r; i <= r; i++) {
+    prev = src + (size_t)CTMF16_CLAMP(i, height) * src_step;
+    for (x = xmin; x <= xmax; x++) {
+      value = prev[x];
+      h_coarse[(size_t)(x - xmin)*16 + (value >> 12)]++;
+      h_medium[(size_t)(x - xmin)*256 + (value >> 8)]++;
+      columns[(size_t)(x - xmin)*size + i + r] = (uint16_t)value;
+    }
+  }
+
+  for (i = 0; i < height; i++) {
+
+    // Slide the columns by one row, the new pixel replacing the old one in the buffer
+    if (i > 0) {
+      prev = src + (size_t)CTMF16_CLAMP(i - r - 1, height) * src_step;
+      next = src + (size_t)CTMF16_CLAMP(i + r, height) * src_step;
+      slot = (i + 2*r) % size;
+      for (x = xmin; x <= xmax; x++) {
+        h_coarse[(size_t)(x - xmin)*16 + (prev[x] >> 12)]--;
+        h_medium[(size_t)(x - xmin)*256 + (prev[x] >> 8)]--;
+        h_coarse[(size_t)(x - xmin)*16 + (next[x] >> 12)]++;
+        h_medium[(size_t)(x - xmin)*256 + (next[x] >> 8)]++;
+        columns[(size_t)(x - xmin)*size + slot] = next[x];
+      }
+    }
+
+    // Initialize the kernel, all segments being outdated
+    memset(H->coarse, 0, sizeof(H->coarse));
+    for (x = j0 - r; x <= j0 + r; x++) {
+      histogram16_add(h_coarse + (size_t)(CTMF16_CLAMP(x, width) - xmin)*16, H->coarse);
+    }
+    for (k = 0; k < 16; k++) {
+      H->luc_medium[k] = j0 - size;
+    }
+    for (k = 0; k < 256; k++) {
+      H->luc_fine[k] = j0 - size;
+    }
+
+    for (j = j0; j < j1; j++) {
+
+      // Slide the kernel by one column
+      if (j > j0) {
+        histogram16_add(h_coarse + (size_t)(CTMF16_CLAMP(j + r, width) - xmin)*16, H->coarse);
+        histogram16_sub(h_coarse + (size_t)(CTMF16_CLAMP(j - r - 1, width) - xmin)*16, H->coarse);
+      }
+
+      // Find the median at the coarse level
+      sum = 0;
+      c = histogram16_median(H->coarse, &sum, thresh);
+
+      // Update the corresponding medium segment, from scratch if the kernel has
+      // moved too far since its last update
+      if (2*(j - H->luc_medium[c]) > size) {
+        memset(H->medium[c], 0, 16 * sizeof(uint16_t));
+        for (x = j - r; x <= j + r; x++) {
+          histogram16_add(h_medium + (size_t)(CTMF16_CLAMP(x, width) - xmin)*256 + 16*c, H->medium[c]);
+        }
+      } else {
+        for (x = H->luc_medium[c] + 1; x <= j; x++) {
+          histogram16_sub(h_medium + (size_t)(CTMF16_CLAMP(x - r - 1, width) - xmin)*256 + 16*c, H->medium[c]);
+          histogram16_add(h_medium + (size_t)(CTMF16_CLAMP(x + r, width) - xmin)*256 + 16*c, H->medium[c]);
+        }
+      }
+      H->luc_medium[c] = j;
+      m = histogram16_median(H->medium[c], &sum, thresh);
+
+      // Same for the fine segment, using the buffered pixels
+      k = 16*c + m;
+      if (2*(j - H->luc_fine[k]) > size) {
+        memset(H->fine[k], 0, 16 * sizeof(uint16_t));
+        memset(H->finest[k], 0, 256 * sizeof(uint16_t));
+        from = j - r;
+      } else {
+        from = H->luc_fine[k] + r + 1;
+        for (x = H->luc_fine[k] + 1; x <= j; x++) {
+          col = columns + (size_t)(CTMF16_CLAMP(x - r - 1, width) - xmin)*size;
+          count = h_medium[(size_t)(CTMF16_CLAMP(x - r - 1, width) - xmin)*256 + k];
+          update_segment(col, count, k, -1, H);
+        }
+      }
+      for (x = from; x <= j + r; x++) {
+        col = columns + (size_t)(CTMF16_CLAMP(x, width) - xmin)*size;
+        count = h_medium[(size_t)(CTMF16_CLAMP(x, width) - xmin)*256 + k];
+        update_segment(col, count, k, 1, H);
+      }
+      H->luc_fine[k] = j;
+
+      // And find the median in the segment
+      f = histogram16_median(H->fine[k], &sum, thresh);
+      m = histogram16_median(H->finest[k] + 16*f, &sum, thresh);
+
+      dst[(size_t)i*dst_step + j] = (uint16_t)((k << 8) | (f << 4) | m);
+    }
+  }
+
+  free(H);
+  free(columns);
+  free(h_medium);
+  free(h_coarse);
+}
+
+// Constant-time median filtering of a 16 bits image, with a kernel of 2*r+1 square.
+// As in ctmf.c, the image is processed in vertical stripes, such that the histograms
+// of one stripe fit into memsize bytes, and rows are separated by src_step pixels.
+// The borders of the image are replicated. Stripes are processed in parallel, hence
+// there are at least as many stripes as threads. Note that the histograms count
+// using 16 bits, which limits r to 127.
+void ctmf16(const uint16_t *src, uint16_t *dst, int width, int height,
+            int src_step, int dst_step, int r, unsigned long memsize) {
+
+  int nstripes, stripe_size, nthreads = 1;
+  long ncols;
+  int s;
+
+  // The number of columns fitting in the memory, along with the kernel histogram
+  ncols = ((long)memsize - (long)sizeof(kernel_histogram)) / (long)((16 + 256 + 2*r + 1) * sizeof(uint16_t)) - 2*r;
+  if (ncols < 2*r + 1) {
+    ncols = 2*r + 1;
+  }
+  nstripes = (int)((width + ncols - 1) / ncols);
+
+  // Use all threads, as long as the stripes remain larger than their overlap
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
+#endif
+  if (nstripes < nthreads) {
+    int nparallel = width / (4*r + 1);
+    nparallel = (nparallel > nthreads) ? nthreads : nparallel;
+
+    // Never fewer stripes than required for the histograms to fit in the cache
+    nstripes = (nparallel > nstripes) ? nparallel : nstripes;
+  }
+  if (nstripes < 1) {
+    nstripes = 1;
+  }
+  stripe_size = (width + nstripes - 1) / nstripes;
+
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (s = 0; s < nstripes; s++) {
+    int j0 = (int)s * stripe_size,
+        j1 = (j0 + stripe_size > width) ? width : j0 + stripe_size;
+
+    if (j0 < j1) {
+      ctmf16_stripe(src, dst, width, height, src_step, dst_step, r, j0, j1);
+    }
+  }
+
+  return;
+}
@@ -0,0 +1,21 @@
+#ifndef CTMF16_H
+#define CTMF16_H
+
+#ifdef _MSC_VER
+typedef unsigned __int16 uint16_t;
+#else
+#include <stdint.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void ctmf16(const uint16_t *src, uint16_t *dst, int width, int height,
+            int src_step, int dst_step, int r, unsigned long memsize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
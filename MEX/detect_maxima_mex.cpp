@@ -0,0 +1,287 @@
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include "image_types.h"
+#include "mex.h"
+
+#define __MAX__(A, B)     ((A)>=(B)? (A) : (B))
+
+// Computes the maximum over a window of 2*radius+1 values along a line of n values
+// separated by step, using the van Herk/Gil-Werman algorithm which requires three
+// comparisons per value independently of the size of the window. NaN values and the
+// values outside of the line are ignored. buf, prefix and suffix must hold n+4*radius
+// values.
+static void max_line(const double *line, double *res, mwSize n, mwSize step, mwSize radius,
+                     double *buf, double *prefix, double *suffix) {
+
+  mwSize i, size = 2*radius + 1, len;
+  double val;
+
+  // The padded line, rounded to a multiple of the window size
+  len = ((n + 2*radius + size - 1) / size) * size;
+  for (i = 0; i < len; i++) {
+    buf[i] = -HUGE_VAL;
+  }
+  for (i = 0; i < n; i++) {
+    val = line[i*step];
+    if (!isnan(val)) {
+      buf[i+radius] = val;
+    }
+  }
+
+  // The running maxima from the beginning and the end of each block
+  for (i = 0; i < len; i++) {
+    prefix[i] = (i % size == 0 || buf[i] > prefix[i-1]) ? buf[i] : prefix[i-1];
+  }
+  for (i = len; i-- > 0;) {
+    suffix[i] = (i % size == size-1 || buf[i] > suffix[i+1]) ? buf[i] : suffix[i+1];
+  }
+
+  // Every window overlaps at most two blocks
+  for (i = 0; i < n; i++) {
+    res[i*step] = (suffix[i] > prefix[i+2*radius]) ? suffix[i] : prefix[i+2*radius];
+  }
+
+  return;
+}
+
+// Computes the sum over a window of 2*radius+1 values along a line of n values
+// separated by step, the values outside of the line being zero as in imfilter. As
+// non-finite values would corrupt the running sum, the windows containing any are
+// summed directly.
+static void sum_line(const double *line, double *res, mwSize n, mwSize step, mwSize radius) {
+
+  mwSignedIndex i, k, r = radius, len = n, nbad = 0;
+  double sum = 0, val;
+
+  for (i = 0; i < r && i < len; i++) {
+    val = line[i*step];
+    if (isfinite(val)) {
+      sum += val;
+    } else {
+      nbad++;
+    }
+  }
+  for (i = 0; i < len; i++) {
+    if (i + r < len) {
+      val = line[(i+r)*step];
+      if (isfinite(val)) {
+        sum += val;
+      } else {
+        nbad++;
+      }
+    }
+    if (i - r - 1 >= 0) {
+      val = line[(i-r-1)*step];
+      if (isfinite(val)) {
+        sum -= val;
+      } else {
+        nbad--;
+      }
+    }
+
+    if (nbad > 0) {
+      res[i*step] = 0;
+      for (k = __MAX__(i-r, 0); k <= i+r && k < len; k++) {
+        res[i*step] += line[k*step];
+      }
+    } else {
+      res[i*step] = sum;
+    }
+  }
+
+  return;
+}
+
+// Identifies the local maxima of an image, see detect_maxima_mex.m
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+  mwSize h, w, nelem, radius_y, radius_x, size, buf_size, nmax, i;
+  mwSignedIndex x;
+  double *tmp, intens_thresh = 0, *img, *maxs, *avgs = NULL, *dets = NULL, *out;
+  std::vector<unsigned char> is_max;
+  std::vector<mwIndex> maxima;
+
+  // Check for proper number of input and output arguments
+  if (nrhs < 2) {
+    mexErrMsgIdAndTxt("CAST:detect_maxima_mex:invalidNumInputs",
+        "At least two input arguments required.");
+  }
+  if (!is_supported_image(prhs[0]) || mxGetNumberOfDimensions(prhs[0]) > 2) {
+    mexErrMsgIdAndTxt("CAST:detect_maxima_mex:invalidInput",
+        "Input argument (1) must be a 2D image of type uint8, uint16, single or double.");
+  }
+
+  h = mxGetM(prhs[0]);
+  w = mxGetN(prhs[0]);
+  nelem = h*w;
+  // The radii along the rows and the columns, as in ones(2*radius+1)
+  if (!mxIsDouble(prhs[1]) || mxIsEmpty(prhs[1])) {
+    mexErrMsgIdAndTxt("CAST:detect_maxima_mex:invalidInput",
+        "Input argument (2) must be a double scalar or a pair of doubles.");
+  }
+  tmp = mxGetPr(prhs[1]);
+  radius_y = (tmp[0] > 0) ? (mwSize)tmp[0] : 0;
+  radius_x = radius_y;
+  if (mxGetNumberOfElements(prhs[1]) > 1) {
+    radius_x = (tmp[1] > 0) ? (mwSize)tmp[1] : 0;
+  }
+  size = (2*radius_y + 1) * (2*radius_x + 1);
+  buf_size = __MAX__(h, w) + 4*__MAX__(radius_y, radius_x);
+
+  if (nrhs > 2 && !mxIsEmpty(prhs[2])) {
+    intens_thresh = mxGetScalar(prhs[2]);
+  }
+  if (nrhs > 3 && !mxIsEmpty(prhs[3])) {
+    if (!mxIsDouble(prhs[3]) || mxGetM(prhs[3]) != h || mxGetN(prhs[3]) != w) {
+      mexErrMsgIdAndTxt("CAST:detect_maxima_mex:invalidInput",
+          "Input argument (4) must be a double matrix of the same size as the image.");
+    }
+    dets = mxGetPr(prhs[3]);
+  }
+
+  img = (double *)mxMalloc(nelem*sizeof(double));
+  maxs = (double *)mxMalloc(nelem*sizeof(double));
+  copy_image(prhs[0], img);
+
+  // The separable maximum filter, first along the columns then along the rows
+  #pragma omp parallel
+  {
+    double *buf = (double *)malloc(3*buf_size*sizeof(double));
+    double *prefix = buf + buf_size;
+    double *suffix = prefix + buf_size;
+    mwSignedIndex j;
+
+    #pragma omp for schedule(static)
+    for (j = 0; j < (mwSignedIndex)w; j++) {
+      max_line(img + j*h, maxs + j*h, h, 1, radius_y, buf, prefix, suffix);
+    }
+    #pragma omp for schedule(static)
+    for (j = 0; j < (mwSignedIndex)h; j++) {
+      max_line(maxs + j, maxs + j, w, h, radius_x, buf, prefix, suffix);
+    }
+
+    free(buf);
+  }
+
+  // The local average, using running sums
+  if (intens_thresh > 0) {
+    avgs = (double *)mxMalloc(nelem*sizeof(double));
+
+    #pragma omp parallel for schedule(static)
+    for (x = 0; x < (mwSignedIndex)w; x++) {
+      sum_line(img + x*h, avgs + x*h, h, 1, radius_y);
+    }
+    #pragma omp parallel
+    {
+      double *row = (double *)malloc(2*w*sizeof(double));
+      double *sums = row + w;
+      mwSignedIndex j;
+      mwSize k;
+
+      // The rows are copied as the running sum cannot be computed in place
+      #pragma omp for schedule(static)
+      for (j = 0; j < (mwSignedIndex)h; j++) {
+        for (k = 0; k < w; k++) {
+          row[k] = avgs[j + k*h];
+        }
+        sum_line(row, sums, w, 1, radius_x);
+        for (k = 0; k < w; k++) {
+          avgs[j + k*h] = sums[k];
+        }
+      }
+
+      free(row);
+    }
+  }
+
+  // The candidate maxima, which are at least as large as their neighborhood
+  is_max.resize(nelem, 0);
+
+  #pragma omp parallel for schedule(static)
+  for (x = 0; x < (mwSignedIndex)nelem; x++) {
+    is_max[x] = (img[x] >= maxs[x] &&
+                 (dets == NULL || dets[x] > 0) &&
+                 (avgs == NULL || avgs[x] / size >= intens_thresh));
+  }
+
+  // Plateaus are reduced to the pixel closest to their center
+  std::vector<mwIndex> stack, plateau;
+  for (i = 0; i < nelem; i++) {
+    if (is_max[i] != 1) {
+      continue;
+    }
+
+    // Gather the 8-connected plateau
+    plateau.clear();
+    stack.push_back(i);
+    is_max[i] = 2;
+    while (!stack.empty()) {
+      mwIndex curr = stack.back(), cx = curr / h, cy = curr % h;
+      mwSignedIndex dx, dy, nx, ny;
+      stack.pop_back();
+      plateau.push_back(curr);
+
+      for (dx = -1; dx <= 1; dx++) {
+        nx = cx + dx;
+        if (nx < 0 || nx >= (mwSignedIndex)w) {
+          continue;
+        }
+        for (dy = -1; dy <= 1; dy++) {
+          ny = cy + dy;
+          if (ny < 0 || ny >= (mwSignedIndex)h || is_max[nx*h + ny] != 1) {
+            continue;
+          }
+          is_max[nx*h + ny] = 2;
+          stack.push_back(nx*h + ny);
+        }
+      }
+    }
+
+    if (plateau.size() == 1) {
+      maxima.push_back(i);
+    } else {
+      mwSize k, best = 0;
+      double mean_x = 0, mean_y = 0, dist, best_dist = mxGetInf();
+
+      std::sort(plateau.begin(), plateau.end());
+      for (k = 0; k < plateau.size(); k++) {
+        mean_x += plateau[k] / h;
+        mean_y += plateau[k] % h;
+      }
+      mean_x /= plateau.size();
+      mean_y /= plateau.size();
+
+      for (k = 0; k < plateau.size(); k++) {
+        dist = (plateau[k] / h - mean_x)*(plateau[k] / h - mean_x) +
+               (plateau[k] % h - mean_y)*(plateau[k] % h - mean_y);
+        if (dist < best_dist) {
+          best_dist = dist;
+          best = k;
+        }
+      }
+      maxima.push_back(plateau[best]);
+    }
+  }
+
+  // Sorted as find would do
+  std::sort(maxima.begin(), maxima.end());
+  nmax = maxima.size();
+
+  // The carthesian coordinates of the maxima
+  plhs[0] = mxCreateDoubleMatrix(nmax, 2, mxREAL);
+  out = mxGetPr(plhs[0]);
+  for (i = 0; i < nmax; i++) {
+    out[i] = maxima[i] / h + 1;
+    out[i + nmax] = maxima[i] % h + 1;
+  }
+
+  mxFree(img);
+  mxFree(maxs);
+  if (avgs != NULL) {
+    mxFree(avgs);
+  }
+
+  return;
+}
@@ -0,0 +1,20 @@
+% DETECT_MAXIMA_MEX detects in C the local maxima of an image in a single pass. The
+% maximum filter uses the van Herk/Gil-Werman algorithm, which costs three comparisons
+% per pixel independently of the window size, while the local average is computed
+% using running sums. Plateaus of maxima are reduced to their pixel closest to their
+% center. The filtering is performed in parallel if compiled with OpenMP.
+%
+%   MAXS = DETECT_MAXIMA_MEX(IMG, RADIUS) returns the list of local maxima in IMG
+%   within a window of size 2*RADIUS+1. MAXS is a Nx2 matrix where each row has the
+%   structure [x y], where x,y are the pixel position of the maximum in carthesian
+%   coordinates, sorted as by FIND. IMG can be of class uint8, uint16, single or double.
+%
+%   MAXS = DETECT_MAXIMA_MEX(IMG, [RADIUS_Y RADIUS_X]) uses different radii along the
+%   rows and the columns of IMG, as in ONES(2*[RADIUS_Y RADIUS_X]+1).
+%
+%   MAXS = DETECT_MAXIMA_MEX(IMG, RADIUS, INTENS_THRESH) keeps only the maxima for which
+%   the average intensity within the window is at least INTENS_THRESH, the image being
+%   zero-padded as in IMFILTER.
+%
+%   MAXS = DETECT_MAXIMA_MEX(IMG, RADIUS, INTENS_THRESH, DETECTIONS) keeps only the
+%   maxima for which DETECTIONS is strictly positive (e.g. the output of imatrou.m).
@@ -0,0 +1,126 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "image_types.h"
+#include "mex.h"
+
+// The index of a pixel in a line of n pixels, the line being padded symmetrically
+// as by padarray in nl_means.m
+static inline mwSignedIndex symmetric_index(mwSignedIndex i, mwSignedIndex n) {
+  i %= 2*n;
+  if (i < 0) {
+    i += 2*n;
+  }
+  return (i >= n) ? 2*n - 1 - i : i;
+}
+
+// Projects the patches centered on the pixels of one column onto the ndims vectors
+// of the basis, each patch being vectorized in column-major order as in
+// compute_patch_library. col points to the first row of the padded image which
+// the patches of the column span, ph being the height of the padded image and acc a
+// buffer for the h*ndims projections.
+static void project_column(const double *col, mwSize ph, mwSize h, mwSize k,
+                           const double *basis, mwSize ndims, double *acc) {
+
+  mwSize size = 2*k + 1, npix = size*size, a, b, d, y;
+  const double *src;
+  double coef, *dst;
+
+  memset(acc, 0, h*ndims*sizeof(double));
+
+  // Accumulating the contribution of each pixel of the patches at once keeps the
+  // accesses along the column contiguous
+  for (b = 0; b < size; b++) {
+    for (a = 0; a < size; a++) {
+      src = col + b*ph + a;
+
+      for (d = 0; d < ndims; d++) {
+        coef = basis[d*npix + b*size + a];
+        dst = acc + d*h;
+
+        for (y = 0; y < h; y++) {
+          dst[y] += coef * src[y];
+        }
+      }
+    }
+  }
+
+  return;
+}
+
+// Patch-wise embedding streamed over the columns of the image, see embed_patches_mex.m
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+  mwSize h, w, k, size, ph, pw, ndims, x, y, dims[3];
+  mwSignedIndex j;
+  double *img, *padded, *basis, *proj;
+
+  // Check for proper number of input and output arguments
+  if (nrhs != 3) {
+    mexErrMsgIdAndTxt("CAST:embed_patches_mex:invalidNumInputs",
+        "Three input arguments required.");
+  }
+  if (!is_supported_image(prhs[0]) || mxGetNumberOfDimensions(prhs[0]) > 2) {
+    mexErrMsgIdAndTxt("CAST:embed_patches_mex:invalidInput",
+        "Input argument (1) must be a 2D image of type uint8, uint16, single or double.");
+  }
+
+  h = mxGetM(prhs[0]);
+  w = mxGetN(prhs[0]);
+  k = (mwSize)mxGetScalar(prhs[1]);
+  size = 2*k + 1;
+
+  if (!mxIsDouble(prhs[2]) || mxGetM(prhs[2]) != size*size) {
+    mexErrMsgIdAndTxt("CAST:embed_patches_mex:invalidInput",
+        "The basis must have one row per pixel of a patch.");
+  }
+  basis = mxGetPr(prhs[2]);
+  ndims = mxGetN(prhs[2]);
+
+  // The projections, as a stack of images
+  dims[0] = h;
+  dims[1] = w;
+  dims[2] = ndims;
+  plhs[0] = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+  proj = mxGetPr(plhs[0]);
+  if (h*w == 0) {
+    return;
+  }
+
+  // The padded image, from which the patches are extracted
+  ph = h + 2*k;
+  pw = w + 2*k;
+  img = (double *)mxMalloc(h*w*sizeof(double));
+  padded = (double *)mxMalloc(ph*pw*sizeof(double));
+  copy_image(prhs[0], img);
+
+  for (x = 0; x < pw; x++) {
+    for (y = 0; y < ph; y++) {
+      padded[x*ph + y] = img[symmetric_index((mwSignedIndex)x - k, w)*h +
+                             symmetric_index((mwSignedIndex)y - k, h)];
+    }
+  }
+
+  // Only one column of patches is projected at a time by every thread
+  #pragma omp parallel
+  {
+    double *acc = (double *)malloc(h*ndims*sizeof(double));
+    mwSize d;
+
+    #pragma omp for schedule(static)
+    for (j = 0; j < (mwSignedIndex)w; j++) {
+      project_column(padded + j*ph, ph, h, k, basis, ndims, acc);
+
+      for (d = 0; d < ndims; d++) {
+        memcpy(proj + d*h*w + j*h, acc + d*h, h*sizeof(double));
+      }
+    }
+
+    free(acc);
+  }
+
+  mxFree(img);
+  mxFree(padded);
+
+  return;
+}
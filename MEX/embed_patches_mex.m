@@ -0,0 +1,10 @@
+% EMBED_PATCHES_MEX projects the patches of an image onto a basis without building
+% the library of all the patches, streaming them one column at a time, in parallel
+% if compiled with OpenMP. It is used by nl_means.m to bound its memory usage.
+%
+%   PROJ = EMBED_PATCHES_MEX(IMG, K, BASIS) projects the patches of size 2*K+1
+%   around every pixel of the 2D image IMG, padded symmetrically, onto the columns
+%   of BASIS. The patches are vectorized in column-major order, so BASIS has
+%   (2*K+1)^2 rows. PROJ is a double stack of size(IMG) by size(BASIS, 2), and
+%   PROJ(:,:,d) is identical to IMFILTER(IMG, RESHAPE(BASIS(:,d), 2*K+1, 2*K+1),
+%   'symmetric').
@@ -0,0 +1,203 @@
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include "mex.h"
+
+// Computes the homogeneity, the mean and the standard deviation of one full block
+// starting at (x0, y0), as analyze_filt and analyze_block in estimate_noise.m. The
+// homogeneity is either the sum of the edge map or the sum of the absolute responses
+// to the nfilters filters, block being a buffer for the data.
+static void block_stats(const double *img, const double *edge_map, const double *filter,
+                        mwSize nfilters, mwSize h, mwSize x0, mwSize y0, mwSize block_size,
+                        double *block, double *stats) {
+
+  mwSize i, j, k, nelems = 0;
+  double val, sum = 0, homog = 0, mean;
+
+  // The homogeneity
+  if (edge_map != NULL) {
+    for (i = 0; i < block_size; i++) {
+      for (j = 0; j < block_size; j++) {
+        homog += edge_map[(x0+i)*h + y0+j];
+      }
+    }
+  } else if (filter != NULL) {
+    for (i = 0; i < block_size; i++) {
+      for (j = 0; j < block_size; j++) {
+        block[i*block_size + j] = img[(x0+i)*h + y0+j];
+      }
+    }
+    for (k = 0; k < nfilters; k++) {
+      val = 0;
+      for (i = 0; i < block_size*block_size; i++) {
+        val += block[i] * filter[k*block_size*block_size + i];
+      }
+      homog += fabs(val);
+    }
+  }
+
+  // The mean and standard deviation, ignoring NaNs as mymean
+  for (i = 0; i < block_size; i++) {
+    for (j = 0; j < block_size; j++) {
+      val = img[(x0+i)*h + y0+j];
+      if (!isnan(val)) {
+        sum += val;
+        nelems++;
+      }
+    }
+  }
+
+  stats[0] = homog;
+  if (nelems == 0) {
+    stats[1] = NAN;
+    stats[2] = NAN;
+
+    return;
+  }
+
+  mean = sum / nelems;
+  sum = 0;
+  for (i = 0; i < block_size; i++) {
+    for (j = 0; j < block_size; j++) {
+      val = img[(x0+i)*h + y0+j];
+      if (!isnan(val)) {
+        sum += (val - mean) * (val - mean);
+      }
+    }
+  }
+
+  stats[1] = mean;
+  stats[2] = (nelems > 1) ? sqrt(sum / (nelems - 1)) : 0;
+
+  return;
+}
+
+// The statistics required by estimate_noise.m, see estimate_noise_mex.m
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+  mwSize h, w, block_size, nbh, nbw, nblocks, nedges, nfilters = 0, i;
+  mwSignedIndex b;
+  double *img, *noisefree = NULL, *edge_map = NULL, *filter = NULL, *edges, *blocks;
+  double *counts, *sums, *sums2;
+
+  // Check for proper number of input and output arguments
+  if (nrhs != 6) {
+    mexErrMsgIdAndTxt("CAST:estimate_noise_mex:invalidNumInputs",
+        "Six input arguments required.");
+  }
+  if (!mxIsDouble(prhs[0]) || mxGetNumberOfDimensions(prhs[0]) > 2) {
+    mexErrMsgIdAndTxt("CAST:estimate_noise_mex:invalidInput",
+        "Input argument (1) must be a 2D double image.");
+  }
+
+  h = mxGetM(prhs[0]);
+  w = mxGetN(prhs[0]);
+  img = mxGetPr(prhs[0]);
+
+  // The optional images, which must be of the same size as IMG
+  for (i = 1; i < 3; i++) {
+    if (!mxIsEmpty(prhs[i]) &&
+        (!mxIsDouble(prhs[i]) || mxGetM(prhs[i]) != h || mxGetN(prhs[i]) != w)) {
+      mexErrMsgIdAndTxt("CAST:estimate_noise_mex:invalidInput",
+          "Input arguments (2) and (3) must be empty or of the same size as the image.");
+    }
+  }
+  if (!mxIsEmpty(prhs[1])) {
+    noisefree = mxGetPr(prhs[1]);
+  }
+  if (!mxIsEmpty(prhs[2])) {
+    edge_map = mxGetPr(prhs[2]);
+  }
+
+  block_size = (mwSize)mxGetScalar(prhs[4]);
+  if (block_size < 1) {
+    mexErrMsgIdAndTxt("CAST:estimate_noise_mex:invalidInput",
+        "The size of the blocks must be strictly positive.");
+  }
+
+  // The filters used instead of the edge map
+  if (edge_map == NULL && !mxIsEmpty(prhs[3])) {
+    if (!mxIsDouble(prhs[3]) || mxGetM(prhs[3]) != block_size*block_size) {
+      mexErrMsgIdAndTxt("CAST:estimate_noise_mex:invalidInput",
+          "The filters must have one row per pixel of a block.");
+    }
+    filter = mxGetPr(prhs[3]);
+    nfilters = mxGetN(prhs[3]);
+  }
+
+  edges = mxGetPr(prhs[5]);
+  nedges = (noisefree != NULL) ? mxGetNumberOfElements(prhs[5]) : 0;
+
+  // The blocks, ordered as by blockproc
+  nbh = (h + block_size - 1) / block_size;
+  nbw = (w + block_size - 1) / block_size;
+  nblocks = nbh*nbw;
+
+  plhs[0] = mxCreateDoubleMatrix(nblocks, 3, mxREAL);
+  plhs[1] = mxCreateDoubleMatrix(nedges, 1, mxREAL);
+  plhs[2] = mxCreateDoubleMatrix(nedges, 1, mxREAL);
+  plhs[3] = mxCreateDoubleMatrix(nedges, 1, mxREAL);
+  blocks = mxGetPr(plhs[0]);
+  counts = mxGetPr(plhs[1]);
+  sums = mxGetPr(plhs[2]);
+  sums2 = mxGetPr(plhs[3]);
+
+  // A single pass over the tiles, the histogram being accumulated for every thread
+  #pragma omp parallel
+  {
+    double *bins = (double *)calloc(3*nedges + 1, sizeof(double));
+    double *block = (double *)malloc(block_size*block_size*sizeof(double));
+    double stats[3], val, noise;
+    mwSize x0, y0, x1, y1, x, y, k;
+
+    #pragma omp for schedule(dynamic)
+    for (b = 0; b < (mwSignedIndex)nblocks; b++) {
+      x0 = (b / nbh) * block_size;
+      y0 = (b % nbh) * block_size;
+      x1 = std::min(x0 + block_size, w);
+      y1 = std::min(y0 + block_size, h);
+
+      // The histogram of the noiseless intensities, as histc
+      for (x = x0; x < x1 && nedges > 0; x++) {
+        for (y = y0; y < y1; y++) {
+          val = noisefree[x*h + y];
+          k = std::upper_bound(edges, edges + nedges, val) - edges;
+
+          if (k == 0 || (k == nedges && val != edges[nedges-1])) {
+            continue;
+          }
+
+          noise = img[x*h + y] - val;
+          bins[3*(k-1)] += 1;
+          bins[3*(k-1) + 1] += noise;
+          bins[3*(k-1) + 2] += noise * noise;
+        }
+      }
+
+      // Only full blocks are considered, the others getting the highest value
+      if (x1 - x0 == block_size && y1 - y0 == block_size) {
+        block_stats(img, edge_map, filter, nfilters, h, x0, y0, block_size, block, stats);
+      } else {
+        stats[0] = stats[1] = stats[2] = HUGE_VAL;
+      }
+
+      blocks[b] = stats[0];
+      blocks[b + nblocks] = stats[1];
+      blocks[b + 2*nblocks] = stats[2];
+    }
+
+    #pragma omp critical
+    {
+      for (k = 0; k < nedges; k++) {
+        counts[k] += bins[3*k];
+        sums[k] += bins[3*k + 1];
+        sums2[k] += bins[3*k + 2];
+      }
+    }
+
+    free(bins);
+    free(block);
+  }
+
+  return;
+}
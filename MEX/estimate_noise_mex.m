@@ -0,0 +1,12 @@
+% ESTIMATE_NOISE_MEX computes in C the statistics required by estimate_noise.m in a
+% single pass over the tiles of an image, in parallel if compiled with OpenMP.
+%
+%   [BLOCKS, COUNTS, SUMS, SUMS2] = ESTIMATE_NOISE_MEX(IMG, NOISEFREE, EDGES_MAP, FILTERS,
+%   BLOCK_SIZE, EDGES) partitions the double image IMG into blocks of BLOCK_SIZE and
+%   returns for each of them [homogeneity, mean, std] in BLOCKS, ordered as BLOCKPROC
+%   would. The homogeneity is either the sum of EDGES_MAP over the block, or if empty,
+%   the sum of the absolute responses of the block to the columns of FILTERS. The
+%   mean and standard deviation ignore NaNs (see mymean.m), and incomplete blocks are
+%   set to Inf. In addition, the intensities of NOISEFREE are classified as by HISTC
+%   into EDGES, COUNTS being the number of pixels in each bin, SUMS and SUMS2 the sum
+%   and the sum of squares of their noise (IMG - NOISEFREE).
@@ -0,0 +1,545 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "bilinear.h"
+#include "image_types.h"
+#include "mex.h"
+
+// The number of moments required by the regressions
+#define NMOMENTS 14
+
+// The types of regression, as chosen by FIT_FULL in estimate_spots.m
+enum fit_type {CENTERED, FULL, AMPLITUDE};
+
+// The pixels of a window brighter than the threshold, stored contiguously together
+// with their relative position (z = x^2 + y^2) and the current squared weights
+typedef struct {
+  mwSize npix;
+  double *x, *y, *z, *s, *ls, *se2;
+} spot_window;
+
+// Accumulates the weighted moments of the pixels in a window, in the following order:
+//   [se2 x*se2 y*se2 z*se2 x2*se2 y2*se2 xy*se2 xz*se2 yz*se2 z2*se2
+//    se2*ls x*se2*ls y*se2*ls z*se2*ls]
+// When full is false, only the moments independent of x and y are computed. With
+// SSE2, the moments of pairs of pixels are accumulated in parallel.
+static void weighted_moments(const spot_window *win, bool full, double *moments) {
+
+  mwSize i = 0, k, n = win->npix;
+  double x, y, z, w, wl;
+
+  for (k = 0; k < NMOMENTS; k++) {
+    moments[k] = 0;
+  }
+
+#if defined(__SSE2__)
+  __m128d acc[NMOMENTS], vx, vy, vz, vw, vwl;
+  double tmp[2];
+
+  for (k = 0; k < NMOMENTS; k++) {
+    acc[k] = _mm_setzero_pd();
+  }
+
+  for (i = 0; i + 1 < n; i += 2) {
+    vz = _mm_loadu_pd(win->z + i);
+    vw = _mm_loadu_pd(win->se2 + i);
+    vwl = _mm_mul_pd(vw, _mm_loadu_pd(win->ls + i));
+
+    acc[0] = _mm_add_pd(acc[0], vw);
+    acc[3] = _mm_add_pd(acc[3], _mm_mul_pd(vz, vw));
+    acc[9] = _mm_add_pd(acc[9], _mm_mul_pd(_mm_mul_pd(vz, vz), vw));
+    acc[10] = _mm_add_pd(acc[10], vwl);
+    acc[13] = _mm_add_pd(acc[13], _mm_mul_pd(vz, vwl));
+
+    if (full) {
+      vx = _mm_loadu_pd(win->x + i);
+      vy = _mm_loadu_pd(win->y + i);
+
+      acc[1] = _mm_add_pd(acc[1], _mm_mul_pd(vx, vw));
+      acc[2] = _mm_add_pd(acc[2], _mm_mul_pd(vy, vw));
+      acc[4] = _mm_add_pd(acc[4], _mm_mul_pd(_mm_mul_pd(vx, vx), vw));
+      acc[5] = _mm_add_pd(acc[5], _mm_mul_pd(_mm_mul_pd(vy, vy), vw));
+      acc[6] = _mm_add_pd(acc[6], _mm_mul_pd(_mm_mul_pd(vx, vy), vw));
+      acc[7] = _mm_add_pd(acc[7], _mm_mul_pd(_mm_mul_pd(vx, vz), vw));
+      acc[8] = _mm_add_pd(acc[8], _mm_mul_pd(_mm_mul_pd(vy, vz), vw));
+      acc[11] = _mm_add_pd(acc[11], _mm_mul_pd(vx, vwl));
+      acc[12] = _mm_add_pd(acc[12], _mm_mul_pd(vy, vwl));
+    }
+  }
+
+  for (k = 0; k < NMOMENTS; k++) {
+    _mm_storeu_pd(tmp, acc[k]);
+    moments[k] = tmp[0] + tmp[1];
+  }
+#endif
+
+  // The remaining pixels
+  for (; i < n; i++) {
+    z = win->z[i];
+    w = win->se2[i];
+    wl = w * win->ls[i];
+
+    moments[0] += w;
+    moments[3] += z*w;
+    moments[9] += z*z*w;
+    moments[10] += wl;
+    moments[13] += z*wl;
+
+    if (full) {
+      x = win->x[i];
+      y = win->y[i];
+
+      moments[1] += x*w;
+      moments[2] += y*w;
+      moments[4] += x*x*w;
+      moments[5] += y*y*w;
+      moments[6] += x*y*w;
+      moments[7] += x*z*w;
+      moments[8] += y*z*w;
+      moments[11] += x*wl;
+      moments[12] += y*wl;
+    }
+  }
+
+  return;
+}
+
+// Solves the n x n system mat * coeffs = res (n <= 4) using a LU decomposition with
+// partial pivoting, providing in addition the determinant and the reciprocal
+// condition number in 1-norm of mat (as det and rcond do).
+static void solve_system(const double *mat, const double *res, int n, double *coeffs,
+                         double *det, double *rcond) {
+
+  int i, j, k, piv[4], tmp_piv;
+  double lu[16], col[4], tmp, norm_mat = 0, norm_inv = 0, sum;
+
+  memcpy(lu, mat, n*n*sizeof(double));
+  for (i = 0; i < n; i++) {
+    piv[i] = i;
+  }
+
+  // The decomposition, stored row-wise
+  *det = 1;
+  for (k = 0; k < n; k++) {
+    j = k;
+    for (i = k+1; i < n; i++) {
+      if (fabs(lu[i*n + k]) > fabs(lu[j*n + k])) {
+        j = i;
+      }
+    }
+    if (j != k) {
+      for (i = 0; i < n; i++) {
+        tmp = lu[k*n + i];
+        lu[k*n + i] = lu[j*n + i];
+        lu[j*n + i] = tmp;
+      }
+      tmp_piv = piv[k];
+      piv[k] = piv[j];
+      piv[j] = tmp_piv;
+      *det = -*det;
+    }
+
+    *det *= lu[k*n + k];
+    if (lu[k*n + k] == 0) {
+      continue;
+    }
+    for (i = k+1; i < n; i++) {
+      lu[i*n + k] /= lu[k*n + k];
+      for (j = k+1; j < n; j++) {
+        lu[i*n + j] -= lu[i*n + k] * lu[k*n + j];
+      }
+    }
+  }
+
+  // A singular matrix has no solution
+  if (*det == 0) {
+    *rcond = 0;
+    return;
+  }
+
+  // The solution of the system for the vector b, stored in x
+  #define LU_SOLVE(b, x) \
+    for (i = 0; i < n; i++) { \
+      sum = b[piv[i]]; \
+      for (j = 0; j < i; j++) { \
+        sum -= lu[i*n + j] * x[j]; \
+      } \
+      x[i] = sum; \
+    } \
+    for (i = n; i-- > 0;) { \
+      sum = x[i]; \
+      for (j = i+1; j < n; j++) { \
+        sum -= lu[i*n + j] * x[j]; \
+      } \
+      x[i] = sum / lu[i*n + i]; \
+    }
+
+  LU_SOLVE(res, coeffs);
+
+  // The 1-norms of the matrix and of its inverse, one column at a time
+  for (k = 0; k < n; k++) {
+    double unit[4] = {0, 0, 0, 0};
+    unit[k] = 1;
+
+    LU_SOLVE(unit, col);
+
+    tmp = 0;
+    sum = 0;
+    for (i = 0; i < n; i++) {
+      tmp += fabs(col[i]);
+      sum += fabs(mat[i*n + k]);
+    }
+    norm_inv = (tmp > norm_inv) ? tmp : norm_inv;
+    norm_mat = (sum > norm_mat) ? sum : norm_mat;
+  }
+  #undef LU_SOLVE
+
+  *rcond = 1 / (norm_mat * norm_inv);
+
+  return;
+}
+
+// Least-square regression of a 2d symmetric gaussian, including its center, as
+// regress_2d_gaussian in estimate_spots.m (see there for details).
+static void regress_2d_gaussian(spot_window *win, int niter, double weight, double stop,
+                                double *params) {
+
+  int n, k;
+  mwSize i;
+  double m[NMOMENTS], mat[16], res[4], det, rs, se, diff;
+  double coeffs[4] = {0}, prev_coeffs[4] = {0};
+
+  for (n = 0; n < niter; n++) {
+
+    // The pixel weights, using the same exponent as estimate_spots.m
+    if (n == 0) {
+      for (i = 0; i < win->npix; i++) {
+        win->se2[i] = win->s[i] * win->s[i];
+      }
+    } else {
+      for (i = 0; i < win->npix; i++) {
+        se = exp(prev_coeffs[0] + prev_coeffs[1]*win->x[i] + prev_coeffs[2]*win->y[i] +
+                 prev_coeffs[2]*win->z[i]);
+        win->se2[i] = se * se;
+      }
+    }
+
+    weighted_moments(win, true, m);
+
+    // The Jacobian matrix and the results vector
+    mat[0]  = m[0]; mat[1]  = m[1]; mat[2]  = m[2]; mat[3]  = m[3];
+    mat[4]  = m[1]; mat[5]  = m[4]; mat[6]  = m[6]; mat[7]  = m[7];
+    mat[8]  = m[2]; mat[9]  = m[6]; mat[10] = m[5]; mat[11] = m[8];
+    mat[12] = m[3]; mat[13] = m[7]; mat[14] = m[8]; mat[15] = m[9];
+
+    res[0] = m[10]; res[1] = m[11]; res[2] = m[12]; res[3] = m[13];
+
+    solve_system(mat, res, 4, coeffs, &det, &rs);
+
+    // Avoid badly scaled matrix
+    if (fabs(det) < 1e-5 || isnan(rs) || fabs(rs) < 1e-3) {
+      coeffs[0] = -HUGE_VAL;
+      coeffs[1] = -1;
+      coeffs[2] = -1;
+      coeffs[3] = HUGE_VAL;
+      break;
+    }
+
+    if (n > 0) {
+
+      // Have we converged yet ?
+      diff = 0;
+      for (k = 0; k < 4; k++) {
+        diff += fabs(coeffs[k] - prev_coeffs[k]);
+      }
+      if (diff < stop) {
+        break;
+      }
+
+      for (k = 0; k < 4; k++) {
+        coeffs[k] = coeffs[k]*(1-weight) + prev_coeffs[k]*weight;
+      }
+    } else {
+      // Force them to be close to the center
+      coeffs[1] *= (1-weight);
+      coeffs[2] *= (1-weight);
+    }
+
+    memcpy(prev_coeffs, coeffs, 4*sizeof(double));
+  }
+
+  // Extract the gaussian parameters
+  params[0] = -coeffs[1] / (2*coeffs[3]);
+  params[1] = -coeffs[2] / (2*coeffs[3]);
+  params[2] = sqrt(-1 / (2*coeffs[3]));
+  params[3] = exp(coeffs[0] - (coeffs[1]*coeffs[1] + coeffs[2]*coeffs[2]) / (4*coeffs[3]));
+
+  return;
+}
+
+// Least-square regression of a 2d symmetric gaussian centered on the window, as
+// regress_2d_centered_gaussian in estimate_spots.m
+static void regress_2d_centered_gaussian(spot_window *win, int niter, double weight,
+                                         double stop, double *params) {
+
+  int n;
+  mwSize i;
+  double m[NMOMENTS], mat[4], res[2], det, rs, se;
+  double coeffs[2] = {0}, prev_coeffs[2] = {0};
+
+  for (n = 0; n < niter; n++) {
+
+    // The pixel weights
+    if (n == 0) {
+      for (i = 0; i < win->npix; i++) {
+        win->se2[i] = win->s[i] * win->s[i];
+      }
+    } else {
+      for (i = 0; i < win->npix; i++) {
+        se = exp(prev_coeffs[0] + prev_coeffs[1]*win->z[i]);
+        win->se2[i] = se * se;
+      }
+    }
+
+    weighted_moments(win, false, m);
+
+    // The tiny Jacobian matrix
+    mat[0] = m[0]; mat[1] = m[3];
+    mat[2] = m[3]; mat[3] = m[9];
+
+    res[0] = m[10]; res[1] = m[13];
+
+    solve_system(mat, res, 2, coeffs, &det, &rs);
+
+    // Avoid badly scaled matrix
+    if (fabs(det) < 1e-5 || isnan(rs) || fabs(rs) < 1e-3) {
+      coeffs[0] = -HUGE_VAL;
+      coeffs[1] = HUGE_VAL;
+      break;
+    }
+
+    // Handle the iterative procedure
+    if (n > 0) {
+      if (fabs(coeffs[0] - prev_coeffs[0]) + fabs(coeffs[1] - prev_coeffs[1]) < stop) {
+        break;
+      } else {
+        coeffs[0] = coeffs[0]*(1-weight) + prev_coeffs[0]*weight;
+        coeffs[1] = coeffs[1]*(1-weight) + prev_coeffs[1]*weight;
+      }
+    }
+
+    prev_coeffs[0] = coeffs[0];
+    prev_coeffs[1] = coeffs[1];
+  }
+
+  // Extract the parameters
+  params[0] = 0;
+  params[1] = 0;
+  params[2] = sqrt(-1 / (2*coeffs[1]));
+  params[3] = exp(coeffs[0]);
+
+  return;
+}
+
+// Regression of the amplitude of a centered gaussian of known sigma, as
+// regress_2d_amplitudes in estimate_spots.m
+static void regress_2d_amplitudes(const spot_window *win, const double *prev_params,
+                                  mwSize nprev, mwSize stride, double *params) {
+
+  mwSize i;
+  double sigma, se, se2, num = 0, denom = 0;
+
+  params[0] = 0;
+  params[1] = 0;
+  params[2] = 0;
+  params[3] = 0;
+
+  // We cannot perform the estimation
+  if (nprev < 2 || !isfinite(prev_params[0]) || !isfinite(prev_params[stride]) ||
+      prev_params[0] == 0) {
+    return;
+  }
+
+  sigma = prev_params[0];
+
+  // The weighted regression
+  for (i = 0; i < win->npix; i++) {
+    se = exp(-win->z[i] / (2*sigma*sigma));
+    se2 = se*se;
+    num += se2 * win->s[i] * se;
+    denom += se2 * se2;
+  }
+
+  params[2] = sigma;
+  params[3] = (denom > 0) ? num / denom : 0;
+
+  return;
+}
+
+// Fits the gaussian spots of an image of any type, in parallel
+template<typename T>
+static void fit_spots(const T *img, mwSize h, mwSize w, const double *pos, mwSize nspots,
+                      mwSize ncols, int wsize, double thresh, int niter, double stop,
+                      double weight, fit_type type, double *params) {
+
+  mwSignedIndex i;
+  mwSize wlen = 2*wsize + 1, wpix = wlen*wlen;
+
+  #pragma omp parallel
+  {
+    double *buffer = (double *)malloc(9*wpix*sizeof(double));
+    double *x_indx = buffer, *y_indx = x_indx + wpix, *values = y_indx + wpix;
+    double curr_params[4];
+    spot_window win;
+    mwSize k, p;
+    int dx, dy;
+
+    win.x = values + wpix;
+    win.y = win.x + wpix;
+    win.z = win.y + wpix;
+    win.s = win.z + wpix;
+    win.ls = win.s + wpix;
+    win.se2 = win.ls + wpix;
+
+    #pragma omp for schedule(dynamic, 16)
+    for (i = 0; i < (mwSignedIndex)nspots; i++) {
+
+      // Interpolate the sub-window, column-wise as in Matlab
+      for (k = 0; k < wpix; k++) {
+        x_indx[k] = (mwSignedIndex)(k / wlen) - wsize + pos[i];
+        y_indx[k] = (mwSignedIndex)(k % wlen) - wsize + pos[i + nspots];
+      }
+      interpolate(img, h, w, x_indx, y_indx, wpix, 0, 0, values);
+
+      // We keep only the brightest pixels
+      win.npix = 0;
+      for (k = 0; k < wpix; k++) {
+        if (values[k] > thresh) {
+          dx = (int)(k / wlen) - wsize;
+          dy = (int)(k % wlen) - wsize;
+
+          p = win.npix++;
+          win.x[p] = dx;
+          win.y[p] = dy;
+          win.z[p] = dx*dx + dy*dy;
+          win.s[p] = values[k];
+          win.ls[p] = log(values[k]);
+        }
+      }
+
+      // Avoid empty windows
+      if (win.npix == 0) {
+        for (k = 0; k < 4; k++) {
+          params[i + k*nspots] = NAN;
+        }
+        continue;
+      }
+
+      switch (type) {
+        case FULL:
+          regress_2d_gaussian(&win, niter, weight, stop, curr_params);
+          break;
+        case CENTERED:
+          regress_2d_centered_gaussian(&win, niter, weight, stop, curr_params);
+          break;
+        default:
+          regress_2d_amplitudes(&win, pos + i + 2*nspots, (ncols > 2) ? ncols - 2 : 0,
+                                nspots, curr_params);
+          break;
+      }
+
+      for (k = 0; k < 4; k++) {
+        params[i + k*nspots] = curr_params[k];
+      }
+    }
+
+    free(buffer);
+  }
+
+  return;
+}
+
+// Gaussian spots fitting, main interface, see estimate_spots_mex.m
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+  mwSize h, w, nspots, ncols;
+  int wsize, niter = 15;
+  double thresh = 0, stop = 0, weight = 0.1, *pos, *params;
+  fit_type type = CENTERED;
+
+  // Check for proper number of input and output arguments
+  if (nrhs < 3) {
+    mexErrMsgIdAndTxt("CAST:estimate_spots_mex:invalidNumInputs",
+        "At least three input arguments required.");
+  }
+  if (!is_supported_image(prhs[0]) || mxGetNumberOfDimensions(prhs[0]) > 2) {
+    mexErrMsgIdAndTxt("CAST:estimate_spots_mex:invalidInput",
+        "Input argument (1) must be a 2D image of type uint8, uint16, single or double.");
+  }
+  if (!mxIsDouble(prhs[1]) || (!mxIsEmpty(prhs[1]) && mxGetN(prhs[1]) < 2)) {
+    mexErrMsgIdAndTxt("CAST:estimate_spots_mex:invalidInput",
+        "Input argument (2) must be a double matrix with at least two columns.");
+  }
+
+  h = mxGetM(prhs[0]);
+  w = mxGetN(prhs[0]);
+  pos = mxGetPr(prhs[1]);
+  nspots = mxGetM(prhs[1]);
+  ncols = mxGetN(prhs[1]);
+
+  wsize = (int)ceil(mxGetScalar(prhs[2]));
+  wsize = (wsize < 1) ? 1 : wsize;
+
+  // The optional parameters, as in estimate_spots.m
+  if (nrhs > 3) {
+    thresh = mxGetScalar(prhs[3]);
+  }
+  if (nrhs > 4) {
+    niter = (int)mxGetScalar(prhs[4]);
+    niter = (niter < 1) ? 1 : niter;
+  }
+  if (nrhs > 5) {
+    stop = mxGetScalar(prhs[5]);
+  }
+  if (nrhs > 6) {
+    weight = mxGetScalar(prhs[6]);
+  }
+  if (nrhs > 7) {
+    if (mxIsEmpty(prhs[7])) {
+      type = AMPLITUDE;
+    } else if (mxGetScalar(prhs[7]) != 0) {
+      type = FULL;
+    }
+  }
+
+  plhs[0] = mxCreateDoubleMatrix(nspots, 4, mxREAL);
+  params = mxGetPr(plhs[0]);
+
+  if (nspots == 0) {
+    return;
+  }
+
+  switch (mxGetClassID(prhs[0])) {
+    case mxUINT8_CLASS:
+      fit_spots((const unsigned char *)mxGetData(prhs[0]), h, w, pos, nspots, ncols, wsize,
+                thresh, niter, stop, weight, type, params);
+      break;
+    case mxUINT16_CLASS:
+      fit_spots((const unsigned short *)mxGetData(prhs[0]), h, w, pos, nspots, ncols, wsize,
+                thresh, niter, stop, weight, type, params);
+      break;
+    case mxSINGLE_CLASS:
+      fit_spots((const float *)mxGetData(prhs[0]), h, w, pos, nspots, ncols, wsize,
+                thresh, niter, stop, weight, type, params);
+      break;
+    default:
+      fit_spots((const double *)mxGetData(prhs[0]), h, w, pos, nspots, ncols, wsize,
+                thresh, niter, stop, weight, type, params);
+      break;
+  }
+
+  return;
+}
@@ -0,0 +1,14 @@
+% ESTIMATE_SPOTS_MEX fits in C the gaussian spots of an image using the iterative
+% least-square regressions of estimate_spots.m. All the spots are processed at once,
+% in parallel if compiled with OpenMP, the moments of the regressions being
+% accumulated using SSE2 if available.
+%
+%   PARAMS = ESTIMATE_SPOTS_MEX(IMG, POS, WSIZE) fits 2D gaussians centered on the
+%   rows [x y ...] of POS, using the pixels of IMG interpolated in a window of WSIZE
+%   around them. PARAMS is a Nx4 matrix with rows [mu_x, mu_y, sigma, ampl], mu_x and
+%   mu_y being relative to POS. Spots without any valid pixel are set to NaN. IMG can
+%   be of class uint8, uint16, single or double.
+%
+%   PARAMS = ESTIMATE_SPOTS_MEX(..., THRESH, NITER, STOP, WEIGHT, FIT_FULL) provides
+%   the parameters of the regressions, as described in estimate_spots.m. An empty
+%   FIT_FULL fits only the amplitudes, using the sigma from the third column of POS.
@@ -0,0 +1,260 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "image_types.h"
+#include "mex.h"
+
+// The number of columns of the tiles processed by each thread
+#define TILE_WIDTH 64
+
+// The index of a pixel in a line of n pixels, the line being padded symmetrically
+// as by padarray in nl_means.m
+static inline mwSignedIndex symmetric_index(mwSignedIndex i, mwSignedIndex n) {
+  i %= 2*n;
+  if (i < 0) {
+    i += 2*n;
+  }
+  return (i >= n) ? 2*n - 1 - i : i;
+}
+
+// Accumulates the weights and the weighted values for the search offset (ox, oy) and
+// its opposite, as the distance between the patches is symmetric. The distances
+// between all the pairs of patches are obtained from the squared differences between
+// the padded image and its shifted version, summed using running sums along the
+// columns and then along the rows (see fast_nl_means_mex.m). Only the pixels of the
+// columns [xa, xb) are considered, weights and sums starting at column xa. box is a
+// buffer of h*(xb-xa+2*k+1) values.
+static void accumulate_offset(const double *img, const double *padded, mwSize h, mwSize w,
+                              mwSize k, mwSignedIndex ox, mwSignedIndex oy, double scaling,
+                              mwSize xa, mwSize xb, double *box, double *weights, double *sums) {
+
+  mwSize ph = h + 2*k, size = 2*k + 1, x, y, x0, x1, y0, y1, nrows, ncols, bw;
+  mwSignedIndex shift = ox*(mwSignedIndex)ph + oy;
+  double run, diff, weight;
+  const double *col;
+  double *line;
+
+  // The pixels which shifted position is within the image
+  x0 = (ox < 0) ? -ox : 0;
+  x1 = (ox > 0) ? w - ox : w;
+  y0 = (oy < 0) ? -oy : 0;
+  y1 = (oy > 0) ? h - oy : h;
+
+  // And within the current columns
+  x0 = (x0 < xa) ? xa : x0;
+  x1 = (x1 > xb) ? xb : x1;
+  if (x0 >= x1 || y0 >= y1) {
+    return;
+  }
+  nrows = y1 - y0;
+  ncols = x1 - x0;
+  bw = ncols + 2*k;
+
+  // The sums along the columns of the padded image, for all the rows of the pixels,
+  // the padding shifting the patches of the image by k
+  for (x = 0; x < bw; x++) {
+    col = padded + (x0 + x)*ph + y0;
+    line = box + x*nrows;
+
+    run = 0;
+    for (y = 0; y < size - 1; y++) {
+      diff = col[y] - col[y + shift];
+      run += diff*diff;
+    }
+    for (y = 0; y < nrows; y++) {
+      diff = col[y + size - 1] - col[y + size - 1 + shift];
+      run += diff*diff;
+      line[y] = run;
+      diff = col[y] - col[y + shift];
+      run -= diff*diff;
+    }
+  }
+
+  // The sums along the rows, computed for all the rows at once to access the columns
+  // contiguously, and the corresponding weights
+  line = box + bw*nrows;
+  for (y = 0; y < nrows; y++) {
+    line[y] = 0;
+  }
+  for (x = 0; x < size - 1; x++) {
+    for (y = 0; y < nrows; y++) {
+      line[y] += box[x*nrows + y];
+    }
+  }
+  for (x = 0; x < ncols; x++) {
+    const double *first = box + x*nrows, *last = box + (x + size - 1)*nrows;
+    const double *shifted = img + (x0+x+ox)*h + y0+oy, *orig = img + (x0+x)*h + y0;
+    double *curr_weights = weights + (x0+x-xa)*h + y0, *curr_sums = sums + (x0+x-xa)*h + y0;
+    double *shift_weights = weights + (x0+x+ox-xa)*h + y0+oy;
+    double *shift_sums = sums + (x0+x+ox-xa)*h + y0+oy;
+
+    for (y = 0; y < nrows; y++) {
+      run = line[y] + last[y];
+      line[y] = run - first[y];
+
+      // The cancellations could make the distance slightly negative
+      weight = exp(-((run > 0) ? run : 0) * scaling);
+
+      curr_weights[y] += weight;
+      curr_sums[y] += weight * shifted[y];
+      shift_weights[y] += weight;
+      shift_sums[y] += weight * orig[y];
+    }
+  }
+
+  return;
+}
+
+// Non-local means denoising using running sums, see fast_nl_means_mex.m
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+  mwSize h, w, nelem, k = 3, max_dist = 15, ph, pw, noffsets, ntiles, tile_size, x, y;
+  mwSignedIndex i;
+  double thresh = 0.05, scaling, *img, *padded, *weights, *sums, *res;
+  bool failed = false;
+
+  // Check for proper number of input and output arguments
+  if (nrhs < 1) {
+    mexErrMsgIdAndTxt("CAST:fast_nl_means_mex:invalidNumInputs",
+        "At least one input argument required.");
+  }
+  if (!is_supported_image(prhs[0]) || mxGetNumberOfDimensions(prhs[0]) > 2) {
+    mexErrMsgIdAndTxt("CAST:fast_nl_means_mex:invalidInput",
+        "Input argument (1) must be a 2D image of type uint8, uint16, single or double.");
+  }
+
+  h = mxGetM(prhs[0]);
+  w = mxGetN(prhs[0]);
+  nelem = h*w;
+
+  if (nrhs > 1 && !mxIsEmpty(prhs[1])) {
+    thresh = mxGetScalar(prhs[1]);
+  }
+  if (nrhs > 2 && !mxIsEmpty(prhs[2])) {
+    k = (mwSize)mxGetScalar(prhs[2]);
+  }
+  if (nrhs > 3 && !mxIsEmpty(prhs[3])) {
+    max_dist = (mwSize)mxGetScalar(prhs[3]);
+  }
+  if (!(thresh >= 0)) {
+    mexErrMsgIdAndTxt("CAST:fast_nl_means_mex:invalidInput",
+        "The width of the gaussian weights must be positive.");
+  }
+
+  plhs[0] = mxCreateDoubleMatrix(h, w, mxREAL);
+  res = mxGetPr(plhs[0]);
+  if (nelem == 0) {
+    return;
+  }
+
+  // Without noise, only the pixel itself has a non-zero weight
+  if (thresh == 0) {
+    copy_image(prhs[0], res);
+    return;
+  }
+
+  // The weights of the patches, exp(-d^2 / (2*T^2)) with d^2 the mean squared difference
+  scaling = 1 / (2 * thresh*thresh * (2*k+1)*(2*k+1));
+
+  // The image, and its padded version from which the patches are extracted
+  ph = h + 2*k;
+  pw = w + 2*k;
+  img = (double *)mxMalloc(nelem*sizeof(double));
+  padded = (double *)mxMalloc(ph*pw*sizeof(double));
+  copy_image(prhs[0], img);
+
+  for (x = 0; x < pw; x++) {
+    for (y = 0; y < ph; y++) {
+      padded[x*ph + y] = img[symmetric_index((mwSignedIndex)x - k, w)*h +
+                                     symmetric_index((mwSignedIndex)y - k, h)];
+    }
+  }
+
+  // Only half of the search offsets are needed, the other half being symmetric
+  noffsets = ((2*max_dist+1)*(2*max_dist+1) - 1) / 2;
+
+  // Every pixel is its own neighbor, with a distance of zero
+  weights = (double *)mxMalloc(nelem*sizeof(double));
+  sums = res;
+  for (x = 0; x < nelem; x++) {
+    weights[x] = 1;
+    sums[x] = img[x];
+  }
+
+  // The image is processed in tiles of columns, in parallel. As the offsets reach up
+  // to max_dist columns further, the weights of each tile are accumulated in a buffer
+  // covering these columns as well, before being added to the global ones
+  ntiles = (w + TILE_WIDTH - 1) / TILE_WIDTH;
+  tile_size = h * (TILE_WIDTH + max_dist);
+
+  #pragma omp parallel
+  {
+    double *box = (double *)malloc(h*(TILE_WIDTH+2*k+1)*sizeof(double));
+    double *tile_weights = (double *)malloc(2*tile_size*sizeof(double));
+    double *tile_sums = tile_weights + tile_size;
+    mwSignedIndex t, o, ox, oy, dist = max_dist;
+    mwSize xa, xb, p, npix;
+
+    if (box == NULL || tile_weights == NULL) {
+      #pragma omp critical
+      failed = true;
+    }
+
+    #pragma omp for schedule(dynamic)
+    for (t = 0; t < (mwSignedIndex)ntiles; t++) {
+      if (failed) {
+        continue;
+      }
+
+      xa = t*TILE_WIDTH;
+      xb = (xa + TILE_WIDTH < w) ? xa + TILE_WIDTH : w;
+      npix = h * (((xb + max_dist < w) ? xb + max_dist : w) - xa);
+
+      memset(tile_weights, 0, 2*tile_size*sizeof(double));
+
+      for (o = 0; o < (mwSignedIndex)noffsets; o++) {
+
+        // The offsets following (0,0) in the column-major order of the search window
+        ox = (o + dist + 1) / (2*dist + 1);
+        oy = (o + dist + 1) % (2*dist + 1) - dist;
+
+        if ((ox < (mwSignedIndex)w) && (oy < (mwSignedIndex)h) && (-oy < (mwSignedIndex)h)) {
+          accumulate_offset(img, padded, h, w, k, ox, oy, scaling, xa, xb, box,
+                            tile_weights, tile_sums);
+        }
+      }
+
+      // The buffers of neighboring tiles overlap
+      #pragma omp critical
+      {
+        for (p = 0; p < npix; p++) {
+          weights[xa*h + p] += tile_weights[p];
+          sums[xa*h + p] += tile_sums[p];
+        }
+      }
+    }
+
+    free(box);
+    free(tile_weights);
+  }
+
+  if (failed) {
+    mxFree(img);
+    mxFree(padded);
+    mxFree(weights);
+    mexErrMsgIdAndTxt("CAST:fast_nl_means_mex:outOfMemory",
+        "Memory allocation failed for the buffers of the threads !");
+  }
+
+  // The weighted average
+  #pragma omp parallel for schedule(static)
+  for (i = 0; i < (mwSignedIndex)nelem; i++) {
+    res[i] = sums[i] / weights[i];
+  }
+
+  mxFree(img);
+  mxFree(padded);
+  mxFree(weights);
+
+  return;
+}
@@ -0,0 +1,23 @@
+% FAST_NL_MEANS_MEX performs non-local means denoising [1] without any dimension
+% reduction of the patches, in parallel if compiled with OpenMP. It can be used as
+% the denoising function of imdenoise.m.
+%
+%   IMG = FAST_NL_MEANS_MEX(NOISY, T, K, MAX_DIST) denoises the 2D image NOISY
+%   by replacing each pixel by the average of the pixels within MAX_DIST, weighted
+%   by exp(-D^2 / (2*T^2)) with D^2 the mean squared difference between the patches of
+%   size 2*K+1 around them, the image being symmetrically padded. For every search
+%   offset, the distances between all the pairs of patches are computed at once
+%   using running sums of the squared differences between NOISY and its shifted
+%   version [2], in constant time with respect to K. The image is processed in
+%   tiles of columns, which bounds the memory used by each thread. NOISY can be of
+%   class uint8, uint16, single or double, and IMG is double. With T=0, no other
+%   pixel has any weight and IMG is NOISY converted to double.
+%
+%   IMG = FAST_NL_MEANS_MEX(NOISY) utilizes the default values of nl_means.m, that is
+%   T=0.05, K=3 and MAX_DIST=15.
+%
+% References:
+%   [1] Buades A, Coll B, Morel JM, "On image denoising methods". SIAM Multiscale Model
+%       Simul 4 (2005) 490-530.
+%   [2] Darbon J, Cunha A, Chan TF, Osher S, Jensen GJ, "Fast nonlocal filtering
+%       applied to electron cryomicroscopy". ISBI (2008) 1331-1334.
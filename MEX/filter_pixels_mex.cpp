@@ -0,0 +1,227 @@
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include "image_types.h"
+#include "mex.h"
+
+// The index of a pixel in a line of n pixels, the line being replicated beyond its
+// borders as in ctmf.c
+static inline mwSignedIndex replicate_index(mwSignedIndex i, mwSignedIndex n) {
+  return (i < 0) ? 0 : ((i >= n) ? n-1 : i);
+}
+
+// Same but with a symmetric padding as in imfilter
+static inline mwSignedIndex symmetric_index(mwSignedIndex i, mwSignedIndex n) {
+  i %= 2*n;
+  if (i < 0) {
+    i += 2*n;
+  }
+  return (i >= n) ? 2*n - 1 - i : i;
+}
+
+// Computes the median over a window of 2*radius+1 pixels around each of the npix
+// pixels at the 1-based indexes indx, as median_mex would. Floating point images are
+// rescaled to 16 bits using mymin and scaling (see rescaling_range).
+template<typename T>
+static void median_pixels(const T *img, T *vals, const double *indx, mwSize npix,
+                          mwSize h, mwSize w, mwSize radius, bool rescale,
+                          double mymin, double scaling) {
+
+  mwSize size = 2*radius + 1;
+  mwSignedIndex p;
+  double inv_scaling = (scaling > 0) ? 1/scaling : 0;
+
+  #pragma omp parallel
+  {
+    double *buf = (double *)malloc(size*size*sizeof(double));
+    mwSignedIndex x, y, i, j, r = radius;
+    mwSize n, index;
+    double val;
+
+    #pragma omp for schedule(static)
+    for (p = 0; p < (mwSignedIndex)npix; p++) {
+      index = (mwSize)indx[p] - 1;
+      x = index / h;
+      y = index % h;
+
+      n = 0;
+      for (i = x - r; i <= x + r; i++) {
+        for (j = y - r; j <= y + r; j++) {
+          val = (double)img[replicate_index(i, w)*h + replicate_index(j, h)];
+
+          // The same conversion as in median_float, NaN being the minimum
+          if (rescale) {
+            val = isnan(val) ? 0 : floor(scaling*(val - mymin) + 0.5);
+          }
+          buf[n++] = val;
+        }
+      }
+
+      // The kernel always has an odd number of pixels
+      std::nth_element(buf, buf + n/2, buf + n);
+      val = buf[n/2];
+
+      vals[p] = (rescale) ? (T)(val*inv_scaling + mymin) : (T)val;
+    }
+
+    free(buf);
+  }
+
+  return;
+}
+
+// Correlates the filter of size fh x fw with the image around each of the npix
+// pixels at the 1-based indexes indx, as imfilter with a symmetric padding would
+template<typename T>
+static void correlate_pixels(const T *img, double *vals, const double *indx, mwSize npix,
+                             mwSize h, mwSize w, const double *filter, mwSize fh, mwSize fw) {
+
+  mwSignedIndex p;
+
+  #pragma omp parallel for schedule(static)
+  for (p = 0; p < (mwSignedIndex)npix; p++) {
+    mwSize index = (mwSize)indx[p] - 1, i, j;
+    mwSignedIndex x = index / h - (fw-1)/2, y = index % h - (fh-1)/2, col;
+    double sum = 0;
+
+    for (i = 0; i < fw; i++) {
+      col = symmetric_index(x + i, w) * h;
+      for (j = 0; j < fh; j++) {
+        sum += filter[i*fh + j] * (double)img[col + symmetric_index(y + j, h)];
+      }
+    }
+    vals[p] = sum;
+  }
+
+  return;
+}
+
+// The range of values of a floating point image and the scaling factor used by
+// median_float in median_mex.cpp to convert it to 16 bits
+template<typename T>
+static void rescaling_range(const T *img, mwSize nelem, double *mymin, double *scaling) {
+
+  mwSize i;
+  double mymax;
+
+  *mymin = mxGetInf();
+  mymax = -*mymin;
+  for (i = 0; i < nelem; i++) {
+    if (img[i] < *mymin) {
+      *mymin = img[i];
+    }
+    if (img[i] > mymax) {
+      mymax = img[i];
+    }
+  }
+
+  if (*mymin > mymax) {
+    *mymin = mymax = 0;
+  }
+  *scaling = (mymax > *mymin) ? 65535 / (mymax - *mymin) : 0;
+
+  return;
+}
+
+// Filters an image at a few pixels only, see filter_pixels_mex.m
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+  mwSize h, w, nelem, npix, radius = 1, fh = 0, fw = 0, i;
+  double *indx, *filter = NULL, mymin = 0, scaling = 0;
+  mxClassID class_id;
+
+  // Check for proper number of input and output arguments
+  if (nrhs < 2) {
+    mexErrMsgIdAndTxt("CAST:filter_pixels_mex:invalidNumInputs",
+        "At least two input arguments required.");
+  }
+  if (!is_supported_image(prhs[0]) || mxGetNumberOfDimensions(prhs[0]) > 2) {
+    mexErrMsgIdAndTxt("CAST:filter_pixels_mex:invalidInput",
+        "Input argument (1) must be a 2D image of type uint8, uint16, single or double.");
+  }
+  if (!mxIsDouble(prhs[1])) {
+    mexErrMsgIdAndTxt("CAST:filter_pixels_mex:invalidInput",
+        "Input argument (2) must be a vector of double indexes.");
+  }
+
+  class_id = mxGetClassID(prhs[0]);
+  h = mxGetM(prhs[0]);
+  w = mxGetN(prhs[0]);
+  nelem = h*w;
+
+  indx = mxGetPr(prhs[1]);
+  npix = mxGetNumberOfElements(prhs[1]);
+  for (i = 0; i < npix; i++) {
+    if (indx[i] < 1 || indx[i] > nelem) {
+      mexErrMsgIdAndTxt("CAST:filter_pixels_mex:invalidInput",
+          "The indexes must be within the image.");
+    }
+  }
+
+  if (nrhs > 2 && !mxIsEmpty(prhs[2])) {
+    radius = (mwSize)mxGetScalar(prhs[2]);
+  }
+  if (nrhs > 3 && !mxIsEmpty(prhs[3])) {
+    if (!mxIsDouble(prhs[3]) || mxGetNumberOfDimensions(prhs[3]) > 2) {
+      mexErrMsgIdAndTxt("CAST:filter_pixels_mex:invalidInput",
+          "Input argument (4) must be a 2D double filter.");
+    }
+    filter = mxGetPr(prhs[3]);
+    fh = mxGetM(prhs[3]);
+    fw = mxGetN(prhs[3]);
+  }
+
+  // The correlation with the filter, computed in double as by imfilter
+  if (filter != NULL) {
+    plhs[0] = mxCreateDoubleMatrix(npix, 1, mxREAL);
+
+    switch (class_id) {
+      case mxUINT8_CLASS:
+        correlate_pixels((const unsigned char *)mxGetData(prhs[0]), mxGetPr(plhs[0]),
+                         indx, npix, h, w, filter, fh, fw);
+        break;
+      case mxUINT16_CLASS:
+        correlate_pixels((const unsigned short *)mxGetData(prhs[0]), mxGetPr(plhs[0]),
+                         indx, npix, h, w, filter, fh, fw);
+        break;
+      case mxSINGLE_CLASS:
+        correlate_pixels((const float *)mxGetData(prhs[0]), mxGetPr(plhs[0]),
+                         indx, npix, h, w, filter, fh, fw);
+        break;
+      default:
+        correlate_pixels((const double *)mxGetData(prhs[0]), mxGetPr(plhs[0]),
+                         indx, npix, h, w, filter, fh, fw);
+        break;
+    }
+
+    return;
+  }
+
+  // The median, which preserves the class of the image
+  plhs[0] = mxCreateNumericMatrix(npix, 1, class_id, mxREAL);
+
+  switch (class_id) {
+    case mxUINT8_CLASS:
+      median_pixels((const unsigned char *)mxGetData(prhs[0]),
+                    (unsigned char *)mxGetData(plhs[0]), indx, npix, h, w, radius, false, 0, 0);
+      break;
+    case mxUINT16_CLASS:
+      median_pixels((const unsigned short *)mxGetData(prhs[0]),
+                    (unsigned short *)mxGetData(plhs[0]), indx, npix, h, w, radius, false, 0, 0);
+      break;
+
+    // Floating point images are rescaled to 16 bits, as in median_mex
+    case mxSINGLE_CLASS:
+      rescaling_range((const float *)mxGetData(prhs[0]), nelem, &mymin, &scaling);
+      median_pixels((const float *)mxGetData(prhs[0]), (float *)mxGetData(plhs[0]),
+                    indx, npix, h, w, radius, true, mymin, scaling);
+      break;
+    default:
+      rescaling_range((const double *)mxGetData(prhs[0]), nelem, &mymin, &scaling);
+      median_pixels((const double *)mxGetData(prhs[0]), (double *)mxGetData(plhs[0]),
+                    indx, npix, h, w, radius, true, mymin, scaling);
+      break;
+  }
+
+  return;
+}
@@ -0,0 +1,14 @@
+% FILTER_PIXELS_MEX filters an image only at a few pixels, in parallel if compiled
+% with OpenMP, which is much faster than filtering the whole image when only a small
+% fraction of its pixels is required (see imhotpixels.m).
+%
+%   VALS = FILTER_PIXELS_MEX(IMG, INDX, RADIUS) returns the median over a 2*RADIUS+1
+%   square around the pixels of the 2D image IMG at the linear indexes INDX. VALS is
+%   identical to the corresponding values of MEDIAN_MEX(IMG, RADIUS), including the
+%   16 bits rescaling of the single and double images, and has the same class as IMG.
+%
+%   VALS = FILTER_PIXELS_MEX(IMG, INDX) utilizes the default value of RADIUS=1.
+%
+%   VALS = FILTER_PIXELS_MEX(IMG, INDX, [], FILTER) returns instead the correlation of
+%   FILTER with IMG at INDX, as IMFILTER(DOUBLE(IMG), FILTER, 'symmetric') would. In
+%   this case, VALS is a double vector.
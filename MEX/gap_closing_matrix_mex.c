@@ -0,0 +1,381 @@
+#include <math.h>
+#include "gaussian_spots.h"
+
+#include "gaussian_spots.c"
+
+// A compressed sparse matrix, either by columns (CSC, as in MATLAB) or by rows (CSR)
+typedef struct {
+  mwSize m, n;
+  mwIndex *jcs, *irs;
+  double *pr;
+} compressed_matrix;
+
+// The data required to assemble one column of the gap closing matrix
+typedef struct {
+  mwSize nends, nstarts, ninterm;
+  compressed_matrix bridging, merging, splitting;
+  compressed_matrix bridging_rows, merging_rows, splitting_rows;
+  double *alt_merge, *alt_split;
+  double alt_cost, min_dist;
+  bool is_full;
+} gap_closing_data;
+
+// Wraps a MATLAB sparse matrix
+static void get_compressed_matrix(compressed_matrix *mat, const mxArray *sparse) {
+
+  mat->m = mxGetM(sparse);
+  mat->n = mxGetN(sparse);
+  mat->jcs = mxGetJc(sparse);
+  mat->irs = mxGetIr(sparse);
+  mat->pr = mxGetPr(sparse);
+
+  return;
+}
+
+// Transposes a compressed matrix using a counting sort, such that the indexes in
+// each row are sorted as well
+static void transpose_compressed_matrix(const compressed_matrix *mat, compressed_matrix *trans) {
+
+  mwIndex i, j, k, nnz, *pos;
+
+  nnz = mat->jcs[mat->n];
+
+  trans->m = mat->n;
+  trans->n = mat->m;
+  trans->jcs = (mwIndex *)mxCalloc(mat->m+1, sizeof(mwIndex));
+  trans->irs = (mwIndex *)mxCalloc(__MAX__(nnz, 1), sizeof(mwIndex));
+  trans->pr = (double *)mxCalloc(__MAX__(nnz, 1), sizeof(double));
+  pos = (mwIndex *)mxCalloc(mat->m+1, sizeof(mwIndex));
+
+  for (k = 0; k < nnz; k++) {
+    trans->jcs[mat->irs[k]+1]++;
+  }
+  for (i = 0; i < mat->m; i++) {
+    trans->jcs[i+1] += trans->jcs[i];
+    pos[i] = trans->jcs[i];
+  }
+  for (j = 0; j < mat->n; j++) {
+    for (k = mat->jcs[j]; k < mat->jcs[j+1]; k++) {
+      i = mat->irs[k];
+      trans->irs[pos[i]] = j;
+      trans->pr[pos[i]] = mat->pr[k];
+      pos[i]++;
+    }
+  }
+
+  mxFree(pos);
+
+  return;
+}
+
+// Frees the memory allocated by transpose_compressed_matrix
+static void free_compressed_matrix(compressed_matrix *mat) {
+
+  mxFree(mat->jcs);
+  mxFree(mat->irs);
+  mxFree(mat->pr);
+
+  return;
+}
+
+// Stores one element of the column, skipping zeros as sparse() would do
+static void store_element(mwIndex row, double val, mwIndex *irs, double *rs, mwSize *count) {
+
+  if (val != 0) {
+    if (irs != NULL) {
+      irs[*count] = row;
+      rs[*count] = val;
+    }
+    (*count)++;
+  }
+
+  return;
+}
+
+// Copies one column or row of a compressed matrix, shifting its indexes and
+// replacing its values by val unless it is NaN
+static void store_vector(const compressed_matrix *mat, mwIndex j, mwIndex shift, double val,
+                         mwIndex *irs, double *rs, mwSize *count) {
+
+  mwIndex k;
+
+  for (k = mat->jcs[j]; k < mat->jcs[j+1]; k++) {
+    store_element(mat->irs[k] + shift, (isnan(val) ? mat->pr[k] : val), irs, rs, count);
+  }
+
+  return;
+}
+
+// Assembles column c of the matrix of [1], storing its elements only if irs is not
+// NULL. Rows are produced in increasing order. Returns the number of elements.
+static mwSize gap_closing_column(const gap_closing_data *data, mwIndex c, mwIndex *irs, double *rs) {
+
+  mwIndex offset;
+  mwSize count;
+  double nan;
+
+  count = 0;
+  nan = NAN;
+  offset = data->nends + data->ninterm;
+
+  // Bridging, splitting and no gap "b"
+  if (c < data->nstarts) {
+    store_vector(&data->bridging, c, 0, nan, irs, rs, &count);
+    store_vector(&data->splitting_rows, c, data->nends, nan, irs, rs, &count);
+
+    if (data->is_full) {
+      store_element(c + offset, data->alt_cost, irs, rs, &count);
+    }
+
+    return count;
+  }
+  c -= data->nstarts;
+
+  // Merging and no merging "b'"
+  if (c < data->ninterm) {
+    store_vector(&data->merging, c, 0, nan, irs, rs, &count);
+
+    if (data->is_full) {
+      store_element(c + offset + data->nstarts, data->alt_merge[c], irs, rs, &count);
+    }
+
+    return count;
+  }
+  c -= data->ninterm;
+
+  // No gap "d" and the transpose of the bridging and merging parts
+  if (c < data->nends) {
+    store_element(c, data->alt_cost, irs, rs, &count);
+    store_vector(&data->bridging_rows, c, offset, data->min_dist, irs, rs, &count);
+    store_vector(&data->merging_rows, c, offset + data->nstarts, data->min_dist, irs, rs, &count);
+
+    return count;
+  }
+  c -= data->nends;
+
+  // No splitting "d'" and the transpose of the splitting part
+  store_element(c + data->nends, data->alt_split[c], irs, rs, &count);
+  store_vector(&data->splitting, c, offset, data->min_dist, irs, rs, &count);
+
+  return count;
+}
+
+// Places the k-th smallest value at position k, smaller ones before it and
+// larger ones after it, in linear time on average (Hoare's selection)
+static void select_kth(double *vals, mwSize n, mwIndex k) {
+
+  mwSignedIndex left, right, i, j;
+  double pivot, tmp;
+
+  left = 0;
+  right = n-1;
+
+  while (left < right) {
+    pivot = vals[left + (right - left)/2];
+    i = left;
+    j = right;
+
+    // Partition around the pivot, values equal to it ending between j and i
+    while (i <= j) {
+      while (vals[i] < pivot) {
+        i++;
+      }
+      while (pivot < vals[j]) {
+        j--;
+      }
+      if (i <= j) {
+        tmp = vals[i];
+        vals[i] = vals[j];
+        vals[j] = tmp;
+        i++;
+        j--;
+      }
+    }
+
+    // And continue only in the part containing k
+    if ((mwSignedIndex)k <= j) {
+      right = j;
+    } else if ((mwSignedIndex)k >= i) {
+      left = i;
+    } else {
+      break;
+    }
+  }
+
+  return;
+}
+
+// Computes the alternative cost as in track_spots, namely slightly below the 90th
+// percentile of the costs as computed by prctile, and the smallest cost
+static void alternative_costs(gap_closing_data *data) {
+
+  mwIndex i, k, lower;
+  mwSize nvals, nnz[3];
+  double *vals, *pr[3], pos, upper;
+
+  nnz[0] = data->bridging.jcs[data->bridging.n];
+  nnz[1] = data->merging.jcs[data->merging.n];
+  nnz[2] = data->splitting.jcs[data->splitting.n];
+  pr[0] = data->bridging.pr;
+  pr[1] = data->merging.pr;
+  pr[2] = data->splitting.pr;
+
+  // Use some default values if no gap can be closed
+  if (nnz[0] + nnz[1] + nnz[2] == 0) {
+    data->alt_cost = 1;
+    data->min_dist = 0.1;
+
+    return;
+  }
+
+  // prctile ignores NaN values
+  vals = (double *)mxCalloc(nnz[0] + nnz[1] + nnz[2], sizeof(double));
+  nvals = 0;
+  for (i = 0; i < 3; i++) {
+    for (k = 0; k < nnz[i]; k++) {
+      if (!mxIsNaN(pr[i][k])) {
+        vals[nvals] = pr[i][k];
+        nvals++;
+      }
+    }
+  }
+
+  if (nvals == 0) {
+    data->alt_cost = mxGetNaN();
+    data->min_dist = mxGetNaN();
+    mxFree(vals);
+
+    return;
+  }
+
+  // The minimum is a simple scan
+  data->min_dist = vals[0];
+  for (k = 1; k < nvals; k++) {
+    data->min_dist = __MIN__(data->min_dist, vals[k]);
+  }
+
+  // prctile places the sorted values at 100*(i-0.5)/n and interpolates linearly
+  // between them, hence the 90th percentile sits at position 0.9*n + 0.5
+  pos = 0.9*nvals + 0.5;
+
+  if (pos >= nvals) {
+    select_kth(vals, nvals, nvals-1);
+    data->alt_cost = vals[nvals-1];
+  } else {
+    lower = (mwIndex)floor(pos);
+
+    // Only the two neighboring order statistics are needed
+    select_kth(vals, nvals, lower-1);
+    upper = vals[lower];
+    for (k = lower+1; k < nvals; k++) {
+      upper = __MIN__(upper, vals[k]);
+    }
+
+    data->alt_cost = vals[lower-1] + (pos - lower)*(upper - vals[lower-1]);
+  }
+  data->alt_cost *= 0.999;
+
+  mxFree(vals);
+
+  return;
+}
+
+// The main of the MATLAB interface
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  // Declare variable
+  mwSignedIndex i;
+  mwSize ncols, nrows;
+  mwIndex *irs, *jcs, *counts;
+  double *rs;
+  gap_closing_data data;
+
+  // Check for proper number of input and output arguments
+  if (nrhs != 6) {
+    mexErrMsgIdAndTxt( "CAST:gap_closing_matrix_mex:invalidNumInputs",
+        "Six input arguments required.");
+  }
+
+  // Check data type of input argument
+  for (i = 0; i < 3; i++) {
+    if (!(mxIsSparse(prhs[i]) && mxIsDouble(prhs[i]))) {
+      mexErrMsgIdAndTxt( "CAST:gap_closing_matrix_mex:inputNotSparse",
+          "Input arguments (1-3) must be of type double sparse.");
+    }
+  }
+  if (!(mxIsDouble(prhs[3]) && mxIsDouble(prhs[4]) && !mxIsSparse(prhs[3]) && !mxIsSparse(prhs[4]))) {
+    mexErrMsgIdAndTxt( "CAST:gap_closing_matrix_mex:inputNotDouble",
+        "Input arguments (4, 5) must be of type double.");
+  }
+
+  // Get the three cost matrices
+  get_compressed_matrix(&data.bridging, prhs[0]);
+  get_compressed_matrix(&data.merging, prhs[1]);
+  get_compressed_matrix(&data.splitting, prhs[2]);
+
+  data.nends = data.bridging.m;
+  data.nstarts = data.bridging.n;
+  data.ninterm = data.merging.n;
+
+  if (data.merging.m != data.nends || data.splitting.m != data.nstarts || data.splitting.n != data.ninterm) {
+    mexErrMsgIdAndTxt( "CAST:gap_closing_matrix_mex:invalidSize",
+        "The sizes of the bridging, merging and splitting matrices do not match.");
+  }
+  if (mxGetNumberOfElements(prhs[3]) != data.ninterm || mxGetNumberOfElements(prhs[4]) != data.ninterm) {
+    mexErrMsgIdAndTxt( "CAST:gap_closing_matrix_mex:invalidSize",
+        "There must be one alternative cost per intermediate spot.");
+  }
+
+  data.alt_merge = mxGetPr(prhs[3]);
+  data.alt_split = mxGetPr(prhs[4]);
+  data.is_full = (mxGetScalar(prhs[5]) != 0);
+
+  // The transposed parts are required to fill the columns in order
+  transpose_compressed_matrix(&data.bridging, &data.bridging_rows);
+  transpose_compressed_matrix(&data.merging, &data.merging_rows);
+  transpose_compressed_matrix(&data.splitting, &data.splitting_rows);
+
+  // The cost for no linking
+  alternative_costs(&data);
+
+  // Only the upper left part of the matrix is built if not full
+  if (data.is_full) {
+    nrows = ncols = data.nstarts + data.nends + 2*data.ninterm;
+  } else {
+    nrows = data.nends + data.ninterm;
+    ncols = data.nstarts + data.ninterm;
+  }
+
+  // First count the number of elements in each column, to allocate exactly the
+  // required memory, then fill them in parallel.
+  counts = (mwIndex *)mxCalloc(ncols+1, sizeof(mwIndex));
+
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (i = 0; i < (mwSignedIndex)ncols; i++) {
+    counts[i+1] = gap_closing_column(&data, i, NULL, NULL);
+  }
+
+  // Prepare the output
+  plhs[0] = create_sparse_from_counts(nrows, ncols, counts);
+  rs  = mxGetPr(plhs[0]);
+  irs = mxGetIr(plhs[0]);
+  jcs = mxGetJc(plhs[0]);
+
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (i = 0; i < (mwSignedIndex)ncols; i++) {
+    gap_closing_column(&data, i, irs + jcs[i], rs + jcs[i]);
+  }
+
+  // And the alternative costs
+  if (nlhs > 1) {
+    plhs[1] = mxCreateDoubleScalar(data.alt_cost);
+  }
+  if (nlhs > 2) {
+    plhs[2] = mxCreateDoubleScalar(data.min_dist);
+  }
+
+  mxFree(counts);
+  free_compressed_matrix(&data.bridging_rows);
+  free_compressed_matrix(&data.merging_rows);
+  free_compressed_matrix(&data.splitting_rows);
+}
@@ -0,0 +1,23 @@
+% GAP_CLOSING_MATRIX_MEX assembles the gap closing cost matrix of track_spots.
+%
+%   [DIST, ALT_COST, MIN_DIST] = GAP_CLOSING_MATRIX_MEX(BRIDGING, MERGING, SPLITTING,
+%   ALT_MERGE, ALT_SPLIT, IS_FULL) builds the sparse cost matrix DIST of the gap
+%   closing problem from the sparse BRIDGING (NENDS x NSTARTS), MERGING (NENDS x
+%   NINTERM) and SPLITTING (NSTARTS x NINTERM) cost matrices, and from the costs for
+%   not merging ALT_MERGE and for not splitting ALT_SPLIT (NINTERM x 1). ALT_COST is
+%   the cost for not closing a gap, namely 0.999 times the 90th percentile of all
+%   the provided costs as computed by PRCTILE, while MIN_DIST is the smallest of
+%   them. If no cost is provided, ALT_COST is 1 and MIN_DIST is 0.1.
+%
+%   If IS_FULL is true, DIST is the whole square matrix of [1], including the costs
+%   for no linking and the lower right block required for symmetry. Otherwise, DIST
+%   is only its upper left part [BRIDGING MERGING; SPLITTING.' 0], as required by
+%   LAP_ALTERNATIVE_SPARSE_MEX.
+%
+%   This is equivalent to, yet much faster and lighter than, extracting the indexes
+%   of the three matrices and assembling them using SPARSE.
+%
+% References:
+%   [1] Jaqaman K, Loerke D, Mettlen M, Kuwata H, Grinstein S, et al. Robust
+%       single-particle tracking in live-cell time-lapse sequences. Nat Methods 5:
+%       695-702 (2008).
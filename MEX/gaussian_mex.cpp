@@ -2,27 +2,39 @@
 #include <stdlib.h>
 #include <string.h> 
 #include "gaussian_smooth.h"
+#include "image_types.h"
 #include "mex.h"
 
 #include "gaussian_smooth.c"
 
+/* Above this sigma, the recursive filter is faster than the convolution */
+#define RECURSIVE_SIGMA 10
+
 /* A Matlab wrapper for the code of Anthony Gabrielson (see gaussian_smooth.c)*/
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
 
   /* Declare a few variables. */
   int h, w;
+  bool is_recursive;
   double *img, sigma;
 
   /* No flexibility here, we want both the image and sigma ! */
   if (nrhs < 2) {
     mexErrMsgTxt("Not enough input arguments (2 are required) !");
-  } else if (!mxIsDouble(prhs[0])) {
-    mexErrMsgTxt("Input array is not of type Double");
+  } else if (!is_supported_image(prhs[0])) {
+    mexErrMsgTxt("Input array should be of type uint8, uint16, single or double");
   }
 
   /* Get sigma. */
   sigma = mxGetScalar(prhs[1]);
 
+  /* Choose the type of filter. */
+  if (nrhs > 2 && !mxIsEmpty(prhs[2])) {
+    is_recursive = (mxGetScalar(prhs[2]) != 0);
+  } else {
+    is_recursive = (sigma > RECURSIVE_SIGMA);
+  }
+
   /* Get the size of the image. */
   h = mxGetM(prhs[0]);
   w = mxGetN(prhs[0]);
@@ -31,12 +43,14 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
   plhs[0] = mxCreateDoubleMatrix(h, w, mxREAL);
   img = mxGetPr(plhs[0]);
 
-  /* Copy the input to the working image. */
-  memcpy(img, mxGetPr(prhs[0]), h*w*sizeof(double)); 
+  /* Copy the input to the working image, converting it if need be. */
+  copy_image(prhs[0], img);
 
   /* Verify that sigma is valid, and let's go ! */
   if (sigma <= 0) {
     mexWarnMsgTxt("Gaussian smoothing with invalid sigma !");
+  } else if (is_recursive) {
+    gaussian_smooth_recursive(img, w, h, sigma);
   } else {
     gaussian_smooth(img, w, h, sigma);
   }
@@ -2,6 +2,16 @@
 % Gabrielson to do the actual computations (see MEX/gaussian_smooth.c).
 %
 %   GAU = GAUSSIAN_MEX(IMG, SIGMA) applies a gaussian filtering with a SIGMA kernal.
+%   IMG can be of class uint8, uint16, single or double, GAU being always double.
+%   For SIGMA larger than 10, a recursive approximation of the gaussian filter [1] is
+%   used instead of the convolution, the cost of which does not depend on SIGMA.
+%
+%   GAU = GAUSSIAN_MEX(IMG, SIGMA, IS_RECURSIVE) forces the use of the recursive
+%   filter, or of the convolution.
+%
+% References:
+%   [1] I.T. Young and L.J. van Vliet, "Recursive implementation of the Gaussian
+%       filter", Signal Processing, Vol. 44, pp. 139-151, 1995.
 %
 % Gonczy & Naef labs, EPFL
 % Simon Blanchoud
@@ -1,9 +1,26 @@
 #include <math.h>
 #include <stdlib.h>
-#include <string.h> 
+#include <string.h>
 #include "mex.h"
 #include "gaussian_smooth.h"
 
+/* The vector instructions available, SSE2 being part of any x86-64 processor */
+#if defined(__AVX__)
+#include <immintrin.h>
+#define GAUSS_VECTOR 4
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define GAUSS_VECTOR 2
+#else
+#define GAUSS_VECTOR 1
+#endif
+
+/* The number of columns processed at once in the y - direction, small enough for
+ * the rows of the kernel window to fit in the cache, and the number of rows per
+ * thread, large enough for them to be reused. */
+#define GAUSS_BLOCK 256
+#define GAUSS_CHUNK 32
+
 /*******************************************************************************
 * Adapted from MathWorks :
 *
@@ -13,25 +30,77 @@
 *
 * 29 Jul 2008 (Updated 30 Jul 2008)
 *
-* Code covered by the BSD License 
+* Code covered by the BSD License
 * http://www.mathworks.com/matlabcentral/fileexchange/20899-canny-edge-detection
-* 
+*
 *******************************************************************************/
+
+/*******************************************************************************
+* PROCEDURE: weighted_add
+* PURPOSE: Adds a weighted vector to another one, out += weight * in, using the
+* vector instructions of the processor if possible.
+*******************************************************************************/
+static void weighted_add(double *out, const double *in, double weight, int n)
+{
+   int i = 0;
+
+#if GAUSS_VECTOR == 4
+   __m256d w = _mm256_set1_pd(weight);
+   for(;i+4<=n;i+=4){
+      _mm256_storeu_pd(out+i, _mm256_add_pd(_mm256_loadu_pd(out+i),
+                                            _mm256_mul_pd(w, _mm256_loadu_pd(in+i))));
+   }
+#elif GAUSS_VECTOR == 2
+   __m128d w = _mm_set1_pd(weight);
+   for(;i+2<=n;i+=2){
+      _mm_storeu_pd(out+i, _mm_add_pd(_mm_loadu_pd(out+i),
+                                      _mm_mul_pd(w, _mm_loadu_pd(in+i))));
+   }
+#endif
+
+   for(;i<n;i++){
+      out[i] += weight * in[i];
+   }
+}
+
+/*******************************************************************************
+* PROCEDURE: kernel_sums
+* PURPOSE: Computes, for each position along a dimension of size n, the sum of the
+* kernel weights falling inside the image, used to normalize the borders.
+*******************************************************************************/
+static void kernel_sums(const double *kernel, int center, int n, double *sums)
+{
+   int i, k;
+
+   for(i=0;i<n;i++){
+      sums[i] = 0.0;
+      for(k=(-center);k<=center;k++){
+         if(((i+k) >= 0) && ((i+k) < n)){
+            sums[i] += kernel[center+k];
+         }
+      }
+   }
+}
+
 /*******************************************************************************
 * PROCEDURE: gaussian_smooth
 * PURPOSE: Blur an image with a gaussian filter.
 * NAME: Mike Heath
 * DATE: 2/15/96
+*
+* The border checks are moved out of the inner loops by restricting the range of
+* each kernel tap, such that the products are accumulated in the same order. Rows,
+* and blocks of columns, are processed in parallel.
 *******************************************************************************/
 void gaussian_smooth(double *image, int rows, int cols, double sigma)
 {
-   int r, c, rr, cc,     /* Counter variables. */
-      windowsize,        /* Dimension of the gaussian kernel. */
+   int windowsize,        /* Dimension of the gaussian kernel. */
       center;            /* Half of the windowsize. */
+   mwSignedIndex r, b;   /* Counter variables. */
    double *tempim,        /* Buffer for separable filter gaussian smoothing. */
          *kernel,        /* A one dimensional gaussian kernel. */
-         dot,            /* Dot product summing variable. */
-         sum;            /* Sum of the kernel weights variable. */
+         *row_sums,      /* Sum of the kernel weights in each row. */
+         *col_sums;      /* Sum of the kernel weights in each column. */
 
    /****************************************************************************
    * Create a 1-dimensional gaussian smoothing kernel.
@@ -40,48 +109,242 @@ void gaussian_smooth(double *image, int rows, int cols, double sigma)
    center = windowsize / 2;
 
    /****************************************************************************
-   * Allocate a temporary buffer image and the smoothed image.
+   * Allocate a temporary buffer image and the normalization vectors.
    ****************************************************************************/
-   if((tempim = mxCalloc(rows*cols, sizeof(double))) == NULL){
+   if((tempim = (double *)mxCalloc((mwSize)rows*cols, sizeof(double))) == NULL){
       mexErrMsgTxt("Memory allocation failed for the buffer image !");
    }
+   col_sums = (double *)mxCalloc(cols, sizeof(double));
+   row_sums = (double *)mxCalloc(rows, sizeof(double));
+   kernel_sums(kernel, center, cols, col_sums);
+   kernel_sums(kernel, center, rows, row_sums);
 
    /****************************************************************************
    * Blur in the x - direction.
    ****************************************************************************/
+   #pragma omp parallel for schedule(static)
    for(r=0;r<rows;r++){
+      int c, cc, cmin, cmax;
+      double *in = image + (mwSize)r*cols,
+             *out = tempim + (mwSize)r*cols;
+
+      for(cc=(-center);cc<=center;cc++){
+         cmin = (cc < 0) ? -cc : 0;
+         cmax = (cc > 0) ? cols-cc : cols;
+         if(cmin < cmax){
+            weighted_add(out+cmin, in+cmin+cc, kernel[center+cc], cmax-cmin);
+         }
+      }
       for(c=0;c<cols;c++){
-         dot = 0.0;
-         sum = 0.0;
-         for(cc=(-center);cc<=center;cc++){
-            if(((c+cc) >= 0) && ((c+cc) < cols)){
-               dot += image[r*cols+(c+cc)] * kernel[center+cc];
-               sum += kernel[center+cc];
+         out[c] /= col_sums[c];
+      }
+   }
+
+   /****************************************************************************
+   * Blur in the y - direction, by chunks of rows and blocks of columns.
+   ****************************************************************************/
+   #pragma omp parallel for schedule(dynamic, 1)
+   for(b=0;b<(rows+GAUSS_CHUNK-1)/GAUSS_CHUNK;b++){
+      int y, c, rr, cb, n, rend;
+      double *out;
+
+      rend = (int)((b+1)*GAUSS_CHUNK < rows ? (b+1)*GAUSS_CHUNK : rows);
+
+      for(cb=0;cb<cols;cb+=GAUSS_BLOCK){
+         n = (cols-cb < GAUSS_BLOCK) ? cols-cb : GAUSS_BLOCK;
+
+         for(y=(int)b*GAUSS_CHUNK;y<rend;y++){
+            out = image + (mwSize)y*cols + cb;
+            memset(out, 0, n*sizeof(double));
+
+            for(rr=(-center);rr<=center;rr++){
+               if(((y+rr) >= 0) && ((y+rr) < rows)){
+                  weighted_add(out, tempim + (mwSize)(y+rr)*cols + cb, kernel[center+rr], n);
+               }
+            }
+            for(c=0;c<n;c++){
+               out[c] /= row_sums[y];
             }
          }
-         tempim[r*cols+c] = dot/sum;
       }
    }
 
+   mxFree(tempim);
+   mxFree(kernel);
+   mxFree(row_sums);
+   mxFree(col_sums);
+}
+
+/*******************************************************************************
+* PROCEDURE: recursive_coefficients
+* PURPOSE: Computes the coefficients of the recursive gaussian filter of Young &
+* van Vliet [1], as {B, b1/b0, b2/b0, b3/b0}.
+*
+* [1] I.T. Young and L.J. van Vliet, "Recursive implementation of the Gaussian
+*     filter", Signal Processing, Vol. 44, pp. 139-151, 1995.
+*******************************************************************************/
+static void recursive_coefficients(double sigma, double *coefs)
+{
+   double q, q2, q3, b0;
+
+   if(sigma >= 2.5){
+      q = 0.98711*sigma - 0.96330;
+   } else {
+      q = 3.97156 - 4.14554*sqrt(1 - 0.26891*sigma);
+   }
+   q2 = q*q;
+   q3 = q2*q;
+
+   b0 = 1.57825 + 2.44413*q + 1.4281*q2 + 0.422205*q3;
+   coefs[1] = (2.44413*q + 2.85619*q2 + 1.26661*q3) / b0;
+   coefs[2] = -(1.4281*q2 + 1.26661*q3) / b0;
+   coefs[3] = 0.422205*q3 / b0;
+   coefs[0] = 1 - (coefs[1] + coefs[2] + coefs[3]);
+}
+
+/*******************************************************************************
+* PROCEDURE: recursive_line
+* PURPOSE: Filters one line of n values separated by step, both forward and
+* backward, the values outside the line being zeros. The forward pass is carried
+* on pad values past the end such that the backward pass also sees its tail.
+* tmp is a buffer of n+pad values.
+*******************************************************************************/
+static void recursive_line(double *line, int n, mwSize step, int pad, const double *coefs, double *tmp)
+{
+   int i;
+   double w1, w2, w3;
+
+   w1 = w2 = w3 = 0.0;
+   for(i=0;i<n+pad;i++){
+      tmp[i] = coefs[1]*w1 + coefs[2]*w2 + coefs[3]*w3;
+      if(i < n){
+         tmp[i] += coefs[0]*line[i*step];
+      }
+      w3 = w2;
+      w2 = w1;
+      w1 = tmp[i];
+   }
+
+   w1 = w2 = w3 = 0.0;
+   for(i=n+pad-1;i>=0;i--){
+      tmp[i] = coefs[0]*tmp[i] + coefs[1]*w1 + coefs[2]*w2 + coefs[3]*w3;
+      w3 = w2;
+      w2 = w1;
+      w1 = tmp[i];
+   }
+
+   for(i=0;i<n;i++){
+      line[i*step] = tmp[i];
+   }
+}
+
+/*******************************************************************************
+* PROCEDURE: gaussian_smooth_recursive
+* PURPOSE: Blur an image with a recursive approximation of the gaussian filter,
+* the cost of which does not depend on sigma. As in gaussian_smooth, the image is
+* considered to be zero outside and the result is normalized by the weights that
+* fall inside of it.
+*******************************************************************************/
+void gaussian_smooth_recursive(double *image, int rows, int cols, double sigma)
+{
+   int i, pad;
+   mwSignedIndex r, b;
+   double coefs[4],
+         *tempim,        /* Buffer for the passes, padded after the last row. */
+         *row_sums,      /* The filtered constant image, for normalization. */
+         *col_sums;
+
+   recursive_coefficients(sigma, coefs);
+
+   /* The length over which the causal response is still significant */
+   pad = (int)ceil(3*sigma);
+
+   tempim = (double *)mxCalloc((mwSize)(rows+pad)*cols, sizeof(double));
+   col_sums = (double *)mxCalloc(cols, sizeof(double));
+   row_sums = (double *)mxCalloc(rows, sizeof(double));
+
+   /****************************************************************************
+   * The normalization weights, filtering a constant line.
+   ****************************************************************************/
+   for(i=0;i<cols;i++){
+      col_sums[i] = 1.0;
+   }
+   for(i=0;i<rows;i++){
+      row_sums[i] = 1.0;
+   }
+   recursive_line(col_sums, cols, 1, pad, coefs, tempim);
+   recursive_line(row_sums, rows, 1, pad, coefs, tempim);
+
    /****************************************************************************
-   * Blur in the y - direction.
+   * Blur in the x - direction, each row being independent.
    ****************************************************************************/
-   for(c=0;c<cols;c++){
+   #pragma omp parallel
+   {
+      int c;
+      double *line,
+            *tmprow = (double *)malloc((mwSize)(cols+pad)*sizeof(double));
+
+      #pragma omp for schedule(static)
       for(r=0;r<rows;r++){
-         sum = 0.0;
-         dot = 0.0;
-         for(rr=(-center);rr<=center;rr++){
-            if(((r+rr) >= 0) && ((r+rr) < rows)){
-               dot += tempim[(r+rr)*cols+c] * kernel[center+rr];
-               sum += kernel[center+rr];
-            }
+         line = image + (mwSize)r*cols;
+
+         recursive_line(line, cols, 1, pad, coefs, tmprow);
+         for(c=0;c<cols;c++){
+            line[c] /= col_sums[c];
+         }
+      }
+
+      free(tmprow);
+   }
+
+   /****************************************************************************
+   * Blur in the y - direction, processing whole blocks of columns at once.
+   ****************************************************************************/
+   #pragma omp parallel for schedule(dynamic, 1)
+   for(b=0;b<(cols+GAUSS_BLOCK-1)/GAUSS_BLOCK;b++){
+      int c, k, n, rr, cb;
+      double *out;
+
+      cb = (int)b*GAUSS_BLOCK;
+      n = (cols-cb < GAUSS_BLOCK) ? cols-cb : GAUSS_BLOCK;
+
+      /* Forward, from the image into the buffer and over its padding */
+      for(rr=0;rr<rows+pad;rr++){
+         out = tempim + (mwSize)rr*cols + cb;
+
+         memset(out, 0, n*sizeof(double));
+         if(rr < rows){
+            weighted_add(out, image + (mwSize)rr*cols + cb, coefs[0], n);
+         }
+         for(k=1;k<=3 && rr-k>=0;k++){
+            weighted_add(out, out - (mwSize)k*cols, coefs[k], n);
+         }
+      }
+
+      /* Backward, in place in the buffer */
+      for(rr=rows+pad-1;rr>=0;rr--){
+         out = tempim + (mwSize)rr*cols + cb;
+
+         for(c=0;c<n;c++){
+            out[c] *= coefs[0];
+         }
+         for(k=1;k<=3 && rr+k<rows+pad;k++){
+            weighted_add(out, out + (mwSize)k*cols, coefs[k], n);
+         }
+      }
+
+      /* And normalize back into the image, once the recursion is over */
+      for(rr=0;rr<rows;rr++){
+         out = image + (mwSize)rr*cols + cb;
+         for(c=0;c<n;c++){
+            out[c] = tempim[(mwSize)rr*cols + cb + c] / row_sums[rr];
          }
-         image[r*cols+c] = dot/sum;
       }
    }
 
    mxFree(tempim);
-   mxFree(kernel);
+   mxFree(row_sums);
+   mxFree(col_sums);
 }
 
 /*******************************************************************************
@@ -100,7 +363,7 @@ void make_gaussian_kernel(double sigma, double **kernel, int *windowsize)
    *windowsize = 1 + 2 * ceil(2.5 * sigma);
    center = (*windowsize) / 2;
 
-   if((*kernel = mxCalloc((*windowsize), sizeof(double))) == NULL){
+   if((*kernel = (double *)mxCalloc((*windowsize), sizeof(double))) == NULL){
       mexErrMsgTxt("Memory allocation failed for kernel !");
    }
 
@@ -113,4 +376,3 @@ void make_gaussian_kernel(double sigma, double **kernel, int *windowsize)
 
    for(i=0;i<(*windowsize);i++) (*kernel)[i] /= sum;
 }
-
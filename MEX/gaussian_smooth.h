@@ -10,6 +10,7 @@ extern "C" {
 #endif
 
 void gaussian_smooth(double *image, int rows, int cols, double sigma);
+void gaussian_smooth_recursive(double *image, int rows, int cols, double sigma);
 void make_gaussian_kernel(double sigma, double **kernel, int *windowsize);
 
 #ifdef __cplusplus
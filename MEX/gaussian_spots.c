@@ -1,4 +1,5 @@
 #include <math.h> // Needed for the ceil() prototype
+#include <string.h>
 #include "gaussian_spots.h"
 
 /// Approximation of the exponential function from :
@@ -113,3 +114,172 @@ double get_prev_signal(int frame, int spot_indx, const mxArray *spots, const mxA
   // Retrieve the signal of the corresponding spot
   return get_signal(child_frame, child_indx, spots);
 }
+
+// Creates a sparse matrix with exactly the required number of elements, provided
+// the number of elements in each column (stored in counts[1:n]). counts is
+// converted in place to the column indexes of the sparse matrix.
+mxArray *create_sparse_from_counts(mwSize m, mwSize n, mwIndex *counts) {
+
+  mwIndex i, *jcs;
+  mxArray *sparse;
+
+  // The cumulative sum provides the index of the first element of each column
+  counts[0] = 0;
+  for (i = 0; i < n; i++) {
+    counts[i+1] += counts[i];
+  }
+
+  // MATLAB requires at least one element to be allocated
+  sparse = mxCreateSparse(m, n, __MAX__(counts[n], 1), mxREAL);
+  jcs = mxGetJc(sparse);
+  memcpy(jcs, counts, (n+1)*sizeof(mwIndex));
+
+  return sparse;
+}
+
+// Converts a (frame, spot) pair into the global numbering of the index, -1 if invalid
+static mwSignedIndex get_global_index(const links_index *index, double frame, double spot_indx) {
+
+  mwIndex f, s;
+
+  if (!(frame >= 0 && frame < index->nframes && spot_indx >= 0)) {
+    return -1;
+  }
+
+  f = (mwIndex)frame;
+  s = (mwIndex)spot_indx;
+  if (s >= index->offsets[f+1] - index->offsets[f]) {
+    return -1;
+  }
+
+  return (mwSignedIndex)(index->offsets[f] + s);
+}
+
+// Builds the index of the links once, such that the predecessor and the successor
+// of a spot are retrieved in constant time, instead of parsing the links each time.
+// When several links exist, the first one found by get_prev_signal/get_next_signal
+// is the one stored.
+void build_links_index(links_index *index, const mxArray *spots, const mxArray *links) {
+
+  mwSize m, n, nframes, nlinks;
+  mwIndex i, j, k;
+  mwSignedIndex curr, prev;
+  const mxArray *cell_element_ptr;
+  double *spot, *curr_indx, *prev_indx, *frame_indx;
+
+  nframes = mxGetNumberOfElements(spots);
+  index->nframes = nframes;
+  index->offsets = (mwIndex *)mxCalloc(nframes+1, sizeof(mwIndex));
+
+  // The CSR offsets of each frame
+  for (i = 0; i < nframes; i++) {
+    cell_element_ptr = mxGetCell(spots, i);
+    m = (cell_element_ptr == NULL) ? 0 : mxGetM(cell_element_ptr);
+    index->offsets[i+1] = index->offsets[i] + m;
+  }
+
+  index->prev = (mwSignedIndex *)mxMalloc(__MAX__(index->offsets[nframes], 1)*sizeof(mwSignedIndex));
+  index->next = (mwSignedIndex *)mxMalloc(__MAX__(index->offsets[nframes], 1)*sizeof(mwSignedIndex));
+  index->signals = (double *)mxCalloc(__MAX__(index->offsets[nframes], 1), sizeof(double));
+
+  for (i = 0; i < index->offsets[nframes]; i++) {
+    index->prev[i] = -1;
+    index->next[i] = -1;
+  }
+
+  // Copy the signals, located in the third to last column
+  for (i = 0; i < nframes; i++) {
+    cell_element_ptr = mxGetCell(spots, i);
+    if (cell_element_ptr == NULL) {
+      continue;
+    }
+
+    m  = mxGetM(cell_element_ptr);
+    n  = mxGetN(cell_element_ptr);
+    if (m > 0 && n >= 3) {
+      spot  = mxGetPr(cell_element_ptr);
+      memcpy(index->signals + index->offsets[i], spot + (n-3)*m, m*sizeof(double));
+    }
+  }
+
+  // Now store the links in both directions, in the same order as they would be
+  // found by parsing them
+  nlinks = __MIN__(mxGetNumberOfElements(links), nframes);
+  for (j = 0; j < nlinks; j++) {
+    cell_element_ptr = mxGetCell(links, j);
+    if (cell_element_ptr == NULL) {
+      continue;
+    }
+
+    m  = mxGetM(cell_element_ptr);
+    n  = mxGetN(cell_element_ptr);
+    if (n < 3) {
+      continue;
+    }
+
+    curr_indx  = mxGetPr(cell_element_ptr);
+    prev_indx = curr_indx + m;
+    frame_indx = prev_indx + m;
+
+    for (k = 0; k < m; k++) {
+      curr = get_global_index(index, j, curr_indx[k] - 1);
+      prev = get_global_index(index, frame_indx[k] - 1, prev_indx[k] - 1);
+
+      if (curr >= 0 && index->prev[curr] == -1) {
+        index->prev[curr] = prev;
+      }
+      if (prev >= 0 && frame_indx[k] - 1 < j && index->next[prev] == -1) {
+        index->next[prev] = curr;
+      }
+    }
+  }
+
+  return;
+}
+
+// Frees the memory allocated by build_links_index
+void free_links_index(links_index *index) {
+
+  mxFree(index->offsets);
+  mxFree(index->prev);
+  mxFree(index->next);
+  mxFree(index->signals);
+
+  return;
+}
+
+// Same as get_signal, using the index
+double get_indexed_signal(const links_index *index, int frame, int spot_indx) {
+
+  mwSignedIndex curr;
+
+  curr = get_global_index(index, frame, spot_indx);
+
+  return (curr < 0) ? 0 : index->signals[curr];
+}
+
+// Same as get_next_signal, using the index
+double get_indexed_next_signal(const links_index *index, int frame, int spot_indx) {
+
+  mwSignedIndex curr;
+
+  curr = get_global_index(index, frame, spot_indx);
+  if (curr < 0 || index->next[curr] < 0) {
+    return 0;
+  }
+
+  return index->signals[index->next[curr]];
+}
+
+// Same as get_prev_signal, using the index
+double get_indexed_prev_signal(const links_index *index, int frame, int spot_indx) {
+
+  mwSignedIndex curr;
+
+  curr = get_global_index(index, frame, spot_indx);
+  if (curr < 0 || index->prev[curr] < 0) {
+    return 0;
+  }
+
+  return index->signals[index->prev[curr]];
+}
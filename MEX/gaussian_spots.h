@@ -29,10 +29,25 @@
 extern "C" {
 #endif
 
+// An index of the links between spots, stored using a global numbering of the spots
+// (offsets[frame] + spot), providing the predecessor and the successor of each spot
+typedef struct {
+  mwSize nframes;
+  mwIndex *offsets;
+  mwSignedIndex *prev, *next;
+  double *signals;
+} links_index;
+
 double fast_exp(double y);
 double get_signal(int frame_indx, int spot_indx, const mxArray *spots);
 double get_next_signal(int frame, int spot_indx, const mxArray *spots, const mxArray *links);
 double get_prev_signal(int frame, int spot_indx, const mxArray *spots, const mxArray *links);
+mxArray *create_sparse_from_counts(mwSize m, mwSize n, mwIndex *counts);
+void build_links_index(links_index *index, const mxArray *spots, const mxArray *links);
+void free_links_index(links_index *index);
+double get_indexed_signal(const links_index *index, int frame, int spot_indx);
+double get_indexed_next_signal(const links_index *index, int frame, int spot_indx);
+double get_indexed_prev_signal(const links_index *index, int frame, int spot_indx);
 
 #ifdef __cplusplus
 }
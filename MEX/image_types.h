@@ -0,0 +1,57 @@
+#ifndef IMAGE_TYPES_H
+#define IMAGE_TYPES_H
+
+#include "mex.h"
+
+// The classes of images accepted by the MEX functions, as returned by load_data.m
+inline bool is_supported_image(const mxArray *img) {
+
+  switch (mxGetClassID(img)) {
+    case mxUINT8_CLASS:
+    case mxUINT16_CLASS:
+    case mxSINGLE_CLASS:
+    case mxDOUBLE_CLASS:
+      return (!mxIsComplex(img) && !mxIsSparse(img));
+    default:
+      return false;
+  }
+}
+
+// Converts nelem values of type U into the buffer dst of type T
+template<typename T, typename U>
+void convert_values(const U *src, T *dst, mwSize nelem) {
+  mwSize i;
+
+  for (i = 0; i < nelem; i++) {
+    dst[i] = (T)src[i];
+  }
+
+  return;
+}
+
+// Copies an image of any of the supported classes into the buffer dst of type T
+template<typename T>
+void copy_image(const mxArray *img, T *dst) {
+  mwSize nelem = mxGetNumberOfElements(img);
+
+  switch (mxGetClassID(img)) {
+    case mxUINT8_CLASS:
+      convert_values((const unsigned char *)mxGetData(img), dst, nelem);
+      break;
+    case mxUINT16_CLASS:
+      convert_values((const unsigned short *)mxGetData(img), dst, nelem);
+      break;
+    case mxSINGLE_CLASS:
+      convert_values((const float *)mxGetData(img), dst, nelem);
+      break;
+    case mxDOUBLE_CLASS:
+      convert_values((const double *)mxGetData(img), dst, nelem);
+      break;
+    default:
+      mexErrMsgTxt("Only uint8, uint16, single and double images are supported !");
+  }
+
+  return;
+}
+
+#endif
@@ -0,0 +1,221 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include "image_types.h"
+#include "mex.h"
+
+// The B3-spline kernel of the "a trous" wavelet transform, normalized once both
+// dimensions have been filtered
+static const double atrous_kernel[5] = {1, 4, 6, 4, 1};
+static const double atrous_norm = 0.0625*0.0625;
+
+// Filters the image "in" of size h x w with the kernel of level "step" (i.e. holes of
+// step-1 zeros between its taps), replicating the borders as imfilter does. The
+// columns are filtered first into tmp, then the rows into out.
+static void atrous_filter(const double *in, double *tmp, double *out, mwSize h, mwSize w,
+                          mwSignedIndex step) {
+
+  mwSignedIndex x;
+
+  // The columns, which are contiguous in memory
+  #pragma omp parallel for schedule(static)
+  for (x = 0; x < (mwSignedIndex)w; x++) {
+    mwSignedIndex y, k, indx;
+    const double *col = in + x*h;
+    double *res = tmp + x*h, sum;
+
+    for (y = 0; y < (mwSignedIndex)h; y++) {
+      sum = 0;
+      for (k = -2; k <= 2; k++) {
+        indx = y + k*step;
+        indx = (indx < 0) ? 0 : ((indx >= (mwSignedIndex)h) ? h-1 : indx);
+        sum += atrous_kernel[k+2] * col[indx];
+      }
+      res[y] = sum;
+    }
+  }
+
+  // The rows, accumulating whole columns at once
+  #pragma omp parallel for schedule(static)
+  for (x = 0; x < (mwSignedIndex)w; x++) {
+    mwSignedIndex y, k, indx;
+    const double *col;
+    double *res = out + x*h;
+
+    for (y = 0; y < (mwSignedIndex)h; y++) {
+      res[y] = 0;
+    }
+    for (k = -2; k <= 2; k++) {
+      indx = x + k*step;
+      indx = (indx < 0) ? 0 : ((indx >= (mwSignedIndex)w) ? w-1 : indx);
+      col = tmp + indx*h;
+      for (y = 0; y < (mwSignedIndex)h; y++) {
+        res[y] += atrous_kernel[k+2] * col[y];
+      }
+    }
+    for (y = 0; y < (mwSignedIndex)h; y++) {
+      res[y] *= atrous_norm;
+    }
+  }
+
+  return;
+}
+
+// The median of the n first values of vals, which are reordered, as computed by
+// MATLAB (i.e. the average of the two central values for an even n). It uses a
+// linear-time selection instead of sorting the values.
+static double select_median(double *vals, mwSize n) {
+
+  double upper;
+
+  if (n == 0) {
+    return mxGetNaN();
+  }
+
+  std::nth_element(vals, vals + n/2, vals + n);
+  upper = vals[n/2];
+
+  // The lower central value is the largest of the lower half
+  if (n % 2 == 0) {
+    return 0.5 * (*std::max_element(vals, vals + n/2) + upper);
+  }
+
+  return upper;
+}
+
+// The median absolute deviation of the detail plane cur - next, as mad(detail, 1),
+// ignoring NaNs. vals is a buffer for the nelem values.
+static double detail_mad(const double *cur, const double *next, double *vals, mwSize nelem) {
+
+  mwSize i, n = 0;
+  double med, detail;
+
+  for (i = 0; i < nelem; i++) {
+    detail = cur[i] - next[i];
+    if (!mxIsNaN(detail)) {
+      vals[n++] = detail;
+    }
+  }
+  med = select_median(vals, n);
+
+  n = 0;
+  for (i = 0; i < nelem; i++) {
+    detail = cur[i] - next[i];
+    if (!mxIsNaN(detail)) {
+      vals[n++] = fabs(detail - med);
+    }
+  }
+
+  return select_median(vals, n);
+}
+
+// The "a trous" wavelet multi-scale product of imatrou.m, see there for details.
+// Only the current approximation, the next one, a buffer and the running sum (or
+// product) of the detail planes are kept in memory.
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+  mwSize h, w, nelem;
+  mwSignedIndex i, nplanes, step, p;
+  double coef, *cur, *next, *tmp, *swap, *result;
+
+  // Check for proper number of input and output arguments
+  if (nrhs != 3) {
+    mexErrMsgIdAndTxt("CAST:imatrou_mex:invalidNumInputs",
+        "Three input arguments required.");
+  }
+  if (!is_supported_image(prhs[0]) || mxGetNumberOfDimensions(prhs[0]) > 2) {
+    mexErrMsgIdAndTxt("CAST:imatrou_mex:invalidInput",
+        "Input argument (1) must be a 2D image of type uint8, uint16, single or double.");
+  }
+
+  h = mxGetM(prhs[0]);
+  w = mxGetN(prhs[0]);
+  nelem = h*w;
+  nplanes = (mwSignedIndex)mxGetScalar(prhs[1]);
+  coef = mxGetScalar(prhs[2]);
+
+  // The multi-scale product, which also serves as running sum
+  plhs[0] = mxCreateDoubleMatrix(h, w, mxREAL);
+  result = mxGetPr(plhs[0]);
+
+  // The working planes
+  cur = (double *)mxMalloc(nelem*sizeof(double));
+  next = (double *)mxMalloc(nelem*sizeof(double));
+  tmp = (double *)mxMalloc(nelem*sizeof(double));
+  copy_image(prhs[0], cur);
+
+  // The denoising decomposition, summing the thresholded detail planes
+  if (coef > 0) {
+    for (p = 0; p < (mwSignedIndex)nelem; p++) {
+      result[p] = 0;
+    }
+
+    for (i = 1, step = 1; i <= nplanes; i++, step *= 2) {
+      bool has_signal = false;
+      double thresh;
+
+      atrous_filter(cur, tmp, next, h, w, step);
+
+      // Noise as defined in [1] using the MAD estimate of the detail plane
+      thresh = coef * 1.4826 * detail_mad(cur, next, tmp, nelem);
+
+      #pragma omp parallel for schedule(static) reduction(||:has_signal)
+      for (p = 0; p < (mwSignedIndex)nelem; p++) {
+        if (!(fabs(cur[p] - next[p]) < thresh)) {
+          has_signal = true;
+        }
+      }
+
+      // A plane without any information is kept as ones
+      if (has_signal) {
+        #pragma omp parallel for schedule(static)
+        for (p = 0; p < (mwSignedIndex)nelem; p++) {
+          double detail = cur[p] - next[p];
+          if (!(fabs(detail) < thresh)) {
+            result[p] += detail;
+          }
+        }
+      } else {
+        #pragma omp parallel for schedule(static)
+        for (p = 0; p < (mwSignedIndex)nelem; p++) {
+          result[p] += 1;
+        }
+      }
+
+      swap = cur;
+      cur = next;
+      next = swap;
+    }
+
+    // The denoised image is decomposed again
+    memcpy(cur, result, nelem*sizeof(double));
+  }
+
+  // The decomposition of the image, as the product of its detail planes
+  for (p = 0; p < (mwSignedIndex)nelem; p++) {
+    result[p] = 1;
+  }
+  for (i = 1, step = 1; i <= nplanes; i++, step *= 2) {
+    atrous_filter(cur, tmp, next, h, w, step);
+
+    #pragma omp parallel for schedule(static)
+    for (p = 0; p < (mwSignedIndex)nelem; p++) {
+      result[p] *= cur[p] - next[p];
+    }
+
+    swap = cur;
+    cur = next;
+    next = swap;
+  }
+
+  #pragma omp parallel for schedule(static)
+  for (p = 0; p < (mwSignedIndex)nelem; p++) {
+    result[p] = fabs(result[p]);
+  }
+
+  mxFree(cur);
+  mxFree(next);
+  mxFree(tmp);
+
+  return;
+}
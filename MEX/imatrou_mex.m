@@ -0,0 +1,10 @@
+% IMATROU_MEX computes in C the multi-scale product of the "a trous" wavelet
+% decomposition of an image, as described in imatrou.m. Only the two consecutive
+% approximations and the running product of the detail planes are kept in memory,
+% the MAD of each detail plane being computed using a linear-time selection. The
+% filtering is performed in parallel if compiled with OpenMP.
+%
+%   SPOTS = IMATROU_MEX(IMG, NPLANES, NOISE_THRESH) decomposes IMG into NPLANES
+%   detail planes and returns their multi-scale product SPOTS, after removing the
+%   noise using NOISE_THRESH (see imatrou.m). IMG can be of class uint8, uint16,
+%   single or double, SPOTS being a double matrix.
@@ -0,0 +1,267 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "image_types.h"
+#include "mex.h"
+
+// The maximal number of iterations, as advised in [1] (see imcosmics.m)
+#define MAX_ITER 5
+
+// The median of the n first values of vals, which are reordered, the average of the
+// two central values being used for an even n
+static double select_median(double *vals, mwSize n) {
+
+  double upper;
+
+  std::nth_element(vals, vals + n/2, vals + n);
+  upper = vals[n/2];
+
+  if (n % 2 == 0) {
+    return 0.5 * (*std::max_element(vals, vals + n/2) + upper);
+  }
+
+  return upper;
+}
+
+// Filters the cosmic rays of one tile, as filter_cosmics in imcosmics.m. The tile spans
+// [x0, x1) x [y0, y1), its statistics being measured over an additional border, and
+// the filtered pixels are written in res. vals and devs are buffers for the pixels
+// of the tile and its border.
+static void filter_tile(const double *img, double *res, mwSize h, mwSize w,
+                        mwSize x0, mwSize x1, mwSize y0, mwSize y1, mwSize border,
+                        double thresh, double *vals, double *devs) {
+
+  mwSize x, y, xs, xe, ys, ye, n = 0, i, nupper;
+  double val, dmed, dmad, prev, gap, first, sum;
+  bool found = false;
+
+  // The tile and its border, within the image
+  xs = (x0 > border) ? x0 - border : 0;
+  ys = (y0 > border) ? y0 - border : 0;
+  xe = std::min(x1 + border, w);
+  ye = std::min(y1 + border, h);
+
+  // Zeros are considered as padding and ignored, as are NaNs
+  for (x = xs; x < xe; x++) {
+    for (y = ys; y < ye; y++) {
+      val = img[x*h + y];
+      if (val != 0 && !isnan(val)) {
+        vals[n++] = val;
+      }
+    }
+  }
+
+  // Nothing to estimate
+  if (n == 0) {
+    return;
+  }
+
+  // The robust estimates of the mean and standard deviation of the tile
+  dmed = select_median(vals, n);
+  for (i = 0; i < n; i++) {
+    devs[i] = fabs(vals[i] - dmed);
+  }
+  dmad = 1.4826 * select_median(devs, n);
+
+  // Alternative estimates for the standard deviation
+  if (dmad == 0) {
+    sum = 0;
+    for (i = 0; i < n; i++) {
+      sum += devs[i];
+    }
+    dmad = 1.4826 * sum / n;
+
+    if (dmad == 0) {
+      sum = 0;
+      for (i = 0; i < n; i++) {
+        sum += vals[i]*vals[i] - dmed*dmed;
+      }
+      dmad = (sum > 0) ? sqrt(sum / n) : 0;
+    }
+  }
+
+  // Only the values larger than the median need to be sorted, the gap of the first
+  // one being measured from the largest of the others
+  prev = -HUGE_VAL;
+  nupper = 0;
+  for (i = 0; i < n; i++) {
+    if (vals[i] > dmed) {
+      devs[nupper++] = vals[i];
+    } else if (vals[i] > prev) {
+      prev = vals[i];
+    }
+  }
+  std::sort(devs, devs + nupper);
+
+  // The first value separated from the lower ones by a gap larger than the threshold
+  thresh *= dmad;
+  first = 0;
+  for (i = 0; i < nupper; i++) {
+    gap = devs[i] - prev;
+    if (gap > thresh) {
+      first = devs[i];
+      found = true;
+      break;
+    }
+    prev = devs[i];
+  }
+
+  // All the higher values are replaced by the median, as are the ignored pixels
+  if (found) {
+    for (x = x0; x < x1; x++) {
+      for (y = y0; y < y1; y++) {
+        val = img[x*h + y];
+        if (val >= first || val == 0 || isnan(val)) {
+          res[x*h + y] = dmed;
+        }
+      }
+    }
+  }
+
+  return;
+}
+
+// Cosmic rays removal, see imcosmics_mex.m
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+  mwSize h, w, nelem, block_size, border, nth, ntw, ntiles, buf_size, iter, i, nactive;
+  mwSize tx, ty, x, y, x0, x1, y0, y1, reach;
+  mwSignedIndex t;
+  double thresh = 3, *img, *res, *swap, a, b;
+  std::vector<unsigned char> changed, active;
+  std::vector<mwSize> tiles;
+
+  // Check for proper number of input and output arguments
+  if (nrhs < 1) {
+    mexErrMsgIdAndTxt("CAST:imcosmics_mex:invalidNumInputs",
+        "At least one input argument required.");
+  }
+  if (!is_supported_image(prhs[0]) || mxGetNumberOfDimensions(prhs[0]) > 2) {
+    mexErrMsgIdAndTxt("CAST:imcosmics_mex:invalidInput",
+        "Input argument (1) must be a 2D image of type uint8, uint16, single or double.");
+  }
+
+  h = mxGetM(prhs[0]);
+  w = mxGetN(prhs[0]);
+  nelem = h*w;
+
+  block_size = 10;
+  if (nrhs > 1) {
+    block_size = (mwSize)mxGetScalar(prhs[1]);
+  }
+  if (nrhs > 2) {
+    thresh = mxGetScalar(prhs[2]);
+  }
+  if (block_size < 1) {
+    mexErrMsgIdAndTxt("CAST:imcosmics_mex:invalidInput",
+        "The size of the blocks must be strictly positive.");
+  }
+
+  // The overlap between the tiles, as the BorderSize in imcosmics.m
+  border = (block_size + 1) / 2;
+  buf_size = (block_size + 2*border) * (block_size + 2*border);
+
+  // The tiles, and the number of neighboring tiles reached by their border
+  nth = (h + block_size - 1) / block_size;
+  ntw = (w + block_size - 1) / block_size;
+  ntiles = nth*ntw;
+  reach = (border + block_size - 1) / block_size;
+
+  plhs[0] = mxCreateDoubleMatrix(h, w, mxREAL);
+  if (nelem == 0) {
+    return;
+  }
+
+  // The input and output of every iteration
+  img = (double *)mxMalloc(nelem*sizeof(double));
+  res = (double *)mxMalloc(nelem*sizeof(double));
+  copy_image(prhs[0], img);
+
+  changed.resize(ntiles, 1);
+  active.resize(ntiles);
+  tiles.reserve(ntiles);
+
+  for (iter = 0; iter < MAX_ITER; iter++) {
+
+    // Only the tiles which border contains a modified pixel need to be filtered again
+    tiles.clear();
+    for (i = 0; i < ntiles; i++) {
+      tx = i / nth;
+      ty = i % nth;
+      active[i] = 0;
+      for (x = (tx > reach) ? tx - reach : 0; x <= std::min(tx + reach, ntw-1) && !active[i]; x++) {
+        for (y = (ty > reach) ? ty - reach : 0; y <= std::min(ty + reach, nth-1); y++) {
+          if (changed[x*nth + y]) {
+            active[i] = 1;
+            break;
+          }
+        }
+      }
+      if (active[i]) {
+        tiles.push_back(i);
+      }
+    }
+    nactive = tiles.size();
+
+    // Converged
+    if (nactive == 0) {
+      break;
+    }
+
+    memcpy(res, img, nelem*sizeof(double));
+
+    #pragma omp parallel
+    {
+      double *vals = (double *)malloc(2*buf_size*sizeof(double));
+      double *devs = vals + buf_size;
+      mwSize tile;
+
+      #pragma omp for schedule(dynamic)
+      for (t = 0; t < (mwSignedIndex)nactive; t++) {
+        tile = tiles[t];
+        filter_tile(img, res, h, w, (tile / nth) * block_size,
+                    std::min((tile / nth + 1) * block_size, w),
+                    (tile % nth) * block_size, std::min((tile % nth + 1) * block_size, h),
+                    border, thresh, vals, devs);
+      }
+
+      free(vals);
+    }
+
+    // Keep track of the modified tiles, NaNs being considered identical
+    for (i = 0; i < ntiles; i++) {
+      changed[i] = 0;
+    }
+    for (t = 0; t < (mwSignedIndex)nactive; t++) {
+      i = tiles[t];
+      x0 = (i / nth) * block_size;
+      x1 = std::min(x0 + block_size, w);
+      y0 = (i % nth) * block_size;
+      y1 = std::min(y0 + block_size, h);
+      for (x = x0; x < x1 && !changed[i]; x++) {
+        for (y = y0; y < y1; y++) {
+          a = img[x*h + y];
+          b = res[x*h + y];
+          if (a != b && !(mxIsNaN(a) && mxIsNaN(b))) {
+            changed[i] = 1;
+            break;
+          }
+        }
+      }
+    }
+
+    // The filtered image is the input of the next iteration
+    swap = img;
+    img = res;
+    res = swap;
+  }
+
+  // The result is in img after the last swap
+  memcpy(mxGetPr(plhs[0]), img, nelem*sizeof(double));
+  mxFree(img);
+  mxFree(res);
+
+  return;
+}
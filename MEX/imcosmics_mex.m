@@ -0,0 +1,13 @@
+% IMCOSMICS_MEX removes the cosmic rays of an image as imcosmics.m, filtering its
+% tiles in parallel if compiled with OpenMP.
+%
+%   IMG = IMCOSMICS_MEX(RAYS, BLOCK_SIZE, THRESH) removes the cosmic rays in the 2D
+%   image RAYS and returns the cleaned double IMG. RAYS is processed in tiles of size
+%   [BLOCK_SIZE BLOCK_SIZE] with an overlap of ceil(BLOCK_SIZE/2), as BLOCKPROC would,
+%   the pixels separated from lower values by a gap larger than THRESH*MAD being
+%   replaced by the median of their tile. The filtering is repeated up to 5 times,
+%   only the tiles which overlap a pixel modified by the previous iteration being
+%   filtered again.
+%
+%   IMG = IMCOSMICS_MEX(RAYS) utilizes the default values of 10 for BLOCK_SIZE and 3
+%   for THRESH.
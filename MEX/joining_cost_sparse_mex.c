@@ -2,18 +2,66 @@
 
 #include "gaussian_spots.c"
 
+// The data required to compute one column of the cost matrix
+typedef struct {
+  mwSize m1, m2;
+  double *x1, *y1, *t1, *x2, *y2, *t2;
+  double *signal1, *signal2, *signal_prev;
+  double thresh, thresh2, thresh3, eps;
+} joining_data;
+
+// Computes the costs of joining spot i from the second set to the first one.
+// Returns the number of valid costs, which are only stored if irs is not NULL.
+static mwSize joining_column(const joining_data *data, mwIndex i, mwIndex *irs, double *rs) {
+
+  mwIndex j;
+  mwSize count;
+  double dist, dist2, weight;
+
+  count = 0;
+
+  // Now the actual weights
+  for (j = 0; j < data->m1; j++) {
+    dist2 = data->t2[i]-data->t1[j];
+
+    dist = (__SQR__(data->x2[i]-data->x1[j]) + __SQR__(data->y2[i]-data->y1[j])) / __SQR__(dist2);
+
+    // But only if it passes the threshold
+    if (dist < data->thresh && dist2 <= data->thresh2 && dist2 > 0) {
+
+      // The weight
+      weight = __WGT__(data->signal2[i] / (data->signal1[j] + data->signal_prev[i]));
+
+      // Enforce the intensity threshold
+      if (weight <= data->thresh3) {
+
+        // Store it in the matrix
+        if (irs != NULL) {
+          rs[count] = __MAX__(dist*weight, data->eps);
+          irs[count] = j;
+        }
+
+        count++;
+      }
+    }
+  }
+
+  return count;
+}
+
 // The main of the MATLAB interface
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 {
   // Declare variable
-  mwSize m1,n1, m2, n2;
-  mwSize nzmax, nzstep, nzfull;
-  mwIndex *irs,*jcs,i,j, count, *irs2, *jcs2;
+  mwSize n1, n2;
+  mwSignedIndex i, j;
+  mwIndex *irs,*jcs,*counts;
   const mxArray *spots, *links;
-  double *x1,*y1,*t1,*x2,*y2,*t2,*rs,*i1,*i2, *rs2;
-  double dist, dist2, thresh, thresh2, thresh3, signal1, signal2, signal_prev;
-  double weight, alt_weight, alt_move, eps;
+  double *i1,*i2,*rs,*rs2;
+  double dist, dist2, alt_weight, alt_move;
   bool is_test;
+  joining_data data;
+  links_index index;
 
   // Check for proper number of input and output arguments
   if (nrhs == 4) {
@@ -36,52 +84,48 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
   }
 
   // Get the size and pointers to input data
-  m1  = mxGetM(prhs[0]);
+  data.m1  = mxGetM(prhs[0]);
   n1  = mxGetN(prhs[0]);
 
   // Get the different pointers to the various columns of data
-  x1  = mxGetPr(prhs[0]);
-  y1  = x1 + m1;
-  i1  = x1 + (n1-2)*m1;
-  t1  = x1 + (n1-1)*m1;
+  data.x1  = mxGetPr(prhs[0]);
+  data.y1  = data.x1 + data.m1;
+  i1  = data.x1 + (n1-2)*data.m1;
+  data.t1  = data.x1 + (n1-1)*data.m1;
 
   // Same for the other matrix
-  m2  = mxGetM(prhs[1]);
+  data.m2  = mxGetM(prhs[1]);
   n2  = mxGetN(prhs[1]);
 
-  x2  = mxGetPr(prhs[1]);
-  y2  = x2 + m2;
-  i2  = x2 + (n2-2)*m2;
-  t2  = x2 + (n2-1)*m2;
+  data.x2  = mxGetPr(prhs[1]);
+  data.y2  = data.x2 + data.m2;
+  i2  = data.x2 + (n2-2)*data.m2;
+  data.t2  = data.x2 + (n2-1)*data.m2;
 
   // Get the two thresholds
-  thresh = __SQR__(mxGetScalar(prhs[2]));
-  thresh2 = mxGetScalar(prhs[3]);
+  data.thresh = __SQR__(mxGetScalar(prhs[2]));
+  data.thresh2 = mxGetScalar(prhs[3]);
 
   // And our zero value
-  eps = mxGetEps();
-
-  // A guess on the number of elements needed
-  nzmax=(mwSize)ceil((double)m1*(double)m2*0.1);
-  nzstep=(mwSize)__MAX__(ceil((double)nzmax*0.25),1);
-  nzfull=m1*m2;
+  data.eps = mxGetEps();
 
   // Here we only check if they could interact
   if (is_test) {
 
     // Returns a boolean list of interactions
-    plhs[0] = mxCreateDoubleMatrix(1,m2,mxREAL);
+    plhs[0] = mxCreateDoubleMatrix(1,data.m2,mxREAL);
     rs  = mxGetPr(plhs[0]);
 
-    for (i = 0; i < m2; i++) {
-      for (j = 0; j < m1; j++) {
-        dist2 = t2[i]-t1[j];
+    #pragma omp parallel for private(j, dist, dist2) schedule(dynamic, 64)
+    for (i = 0; i < (mwSignedIndex)data.m2; i++) {
+      for (j = 0; j < (mwSignedIndex)data.m1; j++) {
+        dist2 = data.t2[i]-data.t1[j];
 
         // The distance
-        dist = (__SQR__(x2[i]-x1[j]) + __SQR__(y2[i]-y1[j])) / __SQR__(dist2);
+        dist = (__SQR__(data.x2[i]-data.x1[j]) + __SQR__(data.y2[i]-data.y1[j])) / __SQR__(dist2);
 
         // Check if possible
-        if (dist < thresh && dist2 <= thresh2 && dist2 > 0) {
+        if (dist < data.thresh && dist2 <= data.thresh2 && dist2 > 0) {
           rs[i] = true;
           break;
         }
@@ -92,7 +136,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
   } else {
 
     // The last threshold
-    thresh3 = mxGetScalar(prhs[4]);
+    data.thresh3 = mxGetScalar(prhs[4]);
 
     // The average movement, for the alternative costs
     alt_move = mxGetScalar(prhs[5]);
@@ -101,73 +145,59 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     spots = prhs[6];
     links = prhs[7];
 
-    // Prepare the output
-    plhs[0] = mxCreateSparse(m1,m2,nzmax,false);
-    rs  = mxGetPr(plhs[0]);
-    irs = mxGetIr(plhs[0]);
-    jcs = mxGetJc(plhs[0]);
-
     // And the alternative weights
-    plhs[1] = mxCreateDoubleMatrix(m2, 1,mxREAL);
+    plhs[1] = mxCreateDoubleMatrix(data.m2, 1,mxREAL);
     rs2  = mxGetPr(plhs[1]);
 
-    // Need to count the number of elements inserted in the sparse matrix
-    count = 0;
-    for (i = 0; i < m2; i++) {
-
-      // The number of elements up to the current column
-      jcs[i] = count;
-
-      // The current and previous signals
-      signal2 = get_signal(t2[i]-1, i2[i]-1, spots);
-      signal_prev = get_prev_signal(t2[i]-1, i2[i]-1, spots, links);
-
-      // The alternative weight
-      alt_weight = __WGT__(signal2 / signal_prev);
-      rs2[i] = __MAX__(alt_move*alt_weight, eps);
-
-      // Now the actual weights
-      for (j = 0; j < m1; j++) {
-        dist2 = t2[i]-t1[j];
+    data.signal1 = mxCalloc(data.m1, sizeof(double));
+    data.signal2 = mxCalloc(data.m2, sizeof(double));
+    data.signal_prev = mxCalloc(data.m2, sizeof(double));
 
-        dist = (__SQR__(x2[i]-x1[j]) + __SQR__(y2[i]-y1[j])) / __SQR__(dist2);
+    // Index the links once, to retrieve the signals in constant time
+    build_links_index(&index, spots, links);
 
-        // But only if it passes the threshold
-        if (dist < thresh && dist2 <= thresh2 && dist2 > 0) {
-
-          // Get the other signal
-          signal1 = get_signal(t1[j]-1, i1[j]-1, spots);
+    #pragma omp parallel for
+    for (j = 0; j < (mwSignedIndex)data.m1; j++) {
+      data.signal1[j] = get_indexed_signal(&index, data.t1[j]-1, i1[j]-1);
+    }
 
-          // The weight
-          weight = __WGT__(signal2 / (signal1 + signal_prev));
+    #pragma omp parallel for private(alt_weight)
+    for (i = 0; i < (mwSignedIndex)data.m2; i++) {
 
-          // Enforce the intensity threshold
-          if (weight <= thresh3) {
+      // The current and previous signals
+      data.signal2[i] = get_indexed_signal(&index, data.t2[i]-1, i2[i]-1);
+      data.signal_prev[i] = get_indexed_prev_signal(&index, data.t2[i]-1, i2[i]-1);
 
-            // Here we might need to increase the number of elements in the matrix
-            if (count >= nzmax){
-              nzmax += nzstep;
-              nzmax = __MIN__(nzmax, nzfull);
+      // The alternative weight
+      alt_weight = __WGT__(data.signal2[i] / data.signal_prev[i]);
+      rs2[i] = __MAX__(alt_move*alt_weight, data.eps);
+    }
 
-              mxSetNzmax(plhs[0], nzmax);
-              mxSetPr(plhs[0], mxRealloc(rs, nzmax*sizeof(double)));
-              mxSetIr(plhs[0], mxRealloc(irs, nzmax*sizeof(mwIndex)));
+    // First count the number of elements in each column, to allocate exactly the
+    // required memory, then fill them. Columns are independent so both passes can
+    // be run in parallel.
+    counts = mxCalloc(data.m2+1, sizeof(mwIndex));
 
-              rs  = mxGetPr(plhs[0]);
-              irs = mxGetIr(plhs[0]);
-            }
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (i = 0; i < (mwSignedIndex)data.m2; i++) {
+      counts[i+1] = joining_column(&data, i, NULL, NULL);
+    }
 
-            // Store it in the matrix
-            rs[count] = __MAX__(dist*weight, eps);
-            irs[count] = j;
+    // Prepare the output
+    plhs[0] = create_sparse_from_counts(data.m1, data.m2, counts);
+    rs  = mxGetPr(plhs[0]);
+    irs = mxGetIr(plhs[0]);
+    jcs = mxGetJc(plhs[0]);
 
-            count++;
-          }
-        }
-      }
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (i = 0; i < (mwSignedIndex)data.m2; i++) {
+      joining_column(&data, i, irs + jcs[i], rs + jcs[i]);
     }
 
-    // Requried to finalize the sparse matrix
-    jcs[m2] = count;
+    mxFree(counts);
+    mxFree(data.signal1);
+    mxFree(data.signal2);
+    mxFree(data.signal_prev);
+    free_links_index(&index);
   }
 }
@@ -0,0 +1,252 @@
+#include <math.h>
+#include <vector>
+#include <queue>
+#include <functional>
+#include "lap_alternative.h"
+
+/*
+ * A linear assignment solver for the tracking problems of [1], in which each row can
+ * either be assigned to one column of the sparse cost matrix or left unassigned for
+ * an alternative cost, and so does each column. Instead of building the doubled
+ * matrix of [1] (with its alternative diagonals and its lower right block, required
+ * for symmetry), the alternatives are handled implicitly.
+ *
+ * To this end, each link (i,j) is replaced by its gain over the two alternatives,
+ *   w_ij = c_ij - row_cost_i - col_cost_j,
+ * such that only the links with a negative w_ij are worth considering. Each row then
+ * gets its own dummy column of null cost, and the problem is solved using shortest
+ * augmenting paths (Dijkstra on the reduced costs, as in Jonker & Volgenant [2]).
+ * Dummy columns are only reachable from their own row, so they can only end a path
+ * and their dual variable remains 0, which means that they need not be stored.
+ *
+ * As each augmentation only explores the cluster of rows and columns connected to
+ * the free row, the overall cost remains close to linear for tracking problems.
+ * The solver does not rely on the MATLAB API, which is not thread-safe, such that
+ * link_frames_mex can solve several frames in parallel.
+ *
+ * [1] Jaqaman K, et al. Robust single-particle tracking in live-cell time-lapse
+ *     sequences. Nat Methods 5: 695-702 (2008).
+ * [2] R. Jonker and A. Volgenant, "A shortest augmenting path algorithm for
+ *     dense and spare linear assignment problems", Computing, Vol. 38, pp.
+ *     325-340, 1987.
+ */
+
+// An element of the heap used in Dijkstra, as (distance, column), where columns
+// larger than ncols denote the dummy column of row (column - ncols)
+typedef std::pair<double, mwIndex> heap_elem;
+
+// Solves the assignment problem of the nrows x ncols sparse matrix (jcs, irs, pr),
+// with the alternative costs of each row and column. Stores in assign the column
+// assigned to each row, or -1 if the alternative is used, and returns the total cost.
+double solve_lap_alternative(mwSize nrows, mwSize ncols, const mwIndex *jcs, const mwIndex *irs,
+                             const double *pr, const double *row_costs, const double *col_costs,
+                             mwSignedIndex *assign) {
+
+  mwSize nlinks;
+  mwIndex i, j, k, r, node, dummy, endofpath, prev;
+  double maxcost, w, u, dist, minh, cost;
+  bool unassignedfound;
+
+  // Infinite alternatives are replaced by a cost larger than any possible assignment
+  maxcost = 0;
+  for (k = 0; k < jcs[ncols]; k++) {
+    if (isfinite(pr[k])) {
+      maxcost = __MAX__(maxcost, fabs(pr[k]));
+    }
+  }
+  for (i = 0; i < nrows; i++) {
+    if (isfinite(row_costs[i])) {
+      maxcost = __MAX__(maxcost, fabs(row_costs[i]));
+    }
+  }
+  for (j = 0; j < ncols; j++) {
+    if (isfinite(col_costs[j])) {
+      maxcost = __MAX__(maxcost, fabs(col_costs[j]));
+    }
+  }
+  maxcost = (maxcost + 1) * (nrows + ncols + 1);
+
+  std::vector<double> rcosts(nrows), ccosts(ncols);
+  for (i = 0; i < nrows; i++) {
+    rcosts[i] = isfinite(row_costs[i]) ? row_costs[i] : maxcost;
+  }
+  for (j = 0; j < ncols; j++) {
+    ccosts[j] = isfinite(col_costs[j]) ? col_costs[j] : maxcost;
+  }
+
+  // The links worth considering, stored by rows with their gains
+  std::vector<mwIndex> row_start(nrows+1, 0), row_cols;
+  std::vector<double> row_gains, row_vals;
+
+  nlinks = 0;
+  for (j = 0; j < ncols; j++) {
+    for (k = jcs[j]; k < jcs[j+1]; k++) {
+      if (isfinite(pr[k]) && pr[k] - rcosts[irs[k]] - ccosts[j] < 0) {
+        row_start[irs[k]+1]++;
+        nlinks++;
+      }
+    }
+  }
+  for (i = 0; i < nrows; i++) {
+    row_start[i+1] += row_start[i];
+  }
+  row_cols.resize(nlinks);
+  row_gains.resize(nlinks);
+  row_vals.resize(nlinks);
+  {
+    std::vector<mwIndex> counts(row_start.begin(), row_start.end()-1);
+
+    for (j = 0; j < ncols; j++) {
+      for (k = jcs[j]; k < jcs[j+1]; k++) {
+        w = pr[k] - rcosts[irs[k]] - ccosts[j];
+        if (isfinite(pr[k]) && w < 0) {
+          r = irs[k];
+          row_cols[counts[r]] = j;
+          row_gains[counts[r]] = w;
+          row_vals[counts[r]] = pr[k];
+          counts[r]++;
+        }
+      }
+    }
+  }
+
+  // The dual variables of the columns, the assignments (dummy columns being noted
+  // ncols), the assigned links and the link through which each column was reached
+  std::vector<double> v(ncols, 0), d(ncols, HUGE_VAL), assigned_gain(nrows, 0), assigned_val(nrows, 0);
+  std::vector<mwIndex> rowsol(nrows, ncols), colsol(ncols, nrows), pred(ncols), pred_link(ncols);
+  std::vector<bool> scanned(ncols, false);
+  std::vector<mwIndex> touched, ready;
+
+  dummy = ncols;
+
+  // Augment the solution for each row
+  for (r = 0; r < nrows; r++) {
+
+    // Rows without any link simply keep their alternative
+    if (row_start[r] == row_start[r+1]) {
+      continue;
+    }
+
+    // Dijkstra shortest path algorithm, runs until an unassigned column is reached
+    std::priority_queue<heap_elem, std::vector<heap_elem>, std::greater<heap_elem> > heap;
+
+    heap.push(heap_elem(0, dummy + r));
+    for (k = row_start[r]; k < row_start[r+1]; k++) {
+      j = row_cols[k];
+      d[j] = row_gains[k] - v[j];
+      pred[j] = r;
+      pred_link[j] = k;
+      touched.push_back(j);
+      heap.push(heap_elem(d[j], j));
+    }
+
+    unassignedfound = false;
+    endofpath = dummy;
+    minh = 0;
+    while (!unassignedfound) {
+      dist = heap.top().first;
+      node = heap.top().second;
+      heap.pop();
+
+      // The dummy column of a row ends the path right away
+      if (node >= dummy) {
+        endofpath = node;
+        minh = dist;
+        unassignedfound = true;
+        break;
+      }
+
+      // Outdated element
+      if (scanned[node] || dist > d[node]) {
+        continue;
+      }
+
+      // A free column
+      if (colsol[node] == nrows) {
+        endofpath = node;
+        minh = dist;
+        unassignedfound = true;
+        break;
+      }
+
+      scanned[node] = true;
+      ready.push_back(node);
+
+      // Continue the path through the row assigned to this column
+      i = colsol[node];
+      u = assigned_gain[i] - v[node];
+
+      heap.push(heap_elem(dist - u, dummy + i));
+      for (k = row_start[i]; k < row_start[i+1]; k++) {
+        j = row_cols[k];
+        if (scanned[j]) {
+          continue;
+        }
+
+        w = dist + (row_gains[k] - v[j]) - u;
+        if (w < d[j]) {
+          if (d[j] == HUGE_VAL) {
+            touched.push_back(j);
+          }
+          d[j] = w;
+          pred[j] = i;
+          pred_link[j] = k;
+          heap.push(heap_elem(w, j));
+        }
+      }
+    }
+
+    // Update the dual variables of the scanned columns
+    for (k = 0; k < ready.size(); k++) {
+      j = ready[k];
+      v[j] = v[j] + d[j] - minh;
+    }
+
+    // Reset the row and column assignments along the alternating path
+    if (endofpath >= dummy) {
+      i = endofpath - dummy;
+      j = rowsol[i];
+      rowsol[i] = dummy;
+      assigned_gain[i] = 0;
+    } else {
+      i = nrows;
+      j = endofpath;
+    }
+    while (i != r) {
+      i = pred[j];
+      colsol[j] = i;
+      prev = rowsol[i];
+      rowsol[i] = j;
+      assigned_gain[i] = row_gains[pred_link[j]];
+      assigned_val[i] = row_vals[pred_link[j]];
+      j = prev;
+    }
+
+    // Clean up the visited columns
+    for (k = 0; k < touched.size(); k++) {
+      d[touched[k]] = HUGE_VAL;
+      scanned[touched[k]] = false;
+    }
+    touched.clear();
+    ready.clear();
+  }
+
+  // The assignment and the total cost
+  cost = 0;
+  for (i = 0; i < nrows; i++) {
+    if (rowsol[i] < ncols) {
+      assign[i] = rowsol[i];
+      cost += assigned_val[i];
+    } else {
+      assign[i] = -1;
+      cost += row_costs[i];
+    }
+  }
+  for (j = 0; j < ncols; j++) {
+    if (colsol[j] == nrows) {
+      cost += col_costs[j];
+    }
+  }
+
+  return cost;
+}
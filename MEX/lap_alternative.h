@@ -0,0 +1,15 @@
+#ifndef LAP_ALTERNATIVE_H
+#define LAP_ALTERNATIVE_H
+
+#include "mex.h"
+
+// Define few operations useful to compute the costs
+#ifndef __MAX__
+#define __MAX__(A, B)     ((A)>=(B)? (A) : (B))
+#endif
+
+double solve_lap_alternative(mwSize nrows, mwSize ncols, const mwIndex *jcs, const mwIndex *irs,
+                             const double *pr, const double *row_costs, const double *col_costs,
+                             mwSignedIndex *assign);
+
+#endif
@@ -0,0 +1,58 @@
+#include <vector>
+#include "lap_alternative.h"
+
+#include "lap_alternative.cpp"
+
+// The main of the MATLAB interface
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+  mwSize nrows, ncols;
+  mwIndex *irs, *jcs, i;
+  double *pr, *row_costs, *col_costs, *assignment, cost;
+
+  // Check for proper number of input and output arguments
+  if (nrhs != 3) {
+    mexErrMsgIdAndTxt("CAST:lap_alternative_sparse_mex:invalidNumInputs",
+        "Three input arguments required.");
+  }
+
+  // Check data type of input argument
+  if (!(mxIsSparse(prhs[0]) && mxIsDouble(prhs[0]))) {
+    mexErrMsgIdAndTxt("CAST:lap_alternative_sparse_mex:inputNotSparse",
+        "Input argument (1) must be of type double sparse.");
+  }
+  if (!(mxIsDouble(prhs[1]) && mxIsDouble(prhs[2]) && !mxIsSparse(prhs[1]) && !mxIsSparse(prhs[2]))) {
+    mexErrMsgIdAndTxt("CAST:lap_alternative_sparse_mex:inputNotDouble",
+        "Input arguments (2, 3) must be of type double.");
+  }
+
+  nrows = mxGetM(prhs[0]);
+  ncols = mxGetN(prhs[0]);
+  pr = mxGetPr(prhs[0]);
+  irs = mxGetIr(prhs[0]);
+  jcs = mxGetJc(prhs[0]);
+
+  if (mxGetNumberOfElements(prhs[1]) != nrows || mxGetNumberOfElements(prhs[2]) != ncols) {
+    mexErrMsgIdAndTxt("CAST:lap_alternative_sparse_mex:invalidSize",
+        "There must be one alternative cost per row and per column.");
+  }
+  row_costs = mxGetPr(prhs[1]);
+  col_costs = mxGetPr(prhs[2]);
+
+  // Solve the problem
+  std::vector<mwSignedIndex> assign(__MAX__(nrows, 1));
+  cost = solve_lap_alternative(nrows, ncols, jcs, irs, pr, row_costs, col_costs, &assign[0]);
+
+  // The assignment, 0 meaning that the alternative was chosen, and the total cost
+  plhs[0] = mxCreateDoubleMatrix(1, nrows, mxREAL);
+  assignment = mxGetPr(plhs[0]);
+  for (i = 0; i < nrows; i++) {
+    assignment[i] = assign[i] + 1;
+  }
+
+  if (nlhs > 1) {
+    plhs[1] = mxCreateDoubleScalar(cost);
+  }
+
+  return;
+}
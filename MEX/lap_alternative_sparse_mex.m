@@ -0,0 +1,21 @@
+% LAP_ALTERNATIVE_SPARSE_MEX solves linear assignment problems with alternative costs.
+%
+%   [ASSIGNMENT, COST] = LAP_ALTERNATIVE_SPARSE_MEX(COSTMAT, ROW_COSTS, COL_COSTS)
+%   returns the optimal ASSIGNMENT of the rows of the sparse COSTMAT to its columns,
+%   where each row (resp. column) can also be left unassigned for the corresponding
+%   alternative cost in ROW_COSTS (resp. COL_COSTS). Missing values in COSTMAT are
+%   considered as impossible assignments. ASSIGNMENT contains the column index
+%   assigned to each row, or 0 if the row is left unassigned. COST is the total
+%   cost of the assignments and of the alternatives.
+%
+%   This solves the same problem as the doubled cost matrices of [1], without the
+%   need to build the alternative diagonals nor the lower right block required for
+%   symmetry, using shortest augmenting paths [2].
+%
+% References:
+%   [1] Jaqaman K, Loerke D, Mettlen M, Kuwata H, Grinstein S, et al. Robust
+%       single-particle tracking in live-cell time-lapse sequences. Nat Methods 5:
+%       695-702 (2008).
+%   [2] R. Jonker and A. Volgenant, "A shortest augmenting path algorithm for
+%       dense and spare linear assignment problems", Computing, Vol. 38, pp.
+%       325-340, 1987.
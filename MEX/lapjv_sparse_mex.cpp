@@ -0,0 +1,856 @@
+#include <math.h>
+#include <float.h>
+#include <vector>
+#include <algorithm>
+#include "mex.h"
+
+// Define few opeartions useful to compute the costs
+#ifndef __MAX__
+#define __MAX__(A, B)     ((A)>=(B)? (A) : (B))
+#endif
+#ifndef __SQR__
+#define __SQR__(A)        ((A) * (A))
+#endif
+
+/*
+ * A C++ implementation of the sparse Jonker-Volgenant algorithm as implemented in
+ * libraries/lapjv_fast_sparse.m (Yi Cao 2010, Eric Trautmann 2011, Simon Blanchoud
+ * 2014). The MATLAB version extracts rows out of the column-major sparse matrix in
+ * its innermost loops, which costs O(nnz) per access. Here we keep both a CSC and a
+ * CSR view of the cost matrix, while reproducing the exact same sequence of
+ * operations (including the tie-breaking rules) to provide the same assignment.
+ *
+ * As in the MATLAB version, missing values of the sparse matrix are considered
+ * as infinite costs. The cost matrices used for tracking are however extremely sparse,
+ * so they are first split into the connected components of the bipartite graph of
+ * possible assignments (using union-find), which are solved independently, and in
+ * parallel if OpenMP is available. The solver therefore does not rely on the MATLAB
+ * API, which is not thread-safe.
+ */
+
+// The cost matrix, in both column and row compressed forms
+typedef struct {
+  mwSize dim;
+  std::vector<mwIndex> col_start, col_rows;
+  std::vector<mwIndex> row_start, row_cols;
+  std::vector<double> col_vals, row_vals;
+} sparse_costs;
+
+// Equivalent to MATLAB's eps(x), the distance from x to the next larger double
+static double matlab_eps(double x) {
+  int expo;
+
+  x = fabs(x);
+  if (!isfinite(x)) {
+    return NAN;
+  } else if (x < DBL_MIN) {
+    return DBL_MIN * DBL_EPSILON;
+  }
+
+  frexp(x, &expo);
+  return ldexp(1.0, expo - 53);
+}
+
+// Returns the cost of (i,j), or missing if it is not part of the sparse matrix
+static double get_cost(const sparse_costs &costs, mwIndex i, mwIndex j, double missing) {
+
+  std::vector<mwIndex>::const_iterator first, last, found;
+
+  first = costs.row_cols.begin() + costs.row_start[i];
+  last = costs.row_cols.begin() + costs.row_start[i+1];
+  found = std::lower_bound(first, last, j);
+
+  if (found != last && *found == j) {
+    return costs.row_vals[found - costs.row_cols.begin()];
+  }
+
+  return missing;
+}
+
+// Computes [val, indx] = min(dMat(i,:) - v) with missing values set to Inf, and
+// x(excl) = maxcost if excl is a valid index. As with MATLAB's min, NaN are ignored
+// and the first occurence of the minimum is returned.
+static void row_min(const sparse_costs &costs, const std::vector<double> &v, mwIndex i,
+                    mwSignedIndex excl, double maxcost, double &val, mwIndex &indx) {
+
+  mwIndex j, k;
+  double x;
+  bool found, excl_done;
+
+  found = false;
+  excl_done = (excl < 0);
+  val = NAN;
+  indx = 0;
+
+  // Only the stored values (and the excluded one) can be finite, so we parse them
+  // in the order of the columns
+  for (k = costs.row_start[i]; k <= costs.row_start[i+1]; k++) {
+    j = (k < costs.row_start[i+1]) ? costs.row_cols[k] : costs.dim;
+
+    if (!excl_done && (mwIndex)excl <= j) {
+      x = maxcost;
+      if (!isnan(x) && (!found || x < val)) {
+        val = x;
+        indx = excl;
+        found = true;
+      }
+      excl_done = true;
+
+      if ((mwIndex)excl == j) {
+        continue;
+      }
+    }
+
+    if (j < costs.dim) {
+      x = costs.row_vals[k] - v[j];
+      if (!isnan(x) && (!found || x < val)) {
+        val = x;
+        indx = j;
+        found = true;
+      }
+    }
+  }
+
+  // The minimum might then be one of the missing values, so look for the first one
+  if (!found || val == HUGE_VAL) {
+    for (j = 0; j < costs.dim; j++) {
+      if ((mwSignedIndex)j == excl) {
+        x = maxcost;
+      } else {
+        x = get_cost(costs, i, j, HUGE_VAL) - v[j];
+      }
+
+      if (!isnan(x)) {
+        val = x;
+        indx = j;
+        break;
+      }
+    }
+  }
+
+  return;
+}
+
+// Solves the assignment problem of the nrows x ncols sparse matrix (jcs, irs, pr), in
+// which every row and column contains at least one value. Stores in assign the column
+// assigned to each row, indexes larger than ncols denoting the dummy columns added to
+// get a square problem, and the total cost in cost. A NaN resolution is replaced by the
+// default one. Returns false if the augmentation failed.
+static bool solve_lap(mwSize nrows, mwSize ncols, const mwIndex *jcs, const mwIndex *irs,
+                      const double *pr, double resolution, mwIndex *assign, double &cost) {
+
+  mwSize rdim, cdim, dim, nnz, nstored, numfree, prvnumfree;
+  mwIndex i, j, k, c, r, imin, j1, j2, freerow, endofpath, low, up, loopcnt;
+  mwSignedIndex i0, last, kk, i2;
+  double M, maxcost, mean_val, std_val, sum_val, umin, usubmin;
+  double pad, val, x, h, minh, total_u, total_v;
+  bool swapf, unassignedfound;
+
+  dim = __MAX__(nrows, ncols);
+  nnz = jcs[ncols];
+
+  // The minimum value of the matrix, including its implicit zeros
+  M = (nnz < nrows*ncols) ? 0 : NAN;
+  for (k = 0; k < nnz; k++) {
+    if (isnan(M) || pr[k] < M) {
+      M = pr[k];
+    }
+  }
+
+  // Work on the transposed matrix if we have more rows than columns
+  rdim = nrows;
+  cdim = ncols;
+  swapf = (rdim > cdim);
+  if (swapf) {
+    rdim = ncols;
+    cdim = nrows;
+  }
+
+  // The additional rows to get a square matrix are filled with 2*M
+  pad = 2*M;
+  if (pad == 0 || isnan(pad)) {
+    nstored = nnz;
+  } else {
+    nstored = nnz + (dim - rdim)*dim;
+  }
+
+  // Build the CSC form of the square matrix
+  sparse_costs costs;
+  costs.dim = dim;
+  costs.col_start.assign(dim+1, 0);
+  costs.col_rows.resize(nstored);
+  costs.col_vals.resize(nstored);
+
+  {
+    std::vector<mwIndex> counts(dim+1, 0);
+
+    for (j = 0; j < ncols; j++) {
+      for (k = jcs[j]; k < jcs[j+1]; k++) {
+        c = swapf ? irs[k] : j;
+        counts[c+1]++;
+      }
+    }
+    if (nstored > nnz) {
+      for (c = 0; c < dim; c++) {
+        counts[c+1] += dim - rdim;
+      }
+    }
+    for (c = 0; c < dim; c++) {
+      counts[c+1] += counts[c];
+    }
+    costs.col_start = counts;
+
+    // When transposing, rows are inserted in increasing order as well
+    for (j = 0; j < ncols; j++) {
+      for (k = jcs[j]; k < jcs[j+1]; k++) {
+        if (swapf) {
+          c = irs[k];
+          r = j;
+        } else {
+          c = j;
+          r = irs[k];
+        }
+        costs.col_rows[counts[c]] = r;
+        costs.col_vals[counts[c]] = pr[k];
+        counts[c]++;
+      }
+    }
+    if (nstored > nnz) {
+      for (c = 0; c < dim; c++) {
+        for (r = rdim; r < dim; r++) {
+          costs.col_rows[counts[c]] = r;
+          costs.col_vals[counts[c]] = pad;
+          counts[c]++;
+        }
+      }
+    }
+  }
+
+  // Get rid of NaNs and Infs
+  maxcost = NAN;
+  for (k = 0; k < nstored; k++) {
+    if (isfinite(costs.col_vals[k]) && (isnan(maxcost) || costs.col_vals[k] > maxcost)) {
+      maxcost = costs.col_vals[k];
+    }
+  }
+
+  // The resolution, based on the largest finite value
+  if (isnan(resolution)) {
+    resolution = matlab_eps(isnan(maxcost) ? 0 : __MAX__(maxcost, 0));
+  }
+
+  if (isnan(maxcost)) {
+    maxcost = HUGE_VAL;
+  } else {
+    maxcost = maxcost*dim + 1;
+  }
+  for (k = 0; k < nstored; k++) {
+    if (!isfinite(costs.col_vals[k])) {
+      costs.col_vals[k] = maxcost;
+    }
+  }
+
+  // The CSR form, as a transposition of the CSC one
+  costs.row_start.assign(dim+1, 0);
+  costs.row_cols.resize(nstored);
+  costs.row_vals.resize(nstored);
+  {
+    std::vector<mwIndex> counts(dim+1, 0);
+
+    for (k = 0; k < nstored; k++) {
+      counts[costs.col_rows[k]+1]++;
+    }
+    for (r = 0; r < dim; r++) {
+      counts[r+1] += counts[r];
+    }
+    costs.row_start = counts;
+
+    for (c = 0; c < dim; c++) {
+      for (k = costs.col_start[c]; k < costs.col_start[c+1]; k++) {
+        r = costs.col_rows[k];
+        costs.row_cols[counts[r]] = c;
+        costs.row_vals[counts[r]] = costs.col_vals[k];
+        counts[r]++;
+      }
+    }
+  }
+
+  // The statistics of the full matrix, to choose the initialization
+  sum_val = 0;
+  for (k = 0; k < nstored; k++) {
+    sum_val += costs.col_vals[k];
+  }
+  mean_val = sum_val / ((double)dim*(double)dim);
+  std_val = 0;
+  for (k = 0; k < nstored; k++) {
+    std_val += __SQR__(costs.col_vals[k] - mean_val);
+  }
+  std_val = sqrt((std_val + ((double)dim*(double)dim - nstored)*__SQR__(mean_val)) / ((double)dim*(double)dim));
+
+  // Dual variables, and the assignments
+  std::vector<double> v(dim, 0), d(dim);
+  std::vector<mwSignedIndex> rowsol(dim, -1), colsol(dim, -1);
+  std::vector<mwIndex> free_rows(dim, 0), matches(dim, 0), pred(dim), collist(dim), pos(dim);
+  std::vector<std::pair<mwIndex, mwIndex> > same_min;
+
+  numfree = 0;
+  if (std_val < mean_val) {
+
+    // Column reduction, in reverse order
+    for (j = dim; j-- > 0;) {
+
+      // min_sparse over the column
+      if (costs.col_start[j] == costs.col_start[j+1]) {
+        v[j] = HUGE_VAL;
+        imin = 0;
+      } else {
+        k = costs.col_start[j];
+        v[j] = costs.col_vals[k];
+        imin = costs.col_rows[k];
+        for (k++; k < costs.col_start[j+1]; k++) {
+          if (costs.col_vals[k] < v[j]) {
+            v[j] = costs.col_vals[k];
+            imin = costs.col_rows[k];
+          }
+        }
+      }
+
+      if (!matches[imin]) {
+        rowsol[imin] = j;
+        colsol[j] = imin;
+      } else if (v[j] < v[rowsol[imin]]) {
+        j1 = rowsol[imin];
+        rowsol[imin] = j;
+        colsol[j] = imin;
+        colsol[j1] = -1;
+      } else {
+        colsol[j] = -1;
+      }
+      matches[imin]++;
+    }
+
+    // Reduction transfer from unassigned to assigned rows
+    for (i = 0; i < dim; i++) {
+      if (!matches[i]) {
+        free_rows[numfree++] = i;
+      } else if (matches[i] == 1) {
+        j1 = rowsol[i];
+        row_min(costs, v, i, j1, maxcost, val, k);
+        v[j1] = v[j1] - val;
+      }
+    }
+  } else {
+    numfree = dim-1;
+
+    // The first minimum among the column minima
+    c = 0;
+    imin = 0;
+    minh = NAN;
+    for (j = 0; j < dim; j++) {
+      if (costs.col_start[j] == costs.col_start[j+1]) {
+        val = HUGE_VAL;
+        r = 0;
+      } else {
+        k = costs.col_start[j];
+        val = costs.col_vals[k];
+        r = costs.col_rows[k];
+        for (k++; k < costs.col_start[j+1]; k++) {
+          if (costs.col_vals[k] < val) {
+            val = costs.col_vals[k];
+            r = costs.col_rows[k];
+          }
+        }
+      }
+      if (!isnan(val) && (isnan(minh) || val < minh)) {
+        minh = val;
+        c = j;
+        imin = r;
+      }
+    }
+
+    j = c;
+    rowsol[imin] = j;
+    colsol[j] = imin;
+
+    k = 0;
+    for (i = 0; i < dim; i++) {
+      if (i != imin) {
+        free_rows[k++] = i;
+      }
+    }
+
+    row_min(costs, v, imin, j, maxcost, val, k);
+    v[j] = v[j] - val;
+  }
+
+  // Augmenting reduction of unassigned rows
+  for (loopcnt = 0; loopcnt < 2; loopcnt++) {
+
+    // Scan all free rows, in some cases a free row may be replaced with another
+    // one to be scanned next
+    k = 0;
+    prvnumfree = numfree;
+    numfree = 0;
+    while (k < prvnumfree) {
+      i = free_rows[k];
+      k++;
+
+      // Find minimum and second minimum reduced cost over columns
+      row_min(costs, v, i, -1, maxcost, umin, j1);
+      row_min(costs, v, i, j1, maxcost, usubmin, j2);
+
+      i0 = colsol[j1];
+      if (usubmin - umin > resolution) {
+
+        // Change the reduction of the minimum column to increase the minimum
+        // reduced cost in the row to the subminimum.
+        v[j1] = v[j1] - (usubmin - umin);
+      } else if (i0 >= 0) {
+
+        // Minimum and subminimum equal, minimum column j1 is assigned, swap
+        // columns j1 and j2, as j2 may be unassigned.
+        j1 = j2;
+        i0 = colsol[j2];
+      }
+
+      // Reassign i to j1, possibly de-assigning an i0.
+      rowsol[i] = j1;
+      colsol[j1] = i;
+      if (i0 >= 0) {
+        if (usubmin - umin > resolution) {
+
+          // Put in current k, and go back to that k.
+          k--;
+          free_rows[k] = i0;
+        } else {
+
+          // No further augmenting reduction possible, store i0 in list of free
+          // rows for next phase.
+          free_rows[numfree++] = i0;
+        }
+      }
+    }
+  }
+
+  // Augmentation Phase, augment solution for each free rows
+  last = -1;
+  minh = 0;
+  endofpath = 0;
+  for (kk = 0; kk < (mwSignedIndex)numfree; kk++) {
+    freerow = free_rows[kk];
+
+    // Dijkstra shortest path algorithm, runs until unassigned column added to
+    // shortest path tree.
+    for (j = 0; j < dim; j++) {
+      d[j] = HUGE_VAL - v[j];
+      pred[j] = freerow;
+      collist[j] = j;
+      pos[j] = j;
+    }
+    for (k = costs.row_start[freerow]; k < costs.row_start[freerow+1]; k++) {
+      j = costs.row_cols[k];
+      d[j] = costs.row_vals[k] - v[j];
+    }
+
+    // Columns in 0...low-1 are ready, in low...up-1 are to be scanned for current
+    // minimum, and in up...dim-1 are to be considered later
+    low = 0;
+    up = 0;
+    unassignedfound = false;
+    while (!unassignedfound) {
+
+      // No more columns to be scanned for current minimum.
+      if (up == low) {
+        last = (mwSignedIndex)low - 1;
+
+        // All columns have been scanned without finding an unassigned one
+        if (up >= dim) {
+          return false;
+        }
+
+        // Scan columns for up...dim-1 to find all indices for which new minimum
+        // occurs, store these indices between low...up-1 (increasing up).
+        minh = d[collist[up]];
+        up++;
+        for (k = up; k < dim; k++) {
+          j = collist[k];
+          h = d[j];
+          if (h <= minh) {
+            if (h < minh) {
+              up = low;
+              minh = h;
+            }
+
+            // New index with same minimum, put on index up, and extend list.
+            collist[k] = collist[up];
+            pos[collist[k]] = k;
+            collist[up] = j;
+            pos[j] = up;
+            up++;
+          }
+        }
+
+        // Check if any of the minimum columns happens to be unassigned, if so,
+        // we have an augmenting path right away.
+        for (k = low; k < up; k++) {
+          if (colsol[collist[k]] < 0) {
+            endofpath = collist[k];
+            unassignedfound = true;
+            break;
+          }
+        }
+      }
+
+      if (!unassignedfound) {
+
+        // Update 'distances' between freerow and all unscanned columns, via next
+        // scanned column. Only the stored values can get closer.
+        j1 = collist[low];
+        low++;
+        i = colsol[j1];
+        h = (get_cost(costs, i, j1, HUGE_VAL) - v[j1]) - minh;
+
+        same_min.clear();
+        for (k = costs.row_start[i]; k < costs.row_start[i+1]; k++) {
+          j = costs.row_cols[k];
+          if (pos[j] < up) {
+            continue;
+          }
+
+          x = (costs.row_vals[k] - v[j]) - h;
+          if (x < d[j]) {
+            pred[j] = i;
+            d[j] = x;
+
+            // New column found at same minimum value
+            if (x == minh) {
+              same_min.push_back(std::make_pair(pos[j], j));
+            }
+          }
+        }
+
+        // Process them in the order of the list of columns
+        std::sort(same_min.begin(), same_min.end());
+
+        i2 = same_min.size();
+        for (k = 0; k < same_min.size(); k++) {
+          if (colsol[same_min[k].second] < 0) {
+
+            // Unassigned, shortest augmenting path is complete.
+            endofpath = same_min[k].second;
+            unassignedfound = true;
+            i2 = k;
+            break;
+          }
+        }
+
+        // Add to list to be scanned right away
+        for (k = 0; k < (mwIndex)i2; k++) {
+          j = same_min[k].second;
+          j2 = pos[j];
+          collist[j2] = collist[up];
+          pos[collist[j2]] = j2;
+          collist[up] = j;
+          pos[j] = up;
+          up++;
+        }
+      }
+    }
+
+    // Update column prices
+    for (k = 0; (mwSignedIndex)k <= last; k++) {
+      j1 = collist[k];
+      v[j1] = v[j1] + d[j1] - minh;
+    }
+
+    // Reset row and column assignments along the alternating path
+    while (true) {
+      i = pred[endofpath];
+      colsol[endofpath] = i;
+      j1 = endofpath;
+      endofpath = rowsol[i];
+      rowsol[i] = j1;
+      if (i == freerow) {
+        break;
+      }
+    }
+  }
+
+  // The total cost of the assignment, missing values counting as zeros
+  total_u = 0;
+  total_v = 0;
+  for (i = 0; i < rdim; i++) {
+    j = rowsol[i];
+    val = get_cost(costs, i, j, 0);
+    total_u += val - v[j];
+  }
+  for (i = 0; i < rdim; i++) {
+    total_v += v[rowsol[i]];
+  }
+  cost = total_u + total_v;
+  if (cost > maxcost) {
+    cost = HUGE_VAL;
+  }
+
+  // Return the assignment of the rows of the original matrix
+  if (swapf) {
+    for (j = 0; j < dim; j++) {
+      assign[j] = colsol[j];
+    }
+  } else {
+    for (i = 0; i < rdim; i++) {
+      assign[i] = rowsol[i];
+    }
+  }
+
+  return true;
+}
+
+// Returns the root of the set containing i, halving the path on the way
+static mwIndex find_root(std::vector<mwIndex> &parent, mwIndex i) {
+
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+
+  return i;
+}
+
+// The main of the MATLAB interface
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+  mwSize m, n, nrows, ncols, dim, nnz, ncomps;
+  mwIndex *irs, *jcs, i, j, k, c, r, dummy;
+  mwSignedIndex p;
+  double *pr, *assignment, resolution, cost;
+  bool swapf, is_valid;
+
+  // Check for proper number of input and output arguments
+  if (nrhs < 1 || nrhs > 2) {
+    mexErrMsgIdAndTxt("CAST:lapjv_sparse_mex:invalidNumInputs",
+        "One or two input arguments required.");
+  }
+
+  // Check data type of input argument
+  if (!(mxIsSparse(prhs[0]) && mxIsDouble(prhs[0]))) {
+    mexErrMsgIdAndTxt("CAST:lapjv_sparse_mex:inputNotSparse",
+        "Input argument must be of type double sparse.");
+  }
+
+  m = mxGetM(prhs[0]);
+  n = mxGetN(prhs[0]);
+  pr = mxGetPr(prhs[0]);
+  irs = mxGetIr(prhs[0]);
+  jcs = mxGetJc(prhs[0]);
+  nnz = jcs[n];
+
+  // The default resolution depends on the values of each problem
+  resolution = (nrhs > 1) ? mxGetScalar(prhs[1]) : mxGetNaN();
+
+  // Keep only the rows and columns containing at least one value
+  std::vector<mwSignedIndex> row_map(m, -1), col_map(n, -1);
+  for (k = 0; k < nnz; k++) {
+    row_map[irs[k]] = 0;
+  }
+  nrows = 0;
+  for (i = 0; i < m; i++) {
+    if (row_map[i] == 0) {
+      row_map[i] = nrows++;
+    }
+  }
+  ncols = 0;
+  for (j = 0; j < n; j++) {
+    if (jcs[j+1] > jcs[j]) {
+      col_map[j] = ncols++;
+    }
+  }
+
+  dim = __MAX__(nrows, ncols);
+  if (dim == 0) {
+    plhs[0] = mxCreateDoubleMatrix(0, 0, mxREAL);
+    if (nlhs > 1) {
+      plhs[1] = mxCreateDoubleMatrix(0, 0, mxREAL);
+    }
+    return;
+  }
+
+  // The reduced matrix, the values themselves are not moved
+  std::vector<mwIndex> red_jcs(ncols+1, 0), red_irs(nnz);
+  for (j = 0; j < n; j++) {
+    if (col_map[j] >= 0) {
+      red_jcs[col_map[j]+1] = jcs[j+1];
+    }
+  }
+  for (k = 0; k < nnz; k++) {
+    red_irs[k] = row_map[irs[k]];
+  }
+
+  // The connected components of the bipartite graph of the possible assignments,
+  // rows being the nodes 0...nrows-1 and columns the following ones
+  std::vector<mwIndex> parent(nrows+ncols), sizes(nrows+ncols, 1);
+  for (i = 0; i < nrows+ncols; i++) {
+    parent[i] = i;
+  }
+  for (j = 0; j < ncols; j++) {
+    for (k = red_jcs[j]; k < red_jcs[j+1]; k++) {
+      r = find_root(parent, red_irs[k]);
+      c = find_root(parent, nrows + j);
+      if (r != c) {
+        if (sizes[r] < sizes[c]) {
+          std::swap(r, c);
+        }
+        parent[c] = r;
+        sizes[r] += sizes[c];
+      }
+    }
+  }
+
+  // Each component is an independent assignment problem
+  std::vector<mwIndex> row_assign(nrows);
+  ncomps = 0;
+  for (i = 0; i < nrows+ncols; i++) {
+    if (parent[i] == i) {
+      ncomps++;
+    }
+  }
+
+  if (ncomps == 1) {
+    is_valid = solve_lap(nrows, ncols, &red_jcs[0], &red_irs[0], pr, resolution,
+                         &row_assign[0], cost);
+  } else {
+
+    // Number the components and list their rows and columns, which get a local index
+    std::vector<mwIndex> comp_id(nrows+ncols), local_id(nrows+ncols);
+    std::vector<mwIndex> row_start(ncomps+1, 0), col_start(ncomps+1, 0), comp_nnz(ncomps, 0);
+    std::vector<mwIndex> comp_rows(nrows), comp_cols(ncols);
+
+    c = 0;
+    for (i = 0; i < nrows+ncols; i++) {
+      if (parent[i] == i) {
+        comp_id[i] = c++;
+      }
+    }
+    for (i = 0; i < nrows+ncols; i++) {
+      comp_id[i] = comp_id[find_root(parent, i)];
+      if (i < nrows) {
+        local_id[i] = row_start[comp_id[i]+1]++;
+      } else {
+        local_id[i] = col_start[comp_id[i]+1]++;
+        comp_nnz[comp_id[i]] += red_jcs[i-nrows+1] - red_jcs[i-nrows];
+      }
+    }
+    for (c = 0; c < ncomps; c++) {
+      row_start[c+1] += row_start[c];
+      col_start[c+1] += col_start[c];
+    }
+    for (i = 0; i < nrows; i++) {
+      comp_rows[row_start[comp_id[i]] + local_id[i]] = i;
+    }
+    for (j = 0; j < ncols; j++) {
+      comp_cols[col_start[comp_id[nrows+j]] + local_id[nrows+j]] = j;
+    }
+
+    // Solve the largest problems first to balance the load among threads
+    std::vector<std::pair<mwIndex, mwIndex> > order(ncomps);
+    for (c = 0; c < ncomps; c++) {
+      order[c] = std::make_pair(comp_nnz[c], c);
+    }
+    std::sort(order.rbegin(), order.rend());
+
+    std::vector<double> comp_costs(ncomps);
+    std::vector<char> comp_valid(ncomps);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (p = 0; p < (mwSignedIndex)ncomps; p++) {
+      mwIndex comp, sub_rows, sub_cols, sub_i, sub_j, sub_k;
+
+      comp = order[p].second;
+      sub_rows = row_start[comp+1] - row_start[comp];
+      sub_cols = col_start[comp+1] - col_start[comp];
+
+      // Copy the sub-matrix, with local row indexes
+      std::vector<mwIndex> sub_jcs(sub_cols+1, 0), sub_irs, sub_assign(sub_rows);
+      std::vector<double> sub_pr;
+
+      sub_irs.reserve(comp_nnz[comp]);
+      sub_pr.reserve(comp_nnz[comp]);
+      for (sub_j = 0; sub_j < sub_cols; sub_j++) {
+        j = comp_cols[col_start[comp] + sub_j];
+        for (sub_k = red_jcs[j]; sub_k < red_jcs[j+1]; sub_k++) {
+          sub_irs.push_back(local_id[red_irs[sub_k]]);
+          sub_pr.push_back(pr[sub_k]);
+        }
+        sub_jcs[sub_j+1] = sub_irs.size();
+      }
+
+      comp_valid[comp] = solve_lap(sub_rows, sub_cols, &sub_jcs[0], &sub_irs[0], &sub_pr[0],
+                                   resolution, &sub_assign[0], comp_costs[comp]);
+
+      // Back to the global indexes, dummy columns being marked with ncols
+      for (sub_i = 0; sub_i < sub_rows; sub_i++) {
+        if (sub_assign[sub_i] < sub_cols) {
+          row_assign[comp_rows[row_start[comp] + sub_i]] = comp_cols[col_start[comp] + sub_assign[sub_i]];
+        } else {
+          row_assign[comp_rows[row_start[comp] + sub_i]] = ncols;
+        }
+      }
+    }
+
+    is_valid = true;
+    cost = 0;
+    for (c = 0; c < ncomps; c++) {
+      is_valid = is_valid && comp_valid[c];
+      cost += comp_costs[c];
+    }
+
+    // Rows left without a column are paired with the free columns, as the single
+    // problem would do, which makes the assignment infeasible. The remaining ones get
+    // the dummy columns of the transposed problem.
+    std::vector<bool> col_used(ncols, false);
+    for (i = 0; i < nrows; i++) {
+      if (row_assign[i] < ncols) {
+        col_used[row_assign[i]] = true;
+      }
+    }
+    j = 0;
+    dummy = ncols;
+    for (i = 0; i < nrows; i++) {
+      if (row_assign[i] >= ncols) {
+        while (j < ncols && col_used[j]) {
+          j++;
+        }
+        if (j < ncols) {
+          row_assign[i] = j;
+          col_used[j] = true;
+          cost = mxGetInf();
+        } else {
+          row_assign[i] = dummy++;
+        }
+      }
+    }
+  }
+
+  if (!is_valid) {
+    mexErrMsgIdAndTxt("CAST:lapjv_sparse_mex:noAugmentingPath",
+        "Could not find an augmenting path.");
+  }
+
+  // Output the assignment like munkres does
+  swapf = (nrows > ncols);
+  if (swapf) {
+    plhs[0] = mxCreateDoubleMatrix(dim, 1, mxREAL);
+  } else {
+    plhs[0] = mxCreateDoubleMatrix(1, nrows, mxREAL);
+  }
+  assignment = mxGetPr(plhs[0]);
+  for (i = 0; i < nrows; i++) {
+    assignment[i] = row_assign[i] + 1;
+  }
+
+  if (nlhs > 1) {
+    plhs[1] = mxCreateDoubleScalar(cost);
+  }
+
+  return;
+}
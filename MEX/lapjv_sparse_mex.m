@@ -0,0 +1,23 @@
+% LAPJV_SPARSE_MEX Jonker-Volgenant Algorithm for sparse Linear Assignment Problems.
+%
+%   [ASSIGNMENT, COST] = LAPJV_SPARSE_MEX(COSTMAT) returns the optimal column indices,
+%   ASSIGNMENT assigned to each row and the minimum COST based on the assignment
+%   problem represented by the sparse COSTMAT, where the (i,j)th element represents
+%   the cost to assign the jth job to the ith worker. Missing values in COSTMAT are
+%   considered as impossible assignments.
+%
+%   [ASSIGNMENT, COST] = LAPJV_SPARSE_MEX(COSTMAT, RESOLUTION) accepts in addition the
+%   minimum RESOLUTION to differentiate costs between assignments (default: eps of
+%   the largest cost).
+%
+%   This is a C++ implementation of lapjv_fast_sparse.m which accesses the rows of
+%   COSTMAT in constant time. In addition, COSTMAT is decomposed into the connected
+%   components of its possible assignments, which are solved independently (and in
+%   parallel if compiled with OpenMP). When COSTMAT is fully connected, it provides
+%   the same assignments as lapjv_fast_sparse.m, otherwise only equal costs might
+%   be assigned differently.
+%
+% References:
+%   [1] R. Jonker and A. Volgenant, "A shortest augmenting path algorithm for
+%       dense and spare linear assignment problems", Computing, Vol. 38, pp.
+%       325-340, 1987.
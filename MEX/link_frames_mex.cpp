@@ -0,0 +1,199 @@
+#include <vector>
+#include <algorithm>
+#include "gaussian_spots.h"
+#include "spatial_grid.h"
+#include "linking_costs.h"
+#include "lap_alternative.h"
+
+#include "gaussian_spots.c"
+#include "spatial_grid.c"
+#include "linking_costs.c"
+#include "lap_alternative.cpp"
+
+// The links between one frame and the previous one, as (end, start) pairs sorted by
+// end spots, and the costs of these links sorted by start spots
+typedef struct {
+  std::vector<mwIndex> ends, starts;
+  std::vector<double> dists;
+} frame_links;
+
+// Computes the frame-to-frame cost matrix and solves the corresponding assignment,
+// the alternative costs being the largest cost of the matrix
+static void link_frame(const linking_data *data, frame_links *links) {
+
+  mwIndex i, j, k, nnz;
+  double curr_max;
+
+  if (data->m1 == 0 || data->m2 == 0) {
+    return;
+  }
+
+  // The cost matrix, built in two passes as in linking_cost_sparse_mex
+  std::vector<mwIndex> jcs(data->m2+1, 0);
+  for (i = 0; i < data->m2; i++) {
+    jcs[i+1] = jcs[i] + linking_column(data, i, NULL, NULL);
+  }
+  nnz = jcs[data->m2];
+
+  std::vector<mwIndex> irs(nnz+1);
+  std::vector<double> pr(nnz+1);
+  for (i = 0; i < data->m2; i++) {
+    linking_column(data, i, &irs[jcs[i]], &pr[jcs[i]]);
+  }
+
+  // Use some default values if no linking is possible
+  curr_max = 1;
+  if (nnz > 0) {
+    curr_max = pr[0];
+    for (k = 1; k < nnz; k++) {
+      curr_max = __MAX__(curr_max, pr[k]);
+    }
+  }
+
+  // And solve the assignment
+  std::vector<double> row_costs(data->m1, curr_max), col_costs(data->m2, curr_max);
+  std::vector<mwSignedIndex> assign(data->m1), starts(data->m2, -1);
+
+  solve_lap_alternative(data->m1, data->m2, &jcs[0], &irs[0], &pr[0], &row_costs[0],
+                        &col_costs[0], &assign[0]);
+
+  // Retrieve the costs of the links
+  for (i = 0; i < data->m1; i++) {
+    if (assign[i] >= 0) {
+      j = assign[i];
+      k = std::lower_bound(irs.begin() + jcs[j], irs.begin() + jcs[j+1], i) - irs.begin();
+
+      links->dists.push_back(pr[k]);
+      starts[j] = i;
+    }
+  }
+
+  // And invert the assignment as we store next -> prev links
+  for (j = 0; j < data->m2; j++) {
+    if (starts[j] >= 0) {
+      links->ends.push_back(j);
+      links->starts.push_back(starts[j]);
+    }
+  }
+
+  return;
+}
+
+// The main of the MATLAB interface
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+  mwSize nframes, ndists, nlinks, n;
+  mwIndex i, k;
+  mwSignedIndex f;
+  double max_move, max_ratio, *pr;
+  const mxArray *spots;
+  mxArray *frame;
+
+  // Check for proper number of input and output arguments
+  if (nrhs != 3) {
+    mexErrMsgIdAndTxt("CAST:link_frames_mex:invalidNumInputs",
+        "Three input arguments required.");
+  }
+
+  // Check data type of input argument
+  if (!mxIsCell(prhs[0])) {
+    mexErrMsgIdAndTxt("CAST:link_frames_mex:inputNotCell",
+        "Input argument (1) must be of type cell.");
+  }
+
+  spots = prhs[0];
+  nframes = mxGetNumberOfElements(spots);
+  max_move = mxGetScalar(prhs[1]);
+  max_ratio = mxGetScalar(prhs[2]);
+
+  // Prepare the data of each pair of frames, the spatial grids being built beforehand
+  // as they allocate memory through MATLAB
+  std::vector<linking_data> data(nframes);
+  std::vector<frame_links> links(nframes);
+
+  for (i = 0; i < nframes; i++) {
+    frame = mxGetCell(spots, i);
+
+    if (frame == NULL || mxIsEmpty(frame)) {
+      data[i].m2 = 0;
+      data[i].x2 = NULL;
+    } else {
+      if (!mxIsDouble(frame)) {
+        mexErrMsgIdAndTxt("CAST:link_frames_mex:inputNotDouble",
+            "The spots must be of type double.");
+      }
+
+      data[i].m2 = mxGetM(frame);
+      n = mxGetN(frame);
+
+      // The signal is stored in the last column
+      data[i].x2 = mxGetPr(frame);
+      data[i].y2 = data[i].x2 + data[i].m2;
+      data[i].signal2 = data[i].x2 + (n-1)*data[i].m2;
+    }
+
+    // The thresholds
+    data[i].radius = max_move;
+    data[i].thresh = __SQR__(max_move);
+    data[i].thresh2 = max_ratio;
+    data[i].eps = mxGetEps();
+
+    // The previous frame
+    if (i > 0) {
+      data[i].m1 = data[i-1].m2;
+      data[i].x1 = data[i-1].x2;
+      data[i].y1 = data[i-1].y2;
+      data[i].signal1 = data[i-1].signal2;
+    } else {
+      data[i].m1 = 0;
+      data[i].x1 = NULL;
+    }
+
+    if (data[i].m1 > 0 && data[i].m2 > 0) {
+      build_spatial_grid(&data[i].grid, data[i].x1, data[i].y1, data[i].m1, data[i].radius);
+    }
+  }
+
+  // Each pair of frames is independent
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (f = 1; f < (mwSignedIndex)nframes; f++) {
+    link_frame(&data[f], &links[f]);
+  }
+
+  // Copy the links in the format of track_spots
+  plhs[0] = mxCreateCellMatrix(nframes, 1);
+  ndists = 0;
+  for (i = 0; i < nframes; i++) {
+    nlinks = links[i].ends.size();
+    frame = mxCreateDoubleMatrix(nlinks, 3, mxREAL);
+    pr = mxGetPr(frame);
+
+    for (k = 0; k < nlinks; k++) {
+      pr[k] = links[i].ends[k] + 1;
+      pr[k + nlinks] = links[i].starts[k] + 1;
+      pr[k + 2*nlinks] = i;
+    }
+    mxSetCell(plhs[0], i, frame);
+
+    ndists += links[i].dists.size();
+
+    if (data[i].m1 > 0 && data[i].m2 > 0) {
+      free_spatial_grid(&data[i].grid);
+    }
+  }
+
+  // And all the assigned distances
+  if (nlhs > 1) {
+    plhs[1] = mxCreateDoubleMatrix(ndists, 1, mxREAL);
+    pr = mxGetPr(plhs[1]);
+
+    for (i = 0; i < nframes; i++) {
+      for (k = 0; k < links[i].dists.size(); k++) {
+        *pr = links[i].dists[k];
+        pr++;
+      }
+    }
+  }
+
+  return;
+}
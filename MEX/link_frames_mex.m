@@ -0,0 +1,21 @@
+% LINK_FRAMES_MEX links the spots of all pairs of consecutive frames at once.
+%
+%   LINKS = LINK_FRAMES_MEX(SPOTS, MAX_DIST, MAX_RATIO) computes the frame-to-frame
+%   LINKS between the SPOTS of consecutive frames, as done in the first step of
+%   track_spots.m. SPOTS should be a cell vector, each cell containing the matrix of
+%   spots of the corresponding frame, with the signal in its last column. The cost
+%   matrices are computed as in linking_cost_sparse_mex, using MAX_DIST and MAX_RATIO
+%   as thresholds, and the assignments are solved as in lap_alternative_sparse_mex,
+%   using the largest cost as alternative. LINKS has the same size as SPOTS, each cell
+%   containing one link per row as follow:
+%     [end_spot_index, start_spot_index, start_spot_frame_index]
+%
+%   [LINKS, DISTS] = LINK_FRAMES_MEX(...) returns in addition the costs of all the
+%   assigned links, DISTS.
+%
+%   Pairs of frames are processed in parallel if compiled with OpenMP.
+%
+% References:
+%   [1] Jaqaman K, Loerke D, Mettlen M, Kuwata H, Grinstein S, et al. Robust
+%       single-particle tracking in live-cell time-lapse sequences. Nat Methods 5:
+%       695-702 (2008).
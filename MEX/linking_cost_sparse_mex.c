@@ -1,16 +1,20 @@
 #include "gaussian_spots.h"
+#include "spatial_grid.h"
+#include "linking_costs.h"
 
 #include "gaussian_spots.c"
+#include "spatial_grid.c"
+#include "linking_costs.c"
 
 // The main of the MATLAB interface
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 {
   // Declare variable
-  mwSize m1,n1, m2, n2;
-  mwSize nzmax, nzstep, nzfull;
-  mwIndex *irs,*jcs,i,j, count;
-  double *x1,*y1,*x2,*y2,*rs;
-  double dist, thresh, thresh2, signal1, signal2, weight, eps;
+  mwSize n1, n2;
+  mwSignedIndex i;
+  mwIndex *irs,*jcs,*counts;
+  double *rs;
+  linking_data data;
 
   // Check for proper number of input and output arguments
   if (nrhs != 4) {
@@ -25,87 +29,54 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
   }
 
   // Get the size and pointers to input data
-  m1  = mxGetM(prhs[0]);
+  data.m1  = mxGetM(prhs[0]);
   n1  = mxGetN(prhs[0]);
 
   // Get the different pointers to the various columns of data
-  x1  = mxGetPr(prhs[0]);
-  y1  = x1 + m1;
+  data.x1  = mxGetPr(prhs[0]);
+  data.y1  = data.x1 + data.m1;
+  data.signal1  = data.x1 + (n1-3)*data.m1;
 
   // Same for the other matrix
-  m2  = mxGetM(prhs[1]);
+  data.m2  = mxGetM(prhs[1]);
   n2  = mxGetN(prhs[1]);
 
-  x2  = mxGetPr(prhs[1]);
-  y2  = x2 + m2;
+  data.x2  = mxGetPr(prhs[1]);
+  data.y2  = data.x2 + data.m2;
+  data.signal2  = data.x2 + (n2-3)*data.m2;
 
   // Get the two thresholds
-  thresh = __SQR__(mxGetScalar(prhs[2]));
-  thresh2 = mxGetScalar(prhs[3]);
+  data.radius = mxGetScalar(prhs[2]);
+  data.thresh = __SQR__(data.radius);
+  data.thresh2 = mxGetScalar(prhs[3]);
 
   // And our zero value
-  eps = mxGetEps();
+  data.eps = mxGetEps();
 
-  // A guess on the number of elements needed
-  nzmax=(mwSize)ceil((double)m1*(double)m2*0.1);
-  nzstep=(mwSize)__MAX__(ceil((double)nzmax*0.25),1);
-  nzfull=m1*m2;
+  // Index the first set of spots such that only the close ones get compared
+  build_spatial_grid(&data.grid, data.x1, data.y1, data.m1, data.radius);
+
+  // First count the number of elements in each column, to allocate exactly the
+  // required memory, then fill them. Columns are independent so both passes can
+  // be run in parallel.
+  counts = mxCalloc(data.m2+1, sizeof(mwIndex));
+
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (i = 0; i < (mwSignedIndex)data.m2; i++) {
+    counts[i+1] = linking_column(&data, i, NULL, NULL);
+  }
 
   // Prepare the output
-  plhs[0] = mxCreateSparse(m1,m2,nzmax,false);
+  plhs[0] = create_sparse_from_counts(data.m1, data.m2, counts);
   rs  = mxGetPr(plhs[0]);
   irs = mxGetIr(plhs[0]);
   jcs = mxGetJc(plhs[0]);
 
-  // Need to count the number of elements inserted in the sparse matrix
-  count = 0;
-  for (i = 0; i < m2; i++) {
-
-    // Get the signal
-    signal2 = x2[i + (n2-3)*m2];
-
-    // The number of elements up to the current column
-    jcs[i] = count;
-
-    // Now parse the other spots
-    for (j = 0; j < m1; j++) {
-      dist = __SQR__(x2[i]-x1[j]) + __SQR__(y2[i]-y1[j]);
-
-      // Only if it passes the threshold
-      if (dist <= thresh) {
-
-        // Get the other signal
-        signal1 = x1[j + (n1-3)*m1];
-
-        // The weight
-        weight = __WGT__(signal2 / signal1);
-
-        // Enforce the intensity threshold
-        if (weight <= thresh2) {
-
-          // Here we might need to increase the number of elements in the matrix
-          if (count >= nzmax){
-            nzmax += nzstep;
-            nzmax = __MIN__(nzmax, nzfull);
-
-            mxSetNzmax(plhs[0], nzmax);
-            mxSetPr(plhs[0], mxRealloc(rs, nzmax*sizeof(double)));
-            mxSetIr(plhs[0], mxRealloc(irs, nzmax*sizeof(mwIndex)));
-
-            rs  = mxGetPr(plhs[0]);
-            irs = mxGetIr(plhs[0]);
-          }
-
-          // Store it in the matrix
-          rs[count] = __MAX__(dist, eps);
-          irs[count] = j;
-
-          count++;
-        }
-      }
-    }
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (i = 0; i < (mwSignedIndex)data.m2; i++) {
+    linking_column(&data, i, irs + jcs[i], rs + jcs[i]);
   }
 
-  // Requried to finalize the sparse matrix
-  jcs[m2] = count;
+  mxFree(counts);
+  free_spatial_grid(&data.grid);
 }
@@ -0,0 +1,55 @@
+#include "linking_costs.h"
+
+// Computes the costs of linking spot i from the second set to the first one.
+// Returns the number of valid costs, which are only stored if irs is not NULL.
+mwSize linking_column(const linking_data *data, mwIndex i, mwIndex *irs, double *rs) {
+
+  mwIndex j, k, cx, cy, cell, range[4];
+  mwSize count;
+  double dist, weight;
+
+  count = 0;
+
+  // Skip the spots that have no neighbor at all
+  if (!get_grid_range(&data->grid, data->x2[i], data->y2[i], data->radius, range)) {
+    return count;
+  }
+
+  // Now parse the other spots, but only in the neighboring cells
+  for (cx = range[0]; cx <= range[1]; cx++) {
+    for (cy = range[2]; cy <= range[3]; cy++) {
+      cell = cx*data->grid.ny + cy;
+
+      for (k = data->grid.cells[cell]; k < data->grid.cells[cell+1]; k++) {
+        j = data->grid.indexes[k];
+        dist = __SQR__(data->x2[i]-data->x1[j]) + __SQR__(data->y2[i]-data->y1[j]);
+
+        // Only if it passes the threshold
+        if (dist <= data->thresh) {
+
+          // The weight
+          weight = __WGT__(data->signal2[i] / data->signal1[j]);
+
+          // Enforce the intensity threshold
+          if (weight <= data->thresh2) {
+
+            // Store it in the matrix
+            if (irs != NULL) {
+              rs[count] = __MAX__(dist, data->eps);
+              irs[count] = j;
+            }
+
+            count++;
+          }
+        }
+      }
+    }
+  }
+
+  // Sparse matrices require sorted row indexes
+  if (irs != NULL) {
+    sort_column(irs, rs, count);
+  }
+
+  return count;
+}
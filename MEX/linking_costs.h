@@ -0,0 +1,26 @@
+#ifndef LINKING_H
+#define LINKING_H
+
+#include "gaussian_spots.h"
+#include "spatial_grid.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The data required to compute one column of the frame-to-frame cost matrix, the
+// first set of spots being indexed by a spatial grid
+typedef struct {
+  mwSize m1, m2;
+  double *x1, *y1, *signal1, *x2, *y2, *signal2;
+  double radius, thresh, thresh2, eps;
+  spatial_grid grid;
+} linking_data;
+
+mwSize linking_column(const linking_data *data, mwIndex i, mwIndex *irs, double *rs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,192 @@
+#include <math.h>
+#include <string.h>
+#include "ctmf.h"
+#include "ctmf16.h"
+#include "cache_size.h"
+#include "image_types.h"
+#include "mex.h"
+
+#include "ctmf.c"
+#include "ctmf16.c"
+#include "cache_size.c"
+
+/* The histograms count using 16 bits, which limits the size of the kernel. */
+#define MAX_RADIUS 127
+
+/* Filters a 8 bits image niter times, swapping the two buffers at each call. */
+static unsigned char *median_uint8(unsigned char *img, unsigned char *tmp_img, int h, int w,
+                                   int radius, int niter, unsigned long memsize) {
+  int i;
+  unsigned char *tmp_ptr;
+
+  for (i = 0; i < niter; i++) {
+    ctmf(img, tmp_img, h, w, h, h, radius, 1, memsize);
+
+    tmp_ptr = tmp_img;
+    tmp_img = img;
+    img = tmp_ptr;
+  }
+
+  return img;
+}
+
+/* Same for a 16 bits image. */
+static uint16_t *median_uint16(uint16_t *img, uint16_t *tmp_img, int h, int w,
+                               int radius, int niter, unsigned long memsize) {
+  int i;
+  uint16_t *tmp_ptr;
+
+  for (i = 0; i < niter; i++) {
+    ctmf16(img, tmp_img, h, w, h, h, radius, memsize);
+
+    tmp_ptr = tmp_img;
+    tmp_img = img;
+    img = tmp_ptr;
+  }
+
+  return img;
+}
+
+/* Filters a floating point image niter times, by rescaling it to 16 bits, and stores
+ * the result in the output of the same class. */
+template<typename T>
+static void median_float(const T *img, T *output, int h, int w, int radius, int niter,
+                         unsigned long memsize) {
+  int i, nelem = h*w;
+  uint16_t *median_16bits, *tmp_16bits, *result_16bits;
+  double value, mymin, mymax, scaling_factor;
+
+  /* Allocate memory for the computations. */
+  median_16bits = (uint16_t *)mxCalloc(nelem, sizeof(uint16_t));
+  tmp_16bits = (uint16_t *)mxCalloc(nelem, sizeof(uint16_t));
+
+  /* We need to convert our floating point image to UINT16.
+   * So we first need to find the range of values present, ignoring NaNs. */
+  mymin = mxGetInf();
+  mymax = -mymin;
+  for (i = 0; i < nelem; i++) {
+    if (img[i] < mymin) {
+      mymin = img[i];
+    }
+    if (img[i] > mymax) {
+      mymax = img[i];
+    }
+  }
+
+  /* Then we compute the scaling factor, a flat image remaining flat. */
+  if (mymin > mymax) {
+    mymin = mymax = 0;
+  }
+  scaling_factor = (mymax > mymin) ? 65535 / (mymax - mymin) : 0;
+
+  /* And we convert the image, setting NaN to the minimum. */
+  for (i = 0; i < nelem; i++){
+    if (mxIsNaN(img[i])) {
+      median_16bits[i] = 0;
+    } else {
+      value = floor(scaling_factor*(img[i] - mymin) + 0.5);
+
+      median_16bits[i] = (uint16_t) value;
+    }
+  }
+
+  /* Now let's filter it as many times as requried. */
+  result_16bits = median_uint16(median_16bits, tmp_16bits, h, w, radius, niter, memsize);
+
+  /* Copy the image, rescaling it properly. */
+  scaling_factor = (scaling_factor > 0) ? 1/scaling_factor : 0;
+  for (i=0;i < nelem; i++) {
+    output[i] = (T)(((double) result_16bits[i]) * scaling_factor + mymin);
+  }
+
+  /* Free the two buffers. */
+  mxFree(median_16bits);
+  mxFree(tmp_16bits);
+
+  return;
+}
+
+/*
+ * The Matlab wrapper for the C code from ctmf.c, implementing constant-time median
+ * filtering (see median_mex.m), and for its 16 bits extension ctmf16.c. The class
+ * of the image is preserved.
+ */
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+  /* Declaring the variables with their default values. */
+  int h, w, nelem, niter = 1, radius = 1;
+  unsigned long memsize;
+  unsigned char *tmp_8bits, *median_8bits, *result_8bits;
+  uint16_t *tmp_16bits, *median_16bits, *result_16bits;
+  mxClassID class_id;
+
+  /* We accept either 1, 2 or 3 input arguments, always in the same order.
+   * 1. The image 2. the radius of the kernel 3. the number of iterative calls. */
+  if (nrhs < 1) {
+    mexErrMsgTxt("Not enough input arguments (1 is the minimum, 3 is the maximum) !");
+  } else if (nrhs == 2) {
+    radius = (int) mxGetScalar(prhs[1]);
+  } else if (nrhs == 3) {
+    radius = (int) mxGetScalar(prhs[1]);
+    niter = (int) mxGetScalar(prhs[2]);
+  }
+  if (radius < 0 || radius > MAX_RADIUS) {
+    mexErrMsgTxt("The radius of the kernel should be between 0 and 127 !");
+  }
+
+  /* Get the dimensions of the image. */
+  if (!is_supported_image(prhs[0])) {
+    mexErrMsgTxt("Only uint8, uint16, single and double images are supported !");
+  }
+  class_id = mxGetClassID(prhs[0]);
+  h = mxGetM(prhs[0]);
+  w = mxGetN(prhs[0]);
+  nelem = h*w;
+
+  /* The stripes processed by the filters should fit into the L2 cache. */
+  memsize = l2_cache_size();
+
+  /* Integer images are filtered directly, without any conversion. */
+  plhs[0] = mxCreateNumericMatrix(h, w, class_id, mxREAL);
+  if (nelem == 0) {
+    return;
+  }
+
+  switch (class_id) {
+    case mxUINT8_CLASS:
+      median_8bits = (unsigned char *)mxMalloc(nelem*sizeof(unsigned char));
+      tmp_8bits = (unsigned char *)mxMalloc(nelem*sizeof(unsigned char));
+      memcpy(median_8bits, mxGetData(prhs[0]), nelem*sizeof(unsigned char));
+
+      result_8bits = median_uint8(median_8bits, tmp_8bits, h, w, radius, niter, memsize);
+      memcpy(mxGetData(plhs[0]), result_8bits, nelem*sizeof(unsigned char));
+
+      mxFree(median_8bits);
+      mxFree(tmp_8bits);
+      break;
+
+    case mxUINT16_CLASS:
+      median_16bits = (uint16_t *)mxMalloc(nelem*sizeof(uint16_t));
+      tmp_16bits = (uint16_t *)mxMalloc(nelem*sizeof(uint16_t));
+      memcpy(median_16bits, mxGetData(prhs[0]), nelem*sizeof(uint16_t));
+
+      result_16bits = median_uint16(median_16bits, tmp_16bits, h, w, radius, niter, memsize);
+      memcpy(mxGetData(plhs[0]), result_16bits, nelem*sizeof(uint16_t));
+
+      mxFree(median_16bits);
+      mxFree(tmp_16bits);
+      break;
+
+    /* While floating point ones are rescaled to 16 bits. */
+    case mxSINGLE_CLASS:
+      median_float((const float *)mxGetData(prhs[0]), (float *)mxGetData(plhs[0]),
+                   h, w, radius, niter, memsize);
+      break;
+    default:
+      median_float((const double *)mxGetData(prhs[0]), (double *)mxGetData(plhs[0]),
+                   h, w, radius, niter, memsize);
+      break;
+  }
+
+  return;
+}
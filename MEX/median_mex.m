@@ -1,9 +1,12 @@
-% MEDIAN_MEX constant-time median filter in C using the implementation from [1]. Note
-% that the size of the memory has to be hard-coded so if you experience drastic slow-
-% down, consider adapting it in MEX/median_mex.c
+% MEDIAN_MEX constant-time median filter in C using the implementation from [1], and
+% its 16 bits extension (see MEX/ctmf16.c). The image is processed in stripes fitting
+% into the L2 cache of the processor, in parallel if compiled with OpenMP.
 %
 %   MED = MEDIAN_MEX(IMG, RADIUS) applies a median filter with RADIUS on IMG. The
-%   kernel of the filter will thus be a 2*RADIUS+1 square.
+%   kernel of the filter will thus be a 2*RADIUS+1 square, RADIUS being at most 127.
+%   UINT8 and UINT16 images are filtered directly, while single and double images are
+%   rescaled to 16 bits, NaN being replaced by the minimal value. MED has the same
+%   class as IMG.
 %
 %   MED = MEDIAN_MEX(IMG, RADIUS, NITER) applies the filter NITER times iteratively.
 %
@@ -185,6 +185,7 @@ typedef void*                           GW_UserData;
 
 #include <math.h>
 #include "mex.h"
+#include "image_types.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -215,6 +216,7 @@ int na = -1;    // width of Ma
 int ma = -1;    // height of Ma
 double* M1 = NULL;      // output
 double* Ma = NULL;      // exemplar image to transfer 
+bool free_Ma = false;   // whether Ma has been converted to double
 double* H = NULL;       // vectorized patches to denoise
 double* Ha = NULL;      // vectorized exemplar patches to transfer
 double* Vx = NULL;
@@ -512,9 +514,18 @@ void mexFunction(       int nlhs, mxArray *plhs[],
   if( nlhs!=3 )
     mexErrMsgTxt("3 output arguments required.");
 
-  // -- input 1 : Ma --
+  // -- input 1 : Ma, converted to double if need be --
   get_dimensions( prhs[0], ma,na,s );
-  Ma = mxGetPr(prhs[0]);
+  if( !is_supported_image(prhs[0]) )
+    mexErrMsgTxt("Ma should be of type uint8, uint16, single or double.");
+  free_Ma = !mxIsDouble(prhs[0]);
+  if( free_Ma )
+  {
+    Ma = (double*) malloc( ma*na*s*sizeof(double) );
+    copy_image( prhs[0], Ma );
+  }
+  else
+    Ma = mxGetPr(prhs[0]);
 
   // -- input 2 : H --
   get_dimensions( prhs[1], m,n,k );
@@ -609,4 +620,6 @@ void mexFunction(       int nlhs, mxArray *plhs[],
   else
     denoise_patchwise();
   free( w );
+  if( free_Ma )
+    free( Ma );
 }
@@ -4,7 +4,8 @@
 %
 %   [M1,Wx,Wy] = NL_MEANS_MEX(M,HA,HA,VX,VY,T,MAX_DIST,DO_MEDIAN,DO_PATCHWISE, ...
 %   MASK_PROCESS,MASK_COPY,EXCLUDE_SELF) filters M into M1 using Non-local Means. All
-%   additional are identical to the original code from Gabriel Peyre.
+%   additional are identical to the original code from Gabriel Peyre. M can be of
+%   class uint8, uint16, single or double.
 %
 % References:
 % [1] Buades A, Coll B, Morel JM, "On image denoising methods". SIAM Multiscale Model
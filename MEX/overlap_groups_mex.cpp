@@ -0,0 +1,170 @@
+#include <math.h>
+#include <vector>
+#include "spatial_grid.h"
+#include "mex.h"
+
+#include "spatial_grid.c"
+
+// The root of the set containing i, compressing the path along the way
+static mwIndex find_root(std::vector<mwIndex> &parents, mwIndex i) {
+
+  mwIndex root = i, next;
+
+  while (parents[root] != root) {
+    root = parents[root];
+  }
+  while (parents[i] != root) {
+    next = parents[i];
+    parents[i] = root;
+    i = next;
+  }
+
+  return root;
+}
+
+// Merges the sets containing i and j, the smallest index being kept as root
+static void merge_sets(std::vector<mwIndex> &parents, mwIndex i, mwIndex j) {
+
+  i = find_root(parents, i);
+  j = find_root(parents, j);
+
+  if (i < j) {
+    parents[j] = i;
+  } else if (j < i) {
+    parents[i] = j;
+  }
+
+  return;
+}
+
+// Tests whether the spots i and j overlap, as in fuse_gaussians.m for circular spots
+// and in fuse_windows.m for rectangular ones
+static inline bool is_overlapping(const double *x, const double *y, const double *radx,
+                                  const double *rady, double ratio, mwIndex i, mwIndex j) {
+
+  double dx = x[i] - x[j], dy = y[i] - y[j];
+
+  if (rady == NULL) {
+    return (sqrt(dx*dx + dy*dy) < ratio * (radx[i] + radx[j]));
+  } else {
+    return (fabs(dx) < ratio * (radx[i] + radx[j])) &&
+           (fabs(dy) < ratio * (rady[i] + rady[j]));
+  }
+}
+
+// Groups the overlapping spots using a spatial grid, see overlap_groups_mex.m
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+  mwSize npts, nradii, nsizes = 0, i, k, cx, cy;
+  mwIndex j, cell, range[4], label;
+  double *x, *y, *radx, *rady = NULL, *groups, ratio, maxx = 0, maxy = 0, mean = 0, radius;
+  spatial_grid grid;
+
+  // Check for proper number of input and output arguments
+  if (nrhs != 3) {
+    mexErrMsgIdAndTxt("CAST:overlap_groups_mex:invalidNumInputs",
+        "Three input arguments required.");
+  }
+  if (!mxIsDouble(prhs[0]) || mxGetN(prhs[0]) < 2) {
+    mexErrMsgIdAndTxt("CAST:overlap_groups_mex:invalidInput",
+        "Input argument (1) must be a double matrix of [X Y] positions.");
+  }
+
+  npts = mxGetM(prhs[0]);
+  x = mxGetPr(prhs[0]);
+  y = x + npts;
+
+  if (!mxIsDouble(prhs[1]) || mxGetM(prhs[1]) != npts || mxGetN(prhs[1]) < 1) {
+    mexErrMsgIdAndTxt("CAST:overlap_groups_mex:invalidInput",
+        "Input argument (2) must be a double matrix with one row of radii per spot.");
+  }
+
+  // Rectangular spots have one radius per dimension
+  nradii = mxGetN(prhs[1]);
+  radx = mxGetPr(prhs[1]);
+  if (nradii > 1) {
+    rady = radx + npts;
+  }
+
+  ratio = 1 - mxGetScalar(prhs[2]);
+
+  plhs[0] = mxCreateDoubleMatrix(npts, 1, mxREAL);
+  groups = mxGetPr(plhs[0]);
+  if (npts == 0) {
+    return;
+  }
+
+  // The largest radii bound the distance at which two spots can overlap, while the
+  // average one gives the typical size of the grid cells
+  for (i = 0; i < npts; i++) {
+    if (mxIsFinite(radx[i]) && radx[i] > maxx) {
+      maxx = radx[i];
+    }
+    if (rady != NULL && mxIsFinite(rady[i]) && rady[i] > maxy) {
+      maxy = rady[i];
+    }
+    if (mxIsFinite(radx[i]) && radx[i] > 0) {
+      mean += radx[i];
+      nsizes++;
+    }
+    if (mxIsInf(radx[i]) || (rady != NULL && mxIsInf(rady[i]))) {
+      maxx = maxy = mxGetInf();
+    }
+  }
+  mean = (nsizes > 0) ? 2 * ratio * mean / nsizes : 0;
+
+  build_spatial_grid(&grid, x, y, npts, mean);
+
+  // Spots are only merged with the following ones, as the overlap is symmetric, while
+  // spots which do not even overlap with themselves are not kept unless merged
+  std::vector<mwIndex> parents(npts);
+  std::vector<bool> kept(npts, false);
+  for (i = 0; i < npts; i++) {
+    parents[i] = i;
+  }
+
+  for (i = 0; i < npts; i++) {
+    if (is_overlapping(x, y, radx, rady, ratio, i, i)) {
+      kept[i] = true;
+    }
+
+    radius = ratio * (radx[i] + maxx);
+    if (rady != NULL) {
+      radius = __MAX__(radius, ratio * (rady[i] + maxy));
+    }
+    if (!(radius > 0) || !get_grid_range(&grid, x[i], y[i], radius, range)) {
+      continue;
+    }
+
+    for (cx = range[0]; cx <= range[1]; cx++) {
+      for (cy = range[2]; cy <= range[3]; cy++) {
+        cell = cx*grid.ny + cy;
+
+        for (k = grid.cells[cell]; k < grid.cells[cell+1]; k++) {
+          j = grid.indexes[k];
+          if (j > i && is_overlapping(x, y, radx, rady, ratio, i, j)) {
+            merge_sets(parents, i, j);
+            kept[i] = true;
+            kept[j] = true;
+          }
+        }
+      }
+    }
+  }
+
+  free_spatial_grid(&grid);
+
+  // The groups are numbered in the order of their first spot, the roots being their
+  // smallest index
+  label = 0;
+  for (i = 0; i < npts; i++) {
+    j = find_root(parents, i);
+    if (j == i) {
+      groups[i] = (kept[i]) ? ++label : 0;
+    } else {
+      groups[i] = groups[j];
+    }
+  }
+
+  return;
+}
@@ -0,0 +1,21 @@
+% OVERLAP_GROUPS_MEX groups the overlapping spots of a frame using a uniform grid to
+% retrieve the neighbors of each spot and union-find to merge their groups, instead
+% of comparing all pairs of spots. It is shared by fuse_gaussians.m and
+% fuse_windows.m.
+%
+%   GROUPS = OVERLAP_GROUPS_MEX(POS, RADII, THRESH) numbers the connected groups of
+%   the spots located at POS, [X Y], which overlap more than THRESH. If RADII has a
+%   single column, the spots are discs which overlap if their distance is smaller
+%   than (1-THRESH) times the sum of their radii. If RADII has two columns, the spots
+%   are rectangles, and the same condition must hold along both dimensions.
+%   GROUPS is a column vector numbering the groups in the order of their first spot,
+%   spots without any overlap, not even with themselves, being set to 0.
+%
+%   Rectangles with a null or negative half-size along one dimension do not overlap
+%   with themselves, but can overlap with other such rectangles. These are merged
+%   into a single group, while the iterative grouping used without the MEX alternates
+%   between the two sets of spots, which can then end up in separate groups.
+%
+%   The neighbors of each spot are searched within (1-THRESH) times the sum of its
+%   radius and of the largest radius of the frame. A single very large spot thus
+%   brings the search back to comparing all pairs of spots.
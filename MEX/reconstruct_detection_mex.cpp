@@ -0,0 +1,221 @@
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+#include "mex.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// The extent of the gaussians which is drawn, in number of standard deviations. The
+// pixels left out are below exp(-FOOTPRINT^2/2) of the amplitude.
+#define FOOTPRINT 4
+
+// The integral of a normalized gaussian over the pixels start to end along a line,
+// the gaussian being centered on mu with a standard deviation sigma. As in
+// GaussMask2D, the pixels are integrated from -0.5 to 0.5 around their 1-based index.
+// cdf must hold end-start+2 values.
+static void integrate_pixels(mwSignedIndex start, mwSignedIndex end, double mu, double sigma,
+                             double *cdf, double *vals) {
+
+  mwSignedIndex i;
+  double scaling = -1 / (sigma * sqrt(2.0));
+
+  for (i = start; i <= end + 1; i++) {
+    cdf[i - start] = 0.5 * erfc((i - 0.5 - mu) * scaling);
+  }
+  for (i = start; i <= end; i++) {
+    vals[i - start] = cdf[i - start + 1] - cdf[i - start];
+  }
+
+  return;
+}
+
+// Adds to the image of size h x w the nspots gaussians [x y sigma amplitude], as
+// GaussMask2D(sigma, [h w], [y x], 0, 1) * amplitude but only within FOOTPRINT
+// standard deviations of their center, the gaussians being separable
+static void draw_gaussians(const double *spots, mwSize nspots, mwSize h, mwSize w,
+                           double *img) {
+
+  mwSize s;
+  mwSignedIndex x0, x1, y0, y1, i, j;
+  double x, y, sigma, scaling;
+  std::vector<double> cdf, ex, ey;
+
+  for (s = 0; s < nspots; s++) {
+    x = spots[s];
+    y = spots[s + nspots];
+    sigma = spots[s + 2*nspots];
+
+    // A null gaussian has no intensity
+    if (!(sigma > 0) || !isfinite(x) || !isfinite(y)) {
+      continue;
+    }
+
+    // The footprint of the gaussian, in 1-based indexes within the image
+    x0 = (mwSignedIndex)floor(x - FOOTPRINT*sigma);
+    x1 = (mwSignedIndex)ceil(x + FOOTPRINT*sigma);
+    y0 = (mwSignedIndex)floor(y - FOOTPRINT*sigma);
+    y1 = (mwSignedIndex)ceil(y + FOOTPRINT*sigma);
+    x0 = (x0 < 1) ? 1 : x0;
+    y0 = (y0 < 1) ? 1 : y0;
+    x1 = (x1 > (mwSignedIndex)w) ? w : x1;
+    y1 = (y1 > (mwSignedIndex)h) ? h : y1;
+    if (x0 > x1 || y0 > y1) {
+      continue;
+    }
+
+    cdf.resize(((x1 - x0 > y1 - y0) ? x1 - x0 : y1 - y0) + 2);
+    ex.resize(x1 - x0 + 1);
+    ey.resize(y1 - y0 + 1);
+    integrate_pixels(x0, x1, x, sigma, &cdf[0], &ex[0]);
+    integrate_pixels(y0, y1, y, sigma, &cdf[0], &ey[0]);
+
+    // The maximum of the gaussian is its amplitude
+    scaling = (2*M_PI) * sigma * sigma * spots[s + 3*nspots];
+
+    for (i = x0; i <= x1; i++) {
+      for (j = y0; j <= y1; j++) {
+        img[(i-1)*h + j-1] += ey[j - y0] * ex[i - x0] * scaling;
+      }
+    }
+  }
+
+  return;
+}
+
+// Adds to the image the nspots windows [x y width height mean], as draw_window
+static void draw_windows(const double *spots, mwSize nspots, mwSize h, mwSize w,
+                         double *img) {
+
+  mwSize s;
+  mwSignedIndex x0, x1, y0, y1, i, j;
+  double x, y, wx, wy, val;
+
+  for (s = 0; s < nspots; s++) {
+    x = spots[s];
+    y = spots[s + nspots];
+    wx = spots[s + 2*nspots];
+    wy = spots[s + 3*nspots];
+    val = spots[s + 4*nspots];
+
+    // The rounded indexes of -width:width around the center, within the image
+    x0 = (mwSignedIndex)round(x - wx);
+    x1 = (mwSignedIndex)round(x - wx + floor(2*wx));
+    y0 = (mwSignedIndex)round(y - wy);
+    y1 = (mwSignedIndex)round(y - wy + floor(2*wy));
+    x0 = (x0 < 1) ? 1 : x0;
+    y0 = (y0 < 1) ? 1 : y0;
+    x1 = (x1 > (mwSignedIndex)w) ? w : x1;
+    y1 = (y1 > (mwSignedIndex)h) ? h : y1;
+
+    for (i = x0; i <= x1; i++) {
+      for (j = y0; j <= y1; j++) {
+        img[(i-1)*h + j-1] += val;
+      }
+    }
+  }
+
+  return;
+}
+
+// Reconstructs the images of the detected spots, see reconstruct_detection_mex.m
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+
+  mwSize h, w, nplanes, i, dims[3];
+  mwSignedIndex p;
+  double *tmp, *imgs;
+  bool is_window = false, is_cell;
+
+  // Check for proper number of input and output arguments
+  if (nrhs < 2) {
+    mexErrMsgIdAndTxt("CAST:reconstruct_detection_mex:invalidNumInputs",
+        "At least two input arguments required.");
+  }
+  if (!mxIsDouble(prhs[0]) || mxGetNumberOfElements(prhs[0]) < 2) {
+    mexErrMsgIdAndTxt("CAST:reconstruct_detection_mex:invalidInput",
+        "Input argument (1) must be the size of the images.");
+  }
+  if (nrhs > 2 && !mxIsEmpty(prhs[2])) {
+    is_window = (mxGetScalar(prhs[2]) != 0);
+  }
+
+  tmp = mxGetPr(prhs[0]);
+  h = (mwSize)tmp[0];
+  w = (mwSize)tmp[1];
+
+  // The spots of every plane, a matrix being a single plane. They are gathered here as
+  // the MATLAB API cannot be used in parallel.
+  is_cell = mxIsCell(prhs[1]);
+  nplanes = is_cell ? mxGetNumberOfElements(prhs[1]) : 1;
+
+  std::vector<const double *> planes(nplanes, NULL);
+  std::vector<mwSize> nrows(nplanes, 0), ncols(nplanes, 0);
+
+  for (i = 0; i < nplanes; i++) {
+    const mxArray *spots = is_cell ? mxGetCell(prhs[1], i) : prhs[1];
+
+    if (spots == NULL || mxIsEmpty(spots)) {
+      continue;
+    }
+    if (!mxIsDouble(spots) || mxGetN(spots) < (is_window ? 5 : 4)) {
+      mexErrMsgIdAndTxt("CAST:reconstruct_detection_mex:invalidInput",
+          "The spots must be double matrices with at least 4 columns, 5 for windows.");
+    }
+
+    planes[i] = mxGetPr(spots);
+    nrows[i] = mxGetM(spots);
+    ncols[i] = mxGetN(spots);
+  }
+
+  dims[0] = h;
+  dims[1] = w;
+  dims[2] = nplanes;
+  plhs[0] = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+  imgs = mxGetPr(plhs[0]);
+
+  // The planes are independent and can be drawn in parallel
+  #pragma omp parallel for schedule(dynamic)
+  for (p = 0; p < (mwSignedIndex)nplanes; p++) {
+    const double *params = planes[p];
+    double *valids;
+    mwSize nspots = nrows[p], nvalids = 0, s, c;
+    bool is_valid;
+
+    if (params == NULL) {
+      continue;
+    }
+
+    // Only the spots without any NaN are drawn
+    valids = (double *)malloc(nspots*ncols[p]*sizeof(double));
+    for (s = 0; s < nspots; s++) {
+      is_valid = true;
+      for (c = 0; c < ncols[p] && is_valid; c++) {
+        is_valid = !isnan(params[s + c*nspots]);
+      }
+      if (is_valid) {
+        for (c = 0; c < ncols[p]; c++) {
+          valids[nvalids + c*nspots] = params[s + c*nspots];
+        }
+        nvalids++;
+      }
+    }
+
+    // Move the columns next to each other
+    for (c = 1; c < ncols[p]; c++) {
+      for (s = 0; s < nvalids; s++) {
+        valids[s + c*nvalids] = valids[s + c*nspots];
+      }
+    }
+
+    if (is_window) {
+      draw_windows(valids, nvalids, h, w, imgs + p*h*w);
+    } else {
+      draw_gaussians(valids, nvalids, h, w, imgs + p*h*w);
+    }
+
+    free(valids);
+  }
+
+  return;
+}
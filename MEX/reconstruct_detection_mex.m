@@ -0,0 +1,13 @@
+% RECONSTRUCT_DETECTION_MEX draws the detected spots of a stack of images, adding
+% each of them only onto its local footprint rather than onto a full image, the
+% planes being drawn in parallel if compiled with OpenMP. It is used by
+% reconstruct_detection.m for its predefined shapes.
+%
+%   RIMGS = RECONSTRUCT_DETECTION_MEX(SIZE_IMG, SPOTS, IS_WINDOW) creates the double
+%   stack RIMGS of planes of size SIZE_IMG, one per cell of SPOTS (a matrix being a
+%   single plane), by summing the spots of the corresponding cell. Spots containing
+%   NaN are ignored. If IS_WINDOW is false (default), the spots are gaussians
+%   defined as [X Y SIGMA AMPLITUDE], integrated over the pixels as in GaussMask2D
+%   but truncated at 4 SIGMA, each of the truncated pixels being below exp(-8), about
+%   3.4e-4, of AMPLITUDE. Otherwise, they are windows defined as
+%   [X Y WIDTH HEIGHT MEAN], drawn as in draw_window.m.
@@ -0,0 +1,211 @@
+#include <math.h>
+#include "spatial_grid.h"
+
+// The maximal number of cells per point, to bound the memory used by sparse sets
+#define GRID_CELLS_RATIO 4
+
+// Builds a uniform grid with cells of size radius over the provided points. Points
+// with non-finite coordinates cannot be within any distance, so they are ignored.
+void build_spatial_grid(spatial_grid *grid, const double *x, const double *y, mwSize npts, double radius) {
+
+  mwSize i, ncells, nvalid;
+  mwIndex cell, *counts;
+  double xmax, ymax, width, height, max_cells;
+
+  grid->nx = 0;
+  grid->ny = 0;
+  grid->xmin = 0;
+  grid->ymin = 0;
+  grid->cell_size = 1;
+  grid->cells = NULL;
+  grid->indexes = NULL;
+
+  // Get the bounding box of the valid points
+  nvalid = 0;
+  xmax = ymax = 0;
+  for (i = 0; i < npts; i++) {
+    if (mxIsFinite(x[i]) && mxIsFinite(y[i])) {
+      if (nvalid == 0) {
+        grid->xmin = xmax = x[i];
+        grid->ymin = ymax = y[i];
+      } else {
+        grid->xmin = __MIN__(grid->xmin, x[i]);
+        grid->ymin = __MIN__(grid->ymin, y[i]);
+        xmax = __MAX__(xmax, x[i]);
+        ymax = __MAX__(ymax, y[i]);
+      }
+      nvalid++;
+    }
+  }
+
+  // Nothing to index
+  if (nvalid == 0) {
+    return;
+  }
+
+  width = xmax - grid->xmin;
+  height = ymax - grid->ymin;
+
+  // An infinite radius means that all points are neighbors, hence a single cell
+  if (!mxIsFinite(radius) || radius <= 0) {
+    grid->cell_size = __MAX__(width, height) + 1;
+  } else {
+    grid->cell_size = radius;
+  }
+
+  // Very sparse sets would produce mostly empty cells, so enlarge them
+  max_cells = (double)(GRID_CELLS_RATIO * nvalid);
+  while ((floor(width / grid->cell_size) + 1) * (floor(height / grid->cell_size) + 1) > max_cells) {
+    grid->cell_size *= 2;
+  }
+
+  grid->nx = (mwSize)floor(width / grid->cell_size) + 1;
+  grid->ny = (mwSize)floor(height / grid->cell_size) + 1;
+  ncells = grid->nx * grid->ny;
+
+  grid->cells = (mwIndex *)mxCalloc(ncells + 1, sizeof(mwIndex));
+  grid->indexes = (mwIndex *)mxCalloc(nvalid, sizeof(mwIndex));
+  counts = (mwIndex *)mxCalloc(ncells, sizeof(mwIndex));
+
+  // A counting sort of the points into the cells, first the size of each cell
+  for (i = 0; i < npts; i++) {
+    if (mxIsFinite(x[i]) && mxIsFinite(y[i])) {
+      cell = (mwIndex)floor((x[i] - grid->xmin) / grid->cell_size) * grid->ny +
+             (mwIndex)floor((y[i] - grid->ymin) / grid->cell_size);
+      grid->cells[cell + 1]++;
+    }
+  }
+  for (i = 0; i < ncells; i++) {
+    grid->cells[i + 1] += grid->cells[i];
+  }
+
+  // Then their content, which keeps the indexes sorted within each cell
+  for (i = 0; i < npts; i++) {
+    if (mxIsFinite(x[i]) && mxIsFinite(y[i])) {
+      cell = (mwIndex)floor((x[i] - grid->xmin) / grid->cell_size) * grid->ny +
+             (mwIndex)floor((y[i] - grid->ymin) / grid->cell_size);
+      grid->indexes[grid->cells[cell] + counts[cell]] = i;
+      counts[cell]++;
+    }
+  }
+
+  mxFree(counts);
+
+  return;
+}
+
+// Computes the range of cells [x0 x1 y0 y1] that overlap with the disc of radius
+// centered on (x,y). Returns false if there is no such cell. As it is called
+// from within parallel loops, it does not rely on the MATLAB API.
+bool get_grid_range(const spatial_grid *grid, double x, double y, double radius, mwIndex *range) {
+
+  double xmin, xmax, ymin, ymax;
+
+  if (grid->nx == 0 || isnan(x) || isnan(y) || isnan(radius)) {
+    return false;
+  }
+
+  // Everything is within range
+  if (!isfinite(radius)) {
+    range[0] = 0;
+    range[1] = grid->nx - 1;
+    range[2] = 0;
+    range[3] = grid->ny - 1;
+
+    return true;
+  }
+
+  // The bounding box of the disc in cell coordinates
+  xmin = floor((x - radius - grid->xmin) / grid->cell_size);
+  xmax = floor((x + radius - grid->xmin) / grid->cell_size);
+  ymin = floor((y - radius - grid->ymin) / grid->cell_size);
+  ymax = floor((y + radius - grid->ymin) / grid->cell_size);
+
+  // Outside of the grid
+  if (xmax < 0 || ymax < 0 || xmin >= grid->nx || ymin >= grid->ny) {
+    return false;
+  }
+
+  range[0] = (mwIndex)__MAX__(xmin, 0);
+  range[1] = (mwIndex)__MIN__(xmax, grid->nx - 1);
+  range[2] = (mwIndex)__MAX__(ymin, 0);
+  range[3] = (mwIndex)__MIN__(ymax, grid->ny - 1);
+
+  return true;
+}
+
+// Frees the memory allocated by build_spatial_grid
+void free_spatial_grid(spatial_grid *grid) {
+
+  if (grid->cells != NULL) {
+    mxFree(grid->cells);
+  }
+  if (grid->indexes != NULL) {
+    mxFree(grid->indexes);
+  }
+
+  grid->cells = NULL;
+  grid->indexes = NULL;
+  grid->nx = 0;
+  grid->ny = 0;
+
+  return;
+}
+
+// Moves down the element at root in the heap of size end, used by sort_column
+static void sift_down(mwIndex *irs, double *rs, mwSize root, mwSize end) {
+
+  mwSize child;
+  mwIndex tmp_indx;
+  double tmp_val;
+
+  for (child = 2*root + 1; child < end; root = child, child = 2*root + 1) {
+    if (child + 1 < end && irs[child] < irs[child+1]) {
+      child++;
+    }
+    if (irs[root] >= irs[child]) {
+      break;
+    }
+    tmp_indx = irs[root]; irs[root] = irs[child]; irs[child] = tmp_indx;
+    tmp_val = rs[root]; rs[root] = rs[child]; rs[child] = tmp_val;
+  }
+
+  return;
+}
+
+// Sorts the row indexes of one column of a sparse matrix, along with its values,
+// as neighbors are retrieved cell by cell. Short columns are the usual case, so
+// insertion sort is used for them and heapsort for the others.
+void sort_column(mwIndex *irs, double *rs, mwSize nelems) {
+
+  mwSize i, j;
+  mwIndex tmp_indx;
+  double tmp_val;
+
+  if (nelems < 16) {
+    for (i = 1; i < nelems; i++) {
+      tmp_indx = irs[i];
+      tmp_val = rs[i];
+      for (j = i; j > 0 && irs[j-1] > tmp_indx; j--) {
+        irs[j] = irs[j-1];
+        rs[j] = rs[j-1];
+      }
+      irs[j] = tmp_indx;
+      rs[j] = tmp_val;
+    }
+
+    return;
+  }
+
+  // Build the heap, and then pop its largest element at the end of the array
+  for (i = nelems / 2; i > 0; i--) {
+    sift_down(irs, rs, i - 1, nelems);
+  }
+  for (i = nelems - 1; i > 0; i--) {
+    tmp_indx = irs[i]; irs[i] = irs[0]; irs[0] = tmp_indx;
+    tmp_val = rs[i]; rs[i] = rs[0]; rs[0] = tmp_val;
+    sift_down(irs, rs, 0, i);
+  }
+
+  return;
+}
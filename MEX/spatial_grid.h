@@ -0,0 +1,35 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include "mex.h"
+
+#ifndef __MAX__
+#define __MAX__(A, B)     ((A)>=(B)? (A) : (B))
+#endif
+#ifndef __MIN__
+#define __MIN__(A, B)     ((A)<=(B)? (A) : (B))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A uniform grid over a set of 2D points, stored as a list of point indexes
+// sorted by cell (CSR-like) so that only the neighbors of a query are visited
+typedef struct {
+  mwSize nx, ny;
+  double xmin, ymin, cell_size;
+  mwIndex *cells;
+  mwIndex *indexes;
+} spatial_grid;
+
+void build_spatial_grid(spatial_grid *grid, const double *x, const double *y, mwSize npts, double radius);
+bool get_grid_range(const spatial_grid *grid, double x, double y, double radius, mwIndex *range);
+void free_spatial_grid(spatial_grid *grid);
+void sort_column(mwIndex *irs, double *rs, mwSize nelems);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,232 @@
+function new_links = close_track_gaps(ends, starts, interm, funcs, tracking_options, max_move, max_gap, branching_gap, max_dist, max_ratio, avg_movement, spots, links, hwait, can_merge)
+% CLOSE_TRACK_GAPS solves the gap closing, merging and splitting problem of [1].
+%
+%   NEW_LINKS = CLOSE_TRACK_GAPS(ENDS, STARTS, INTERM, FUNCS, TRACKING_OPTIONS, ...
+%   MAX_MOVE, MAX_GAP, BRANCHING_GAP, MAX_DIST, MAX_RATIO, AVG_MOVEMENT, SPOTS, LINKS)
+%   assigns the track ENDS to the track STARTS (bridging) or to the INTERMediate
+%   spots (merging), and the INTERMediate spots to the STARTS (splitting). Each list
+%   contains one spot per row, followed by its index and its frame, as built by
+%   track_spots. FUNCS contains the bridging, joining and splitting cost functions,
+%   enabled by the three TRACKING_OPTIONS flags. The remaining parameters are the
+%   ones of track_spots, MAX_GAP and BRANCHING_GAP counting the frames linked by a
+%   gap, AVG_MOVEMENT being the average frame-to-frame linking cost. SPOTS and LINKS
+%   are the frame-to-frame tracking as provided to the cost functions.
+%
+%   NEW_LINKS contains one link per row, ordered as the rows of [ENDS; INTERM]:
+%     [target_frame_index, target_spot_index, reference_spot_index, reference_frame_index]
+%
+%   NEW_LINKS = CLOSE_TRACK_GAPS(..., HWAIT) updates in addition the progress bar HWAIT.
+%
+%   NEW_LINKS = CLOSE_TRACK_GAPS(..., HWAIT, CAN_MERGE) prevents merging into the
+%   INTERMediate spots for which CAN_MERGE is false.
+%
+% References:
+%   [1] Jaqaman K, Loerke D, Mettlen M, Kuwata H, Grinstein S, et al. Robust
+%       single-particle tracking in live-cell time-lapse sequences. Nat Methods 5:
+%       695-702 (2008).
+
+  % Input checking
+  if (nargin < 14)
+    hwait = [];
+  end
+  if (nargin < 15)
+    can_merge = [];
+  end
+
+  % Progress bar
+  do_display = ~isempty(hwait);
+
+  % Use the native solvers if they have been compiled
+  if (exist('lapjv_sparse_mex') == 3)
+    lap_solver = @lapjv_sparse_mex;
+  else
+    lap_solver = @lapjv_fast_sparse;
+  end
+  use_alternative_lap = (exist('lap_alternative_sparse_mex') == 3);
+  use_matrix_mex = (exist('gap_closing_matrix_mex') == 3);
+
+  % Get the corresponding cost functions
+  closing_weight = funcs{1};
+  joining_weight = funcs{2};
+  splitting_weight = funcs{3};
+
+  % Get the final number of spots
+  nstarts = size(starts, 1);
+  nends = size(ends, 1);
+  ninterm = size(interm, 1);
+
+  % Compute the bridging costs
+  if (tracking_options(1))
+    mutual_dist = closing_weight(ends, starts, max_move, max_gap, max_dist, max_ratio);
+  else
+    mutual_dist = sparse(nends, nstarts);
+  end
+
+  if (do_display)
+    waitbar(1/6,hwait);
+  end
+
+  % The merging costs, we also need an alternative costs vector [1]
+  if (tracking_options(2))
+    [merge_weight, alt_merge_weight] = joining_weight(ends, interm, max_move, branching_gap, max_ratio, avg_movement, spots, links);
+
+    % Some spots might have already received a merging track
+    if (~isempty(can_merge))
+      merge_weight(:, ~can_merge) = 0;
+    end
+  else
+    merge_weight = sparse(nends, ninterm);
+    alt_merge_weight = ones(ninterm, 1);
+  end
+
+  if (do_display)
+    waitbar(2/6,hwait);
+  end
+
+  % And the splitting costs, including the alternative costs vector
+  if (tracking_options(3))
+    [split_weight, alt_split_weight] = splitting_weight(starts, interm, max_move, branching_gap, max_ratio, avg_movement, spots, links);
+  else
+    split_weight = sparse(nstarts, ninterm);
+    alt_split_weight = ones(ninterm, 1);
+  end
+
+  if (do_display)
+    waitbar(3/6,hwait);
+  end
+
+  % Now build the full matrix [1]
+  % Note that end-end merging and start-start splitting is not allowed by this
+  % algorithm, which makes sense...
+
+  % The matrix can be assembled directly in sparse form, including the costs for no
+  % linking. Only its upper left part is needed when the alternative costs are
+  % handled implicitly by the solver.
+  if (use_matrix_mex)
+    [dist, alt_cost] = gap_closing_matrix_mex(mutual_dist, merge_weight, split_weight, ...
+                                   alt_merge_weight, alt_split_weight, ~use_alternative_lap);
+  else
+
+    % Get the individual indexes and values from the different sparse matrices, and
+    % concatenate them into one single list.
+
+    % Bridging is the top left matrix
+    [indxi, indxj, vals] = get_sparse_data_mex(mutual_dist);
+    all_indxi = indxi;
+    all_indxj = indxj;
+    all_vals = vals;
+
+    % Merging is shifted on the right, after the bridging one
+    [indxi, indxj, vals] = get_sparse_data_mex(merge_weight);
+    all_indxi = [all_indxi; indxi];
+    all_indxj = [all_indxj; indxj+nstarts];
+    all_vals = [all_vals; vals];
+
+    % While splitting it under the bridging one
+    [indxi, indxj, vals] = get_sparse_data_mex(split_weight);
+    all_indxi = [all_indxi; indxj+nends];
+    all_indxj = [all_indxj; indxi];
+    all_vals = [all_vals; vals];
+
+    if (do_display)
+      waitbar(4/6,hwait);
+    end
+
+    % We need to extract the cost for no linking
+    if (isempty(all_vals))
+      alt_cost = 1;
+      min_dist = 0.1;
+    else
+      alt_cost = prctile(all_vals, 90) * 0.999;
+      min_dist = min(all_vals);
+    end
+
+    % Build a generic vector for these parts of the matrix
+    alt_indx = [1:max(max(nends,nstarts),ninterm)].';
+    alt_dist = ones(size(alt_indx))*alt_cost;
+
+    % Here we only need the upper left part of the matrix of [1]
+    if (use_alternative_lap)
+      dist = [mutual_dist merge_weight; split_weight.' sparse(ninterm, ninterm)];
+    else
+
+      % Now build the full array of indexes
+      all_indxii = [all_indxi; ...                                 % Bridging/Merging/Splitting
+                    alt_indx(1:nends); ...                         % No gap, "d" in [1]
+                    alt_indx(1:nstarts)+nends+ninterm; ...         % No gap, "b" in [1]
+                    alt_indx(1:ninterm)+nends; ...                 % No splitting, "d'" in [1]
+                    alt_indx(1:ninterm)+nends+nstarts+ninterm; ... % No merging, "b'" [1]
+                    all_indxj+nends+ninterm];                      % The lower right block, for symmetry
+
+      % Same for the second coordinate
+      all_indxj = [all_indxj; ...
+                   alt_indx(1:nends)+nstarts+ninterm; ...
+                   alt_indx(1:nstarts); ...
+                   alt_indx(1:ninterm)+nstarts+ninterm+nends; ...
+                   alt_indx(1:ninterm)+nstarts; ...
+                   all_indxi+nstarts+ninterm];
+
+      % And the corresponding values
+      all_vals = [all_vals; ...
+                  alt_dist(1:nends); ...
+                  alt_dist(1:nstarts); ...
+                  alt_split_weight; ...
+                  alt_merge_weight; ...
+                  ones(size(all_vals))*min_dist];
+
+      % Finally, build the whole sparse matrix
+      dist = sparse(all_indxii, all_indxj, all_vals, nstarts + nends + 2*ninterm, ...
+                    nstarts + nends + 2*ninterm, length(all_vals));
+    end
+  end
+
+  if (do_display)
+    waitbar(5/6,hwait);
+  end
+
+  % And solve it !
+  if (use_alternative_lap)
+    alt_dist = ones(max(nends, nstarts), 1)*alt_cost;
+    [assign, cost] = lap_alternative_sparse_mex(dist, ...
+                              [alt_dist(1:nends); alt_split_weight], ...  % "d" and "d'" in [1]
+                              [alt_dist(1:nstarts); alt_merge_weight]);   % "b" and "b'" in [1]
+  else
+    [assign, cost] = lap_solver(dist);
+  end
+
+  % The list of new links
+  new_links = NaN(0, 4);
+
+  % Identify the type of assignment chosen
+  for i=1:nends+ninterm
+
+    % No link
+    if (assign(i) < 1)
+      continue;
+
+    % Bridging/Splitting
+    elseif (assign(i) <= nstarts)
+      target = starts(assign(i), :);
+
+    % Merging
+    elseif (assign(i) <= nstarts + ninterm)
+      target = interm(assign(i) - nstarts, :);
+    else
+      continue;
+    end
+
+    % Bridging
+    if (i <= nends)
+      reference = ends(i,:);
+
+    % Splitting
+    else
+      reference = interm(i-nends,:);
+    end
+
+    % Store the new link
+    new_links(end+1, :) = [target(end), target(end-1), reference(end-1:end)];
+  end
+
+  return;
+end
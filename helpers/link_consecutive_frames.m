@@ -0,0 +1,108 @@
+function [links, dists] = link_consecutive_frames(prev_pts, pts, frame_indx, linking_weight, max_move, max_ratio, lap_solver, use_alternative_lap)
+% LINK_CONSECUTIVE_FRAMES links the spots of two consecutive frames as in [1].
+%
+%   [LINKS, DISTS] = LINK_CONSECUTIVE_FRAMES(PREV_PTS, PTS, FRAME_INDX, LINKING_WEIGHT,
+%   MAX_MOVE, MAX_RATIO, LAP_SOLVER, USE_ALTERNATIVE_LAP) assigns the spots PREV_PTS
+%   of frame FRAME_INDX-1 to the spots PTS of frame FRAME_INDX using the cost function
+%   LINKING_WEIGHT and the thresholds MAX_MOVE and MAX_RATIO (see track_spots.m). The
+%   assignment is solved either by LAP_ALTERNATIVE_SPARSE_MEX if USE_ALTERNATIVE_LAP
+%   is true, or by LAP_SOLVER on the doubled matrix of [1].
+%
+%   LINKS contains one link per row, sorted by PTS index, as follow:
+%     [end_spot_index, start_spot_index, start_spot_frame_index]
+%   DISTS contains the costs of these links, sorted by PREV_PTS index.
+%
+% References:
+%   [1] Jaqaman K, Loerke D, Mettlen M, Kuwata H, Grinstein S, et al. Robust
+%       single-particle tracking in live-cell time-lapse sequences. Nat Methods 5:
+%       695-702 (2008).
+
+  % Still return something to avoid errors later when accessing columns
+  links = NaN(0, 3);
+  dists = zeros(0, 1);
+
+  % Get the sizes
+  prev_npts = size(prev_pts, 1);
+  npts = size(pts, 1);
+
+  % If one of the two is empty, no linking will happen
+  if (prev_npts == 0 || npts == 0)
+    return;
+  end
+
+  % Add two empty columns at the end of the arrays to simulate the indexes used later
+  prev_pts = [prev_pts zeros(prev_npts, 2)];
+  pts = [pts zeros(npts, 2)];
+
+  % Get the spot-to-spot cost matrix for linking them
+  mutual_dist = linking_weight(prev_pts, pts, max_move, max_ratio);
+
+  % Get the data from the resulting sparse matrix
+  [indxi, indxj, vals] = get_sparse_data_mex(mutual_dist);
+
+  % Use some default values if no linkin is possible
+  if (isempty(vals))
+    curr_max = 1;
+    min_dist = 1;
+  else
+    curr_max = max(vals);
+    min_dist = min(vals);
+  end
+
+  % Here the alternative costs are handled implicitly by the solver
+  if (use_alternative_lap)
+    dist = mutual_dist;
+    [assign, cost] = lap_alternative_sparse_mex(dist, ones(prev_npts, 1)*curr_max, ...
+                                                ones(npts, 1)*curr_max);
+  else
+
+    % Build the data requried for the no-linking parts of the matrix [1]
+    ends_indx = [1:max(npts,prev_npts)].';
+    ends = ones(size(ends_indx))*curr_max;
+
+    % No build the full indexes for the final sparse matrix
+    indxii = [indxi; ...                         % Linking
+              ends_indx(1:prev_npts); ...        % End of a track
+              ends_indx(1:npts)+prev_npts; ...   % Start of a track
+              indxj+prev_npts];                  % Requried for symmetry
+
+    % Same for the other matrix indexes
+    indxj = [indxj; ends_indx(1:prev_npts)+npts; ends_indx(1:npts); indxi+npts];
+
+    % And the corresponding values
+    vals = [vals; ends(1:prev_npts); ends(1:npts); ones(size(vals))*min_dist];
+
+    % Now build the full sparse matrix using only the requried number of values
+    dist = sparse(indxii, indxj, vals, npts + prev_npts, npts + prev_npts, ...
+                  length(vals));
+
+    % And solve this using this alternative implementation of the Hungarian algorithm
+    [assign, cost] = lap_solver(dist);
+
+    % Keep only the relevant part of the assignments (others are required for symmetry)
+    assign = assign(1:prev_npts);
+  end
+
+  % And keep only the ones representing a link
+  indxs = 1:length(assign);
+  good_indx = (assign > 0 & assign <= npts);
+  assign = assign(good_indx);
+  indxs = indxs(good_indx);
+
+  % Extract the corresponding costs for later use
+  assign_dist = dist(sub2ind(size(dist),indxs,assign));
+  dists = full(assign_dist(:));
+
+  % Invert the assignment indexes as we store next -> prev links
+  [assign, perms] = sort(assign(:));
+
+  % And store everything
+  links = [assign indxs(perms).' (frame_indx-ones(length(assign), 1))];
+
+  % Still store something to avoid errors later when accessing columns
+  if (isempty(links))
+    links = NaN(0, 3);
+  end
+
+  return;
+end
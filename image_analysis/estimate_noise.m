@@ -84,6 +84,9 @@ function [gammas] = estimate_noise(img, filter_type, block_size, mfilter, precis
     return;
   end
 
+  % The estimation requires floating point values, converted one plane at a time
+  img = double(img);
+
   % Checking if we have a custom filter or not
   if (~ischar(filter_type))
     filter = filter_type;
@@ -100,21 +103,25 @@ function [gammas] = estimate_noise(img, filter_type, block_size, mfilter, precis
   % The number of elements to avoid incomplete blocks on the border of the image
   nelems = block_size^2;
 
+  % Check whether the MEX implementation is available
+  use_mex = (exist('estimate_noise_mex') == 3);
+
   % Switch filter types
+  edge_map = [];
   switch filter_type
 
     % The default value, fitler using imadm and runs the block processing
     case 'adm'
       nelems = 2*nelems;
       edge_map = imadm(img, 0, false);
-      blocks = blockproc(cat(3,img,edge_map), [block_size block_size], @analyze_filt);
+      filter = [];
 
     % Similar but using a custom filter
     case 'custom'
       nelems = 2*nelems;
       % We take the absolute value, just in case
       edge_map = abs(imfilter(img, filter, 'symmetric'));
-      blocks = blockproc(cat(3,img,edge_map), [block_size block_size], @analyze_filt);
+      filter = [];
 
     % The published alternative, it creates a large filter to apply on each
     % block to get a faster estimate of the edge, and thus of the uniformity
@@ -148,16 +155,41 @@ function [gammas] = estimate_noise(img, filter_type, block_size, mfilter, precis
       filter = [hfilter(:) vfilter(:) pdfilter(:) ndfilter(:) ldfilter(:) lufilter(:) rdfilter(:) rufilter(:)];
       % And adjust their weights
       filter((middle-1)*block_size + middle, :) = (block_size - 1);
-
-      % The runs the block processing, with a slightly different function for speedup
-      blocks = blockproc(img, [block_size block_size], @analyze_block);
   end
 
   % We use the median filter to infer the noiseless image
   noisefree = median_mex(img, mfilter);
 
-  % Extract the noise only
-  noisy = img - noisefree;
+  % Build the histogram edges
+  edges = ([0:nbins].')*range(noisefree(:))/nbins + min(noisefree(:));
+  edges(1) = edges(1) - 1e-6;
+  edges(end) = edges(end) + 1e-6;
+
+  % The MEX function computes the statistics of the blocks and of the histogram in
+  % a single pass over the image
+  if (use_mex)
+    [blocks, counts, sums, sums2] = estimate_noise_mex(img, noisefree, edge_map, ...
+                                                        filter, block_size, edges);
+  else
+
+    % Runs the block processing, with a slightly different function for speedup when
+    % using the published filters
+    if (isempty(edge_map))
+      blocks = blockproc(img, [block_size block_size], @analyze_block);
+    else
+      blocks = blockproc(cat(3,img,edge_map), [block_size block_size], @analyze_filt);
+    end
+
+    % Now classify the pixel noiseless intensities, keep the map for identifying the
+    % corresponding noises
+    [counts, map] = histc(noisefree(:), edges);
+
+    % Extract the noise only, and accumulate it in each bin
+    noisy = img(:) - noisefree(:);
+    valids = (map > 0);
+    sums = accumarray(map(valids), noisy(valids), size(counts));
+    sums2 = accumarray(map(valids), noisy(valids).^2, size(counts));
+  end
 
   % Reshape the output for simplicity
   blocks = reshape(blocks, [], 3);
@@ -178,31 +210,13 @@ function [gammas] = estimate_noise(img, filter_type, block_size, mfilter, precis
   gauss_noise = mean(blocks(1:nblocks, 2:3));
 
   % Now basically, we want to perform a linear regression on the amount of noise
-  % in each pixel, based on its noiseless intensity (see [1])
-  noisefree = noisefree(:);
-  noisy = noisy(:);
-
-  % Build the histogram edges
-  edges = ([0:nbins].')*range(noisefree)/nbins + min(noisefree);
-  edges(1) = edges(1) - 1e-6;
-  edges(end) = edges(end) + 1e-6;
-
-  % Now classify the pixel noiseless intensities, keep the map for identifying the
-  % corresponding noises
-  [counts, map] = histc(noisefree, edges);
-
-  % Initialize the variables for the variance estimation
+  % in each pixel, based on its noiseless intensity (see [1]). We thus estimate the
+  % variance of the noise in the bins of the histogram that contain enough data as
+  % defined by [3], between all pixels which have the similar intensity
   nbins = length(counts);
   vars = NaN(nbins, 1);
-
-  % We now loop over the histogram, keeping only the bins that contain enough data
-  % as defined by [3]. For those, we estimate the standard deviation between all
-  % pixels which have the similar intensity
-  for i=1:nbins
-    if (counts(i) > minsize)
-      vars(i) = std(noisy(map==i))^2;
-    end
-  end
+  valids = (counts > minsize);
+  vars(valids) = (sums2(valids) - sums(valids).^2 ./ counts(valids)) ./ (counts(valids) - 1);
 
   % We keep only the variance we actually estimates, and we get rid of very high
   % intensities as they are usually biased
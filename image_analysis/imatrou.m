@@ -48,6 +48,15 @@ function [projection, atrous] = imatrou(img, size_max, coef)
   % Compute the number of planes that we'll create
   nplanes = floor(log2(size_max - 1) - 1);
 
+  % The MEX implementation only keeps the working planes in memory, and hence
+  % cannot provide the decomposition
+  if (nargout < 2 && nplanes > 0 && exist('imatrou_mex') == 3)
+    projection = imatrou_mex(img, nplanes, coef);
+    atrous = [];
+
+    return;
+  end
+
   % Initialize the decomposition
   atrous = ones(h,w,nplanes+1);
 
@@ -61,6 +61,18 @@ function [new_img] = imcosmics(img, block_size, thresh)
     img = double(img);
   end
 
+  % The MEX implementation filters the tiles in parallel and only filters again
+  % the ones that changed during the previous iteration
+  if (exist('imcosmics_mex') == 3)
+    new_img = imcosmics_mex(img, block_size, thresh);
+
+    if (~is_double)
+      new_img = cast(new_img, class_type);
+    end
+
+    return;
+  end
+
   % In case of a single plane, [1] advises to process iteratively the filtering
   % up to 5 times, even though convergeance is usually reached in 2-3 calls.
   for i = 1:5
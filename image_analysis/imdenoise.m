@@ -2,19 +2,21 @@ function [img, noise] = imdenoise(img, varargin)
 % IMDENOISE removes noise in a given image using different filtering functions.
 %
 %   IMG = IMDENOISE(IMG) denoises IMG using a median filter of size 3x3. IMG can be
-%   a stack of images, which will then be filtered separately.
+%   a stack of images, which will then be filtered separately. The planes are provided
+%   to the filtering function in the class of IMG, which is preserved.
 %
 %   IMG = IMDENOISE(..., NOISE) provides in addition the NOISE of the IMG as computed
 %   by estimate_noise.m
 %
 %   IMG = IMDENOISE(..., RM_BKG) if RM_BKG, removes in addition the background signal
-%   as estimated (see estimate_noise.m). Default is RM_BKG=false.
+%   as estimated (see estimate_noise.m). Default is RM_BKG=false. The planes are then
+%   filtered in double precision, and only rounded once their background is removed.
 %
 %   IMG = IMDENOISE(..., FUNC, ARGS) denoises IMG using the function handler FUNC and
 %   the corresponding arguments ARGS. Note that no check is performed on ARGS. Note
 %   also that for FUNC=@gaussian_mex without ARGS, a default sigma of 0.6 is used [1];
-%   for FUNC=@nl_means, an additional arguments corresponding to the estimated level
-%   of white noise (i.e. T, see nl_means.m) is passed to FUNC.
+%   for FUNC=@nl_means and FUNC=@fast_nl_means_mex, an additional arguments corresponding
+%   to the estimated level of white noise (i.e. T, see nl_means.m) is passed to FUNC.
 %
 %   [IMG, NOISE] = IMDENOISE(...) returns in addition the estimated amount of noise
 %   present in the image (see estimate_noise.m).
@@ -61,10 +63,6 @@ function [img, noise] = imdenoise(img, varargin)
   args = args(~cellfun('isempty', args));
   args = args(cellfun(@(x)(isfinite(x) && x>=0), args));
 
-  % Get the image type and convert to double
-  img_class = class(img);
-  img = double(img);
-
   % Estimate the noise level in the current image
   if (isempty(noise))
     noise = estimate_noise(img);
@@ -73,22 +71,30 @@ function [img, noise] = imdenoise(img, varargin)
   % Loop over the stack size
   for i = 1:size(img,3)
 
+    % The arguments for the current plane
+    curr_args = args;
+
     % Few educated guesses
     switch func2str(func)
 
       % Here we follow [1] in case no sigma is provided
       case 'gaussian_mex'
         if (length(args)==0)
-          args = {0.6};
+          curr_args = {0.6};
         end
 
       % Here we match the sigma of filtering with the sigma of noise (see nl_means.m)
-      case 'nl_means'
-        args = [{noise(i,2)}, args];
+      case {'nl_means', 'fast_nl_means_mex'}
+        curr_args = [{noise(i,2)}, args];
     end
 
-    % Filter the image
-    tmp_img = func(img(:,:,i), args{:});
+    % Filter the image, the MEX filters accepting directly any type of image. The
+    % background is however removed before rounding the filtered values
+    if (rm_bkg)
+      tmp_img = func(double(img(:,:,i)), curr_args{:});
+    else
+      tmp_img = func(img(:,:,i), curr_args{:});
+    end
 
     % Remove the background if asked
     if (rm_bkg)
@@ -99,12 +105,9 @@ function [img, noise] = imdenoise(img, varargin)
       noise(i,1) = 0;
     end
 
-    % Store the filtered image
+    % Store the filtered image, which converts it back to the type of the image
     img(:,:,i) = tmp_img;
   end
 
-  % Set the type of the image back to its original one
-  img = cast(img, img_class);
-
   return;
 end
@@ -45,28 +45,43 @@ function img = imhotpixels(orig_img, varargin)
   % If anything has to be done
   if (any(bad_pixels(:)))
 
-    % Apply the required strategy to compute the new value of the hot pixels
-    switch (method)
+    % The filter of the fspecial strategies
+    is_median = strcmp(method, 'median');
+    if (~is_median && ~strcmp(method, 'custom'))
+      if (isempty(params))
+        filter = fspecial(method);
+      else
+        filter = fspecial(method, params{:});
+      end
+    end
+
+    % The hot pixels
+    indx = find(bad_pixels);
+
+    % Filtering only the hot pixels is faster as long as they are not too many
+    if (exist('filter_pixels_mex') == 3 && ndims(orig_img) == 2 && ...
+        numel(indx) < 0.1*numel(orig_img) && ...
+        any(strcmp(class(orig_img), {'uint8', 'uint16', 'single', 'double'})))
+
+      if (is_median)
+        img(indx) = filter_pixels_mex(orig_img, indx);
+      else
+        img(indx) = filter_pixels_mex(orig_img, indx, [], double(filter));
+      end
 
-      % Plain median filtering
-      case 'median'
-        filt_img = median_mex(double(orig_img));
+    % Otherwise, filter the whole image
+    else
 
-      % Using the provided custom filter
-      case 'custom'
+      % Apply the required strategy to compute the new value of the hot pixels
+      if (is_median)
+        filt_img = median_mex(orig_img);
+      else
         filt_img = imfilter(double(orig_img), filter, 'symmetric');
+      end
 
-      % Using the specified fspecial filter
-      otherwise
-        if (isempty(params))
-          filt_img = imfilter(double(orig_img), fspecial(method), 'symmetric');
-        else
-          filt_img = imfilter(double(orig_img), fspecial(method, params{:}), 'symmetric');
-        end
+      % Replace the hot pixels
+      img(indx) = filt_img(indx);
     end
-
-    % Replace the hot pixels
-    img(bad_pixels) = filt_img(bad_pixels);
   end
 
   return;
@@ -88,118 +88,62 @@ function install_CAST
     mexopts = '';
   end
 
+  % Flags to compile the parallel MEX files using OpenMP, if the compiler supports it
+  if (ispc)
+    ompopts = ' COMPFLAGS="$COMPFLAGS /openmp"';
+  else
+    ompopts = ' CFLAGS="$CFLAGS -fopenmp" CXXFLAGS="$CXXFLAGS -fopenmp" LDFLAGS="$LDFLAGS -fopenmp"';
+  end
+
+  % The list of MEX files to compile
+  mex_files = {'median_mex.cpp', ...
+               'gaussian_mex.cpp', ...
+               'nl_means_mex.cpp', ...
+               'bilinear_mex.cpp', ...
+               'get_sparse_data_mex.c', ...
+               'linking_cost_sparse_mex.c', ...
+               'bridging_cost_sparse_mex.c', ...
+               'joining_cost_sparse_mex.c', ...
+               'splitting_cost_sparse_mex.c', ...
+               'lapjv_sparse_mex.cpp', ...
+               'lap_alternative_sparse_mex.cpp', ...
+               'link_frames_mex.cpp', ...
+               'gap_closing_matrix_mex.c', ...
+               'imatrou_mex.cpp', ...
+               'detect_maxima_mex.cpp', ...
+               'estimate_spots_mex.cpp', ...
+               'estimate_noise_mex.cpp', ...
+               'imcosmics_mex.cpp', ...
+               'filter_pixels_mex.cpp', ...
+               'fast_nl_means_mex.cpp', ...
+               'embed_patches_mex.cpp', ...
+               'reconstruct_detection_mex.cpp', ...
+               'overlap_groups_mex.cpp'};
+
   % Ask for the configuration only once
   did_setup = false;
   cd('MEX')
 
   % Try to compile the necessary MEX files
-  if (exist('median_mex') ~= 3)
-    try
-      if (~did_setup)
-        mex -setup;
-      end
-      eval(['mex' mexopts ' median_mex.c']);
-      did_setup = true;
-    catch ME
-      cd(root_dir);
-      error('CAST:install_CAST', ['Could not compile the required MEX function!\n' ME.message]);
-    end
-  end
-  if (exist('gaussian_mex') ~= 3)
-    try
-      if (~did_setup)
-        mex -setup;
-      end
-      eval(['mex' mexopts ' gaussian_mex.c']);
-      did_setup = true;
-    catch ME
-      cd(root_dir);
-      error('CAST:install_CAST', ['Could not compile the required MEX function!\n' ME.message]);
-    end
-  end
-  if (exist('nl_means_mex') ~= 3)
-    try
-      if (~did_setup)
-        mex -setup;
-      end
-      eval(['mex' mexopts ' nl_means_mex.cpp']);
-      did_setup = true;
-    catch ME
-      cd(root_dir);
-      error('CAST:install_CAST', ['Could not compile the required MEX function!\n' ME.message]);
-    end
-  end
-  if (exist('bilinear_mex') ~= 3)
-    try
-      if (~did_setup)
-        mex -setup;
-      end
-      eval(['mex' mexopts ' bilinear_mex.c']);
-      did_setup = true;
-    catch ME
-      cd(root_dir);
-      error('CAST:install_CAST', ['Could not compile the required MEX function!\n' ME.message]);
-    end
-  end
-  if (exist('get_sparse_data_mex') ~= 3)
-    try
-      if (~did_setup)
-        mex -setup;
-      end
-      eval(['mex' mexopts ' get_sparse_data_mex.c']);
-      did_setup = true;
-    catch ME
-      cd(root_dir);
-      cd ..;
-      error('CAST:install_CAST', ['Could not compile the required MEX function!\n' ME.message]);
-    end
-  end
-  if (exist('linking_cost_sparse_mex') ~= 3)
-    try
-      if (~did_setup)
-        mex -setup;
-      end
-      eval(['mex' mexopts ' linking_cost_sparse_mex.c']);
-      did_setup = true;
-    catch ME
-      cd(root_dir);
-      error('CAST:install_CAST', ['Could not compile the required MEX function!\n' ME.message]);
-    end
-  end
-  if (exist('bridging_cost_sparse_mex') ~= 3)
-    try
-      if (~did_setup)
-        mex -setup;
-      end
-      eval(['mex' mexopts ' bridging_cost_sparse_mex.c']);
-      did_setup = true;
-    catch ME
-      cd(root_dir);
-      error('CAST:install_CAST', ['Could not compile the required MEX function!\n' ME.message]);
-    end
-  end
-  if (exist('joining_cost_sparse_mex') ~= 3)
-    try
-      if (~did_setup)
-        mex -setup;
-      end
-      eval(['mex' mexopts ' joining_cost_sparse_mex.c']);
-      did_setup = true;
-    catch ME
-      cd(root_dir);
-      error('CAST:install_CAST', ['Could not compile the required MEX function!\n' ME.message]);
-    end
-  end
-  if (exist('splitting_cost_sparse_mex') ~= 3)
-    try
-      if (~did_setup)
-        mex -setup;
+  for i = 1:length(mex_files)
+    [junk, mex_name, junk] = fileparts(mex_files{i});
+    if (exist(mex_name) ~= 3)
+      try
+        if (~did_setup)
+          mex -setup;
+        end
+
+        % Without OpenMP, the parallel loops are simply run serially
+        try
+          eval(['mex' mexopts ompopts ' ' mex_files{i}]);
+        catch
+          eval(['mex' mexopts ' ' mex_files{i}]);
+        end
+        did_setup = true;
+      catch ME
+        cd(root_dir);
+        error('CAST:install_CAST', ['Could not compile the required MEX function!\n' ME.message]);
       end
-      eval(['mex' mexopts ' splitting_cost_sparse_mex.c']);
-      did_setup = true;
-    catch ME
-      cd(root_dir);
-      error('CAST:install_CAST', ['Could not compile the required MEX function!\n' ME.message]);
     end
   end
   cd(root_dir);
@@ -64,14 +64,15 @@ function [M1] = nl_means(M, T, k, max_dist, do_median, ndims)
   % Prepare the output
   M1=M;
 
-  % Loop over all the planes
+  % Loop over all the planes, converting only one at a time
   for i = 1:s
+    Mi = double(M(:,:,i));
 
     % Lift to high dimensional patch space
-    [Ha,P,Psi] = perform_lowdim_embedding(M(:,:,i),k,ndims,Vy,Vx);
+    [Ha,P,Psi] = perform_lowdim_embedding(Mi,k,ndims,Vy,Vx);
 
     % Compute the filtering
-    [M1(:,:,i),Wx,Wy] = nl_means_mex(M(:,:,i),Ha,Ha,Vx-1,Vy-1,T,max_dist, do_median, false, [], [], 0);
+    [M1(:,:,i),Wx,Wy] = nl_means_mex(Mi,Ha,Ha,Vx-1,Vy-1,T,max_dist, do_median, false, [], [], 0);
   end
 
   return;
@@ -97,43 +98,42 @@ function [H,P,Psi] = perform_lowdim_embedding(M,k,ndims, Vy, Vx)
 %   Copyright (c) 2006 Gabriel Peyr?
 
 mask = 'cst';
-phi = ones(2*k+1);
 
 [m,n,s] = size(M);
+ww = 2*k+1;
 
-% perform patch wise embedding
-s = size(M,3);
-% extract patches
-sampling = 'uniform';
-H = compute_patch_library(M,k,sampling, Vy, Vx);
-H = H .* repmat( phi, [1 1 s n*m] );
-% turn into collection of vectors
-H = reshape(H, [s*(2*k+1)^2 n*m]);
-
-ndims = min(ndims,size(H,1));
-
-% compute PCA projection
+% compute PCA projection, using only the patches of the exemplars
 nbexemplars = min(n*m,5000);
 sel = randperm(n*m);
 sel = sel(1:nbexemplars);
 
+H = compute_patch_library(M,k,Vy(sel),Vx(sel));
+% turn into collection of vectors
+H = reshape(H, [s*ww^2 nbexemplars]);
+
 %[P,X1,v,Psi] = mypca(H(:,sel),ndims);
-P = pca(H(:,sel).', 'Algorithm', 'eig');
+P = pca(H.', 'Algorithm', 'eig');
 
+ndims = min(ndims,size(P,2));
 P = P(:,1:ndims);
 Psi = [];
 
-ndims = size(P,2);
-% perform actual PCA projection
-%H = H - repmat( Psi, [1 n*m] );
-H = P'*H;
-% reshape matrix
-H = reshape(H, [ndims m n]);
-H = shiftdim(H,1);
+% perform actual PCA projection, one column of patches at a time to avoid
+% building the whole library
+if (exist('embed_patches_mex') == 3)
+  H = embed_patches_mex(M, k, P);
+
+% projecting the patches is equivalent to filtering the image with the basis
+else
+  H = zeros(m, n, ndims);
+  for d = 1:ndims
+    H(:,:,d) = imfilter(M, reshape(P(:,d), [ww ww]), 'symmetric');
+  end
+end
 return;
 end
 
-function [H] = compute_patch_library(M,w,sampling, Vy, Vx)
+function [H] = compute_patch_library(M,w,Vy,Vx)
 
 % [H,X,Y] = compute_patch_library(M,w,options);
 %
@@ -142,8 +142,8 @@ function [H] = compute_patch_library(M,w,sampling, Vy, Vx)
 %       has size (2*w+1,2*w+1,s) where s is the number of colors.
 %
 %   H(:,:,:,i) is the ith patch (can be a color patch).
-%   X(i) is the x location of H(:,:,:,i) in the image M.
-%   Y(i) is the y location of H(:,:,:,i) in the image M.
+%   Vx(i) is the x location of H(:,:,:,i) in the image M.
+%   Vy(i) is the y location of H(:,:,:,i) in the image M.
 %
 %   options.sampling can be set to 'random' or 'uniform'
 %   If options.sampling=='random' then you can define
@@ -167,7 +167,7 @@ function [H] = compute_patch_library(M,w,sampling, Vy, Vx)
 M = padarray(M,w([1 1]),'symmetric');
 
 ww = 2*w+1;
-p = n*m;
+p = numel(Vx);
 
 Y=Vy+w;
 X=Vx+w;
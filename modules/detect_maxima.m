@@ -30,23 +30,32 @@ function maxs = detect_maxima(imgs, window_size)
   mask = ones(2*window_size + 1);
   mask((end-1)/2+1) = 0;
 
+  % Check whether the MEX implementation is available
+  use_mex = (exist('detect_maxima_mex') == 3);
+
   % We iterate over the frames
   for i = 1:nframes
 
     % Get the current plane
     img = imgs(:, :, i);
 
-    % Get the local maxima
-    bw = (img >= imdilate(img, mask));
+    % The MEX function performs all the steps below in a single pass
+    if (use_mex)
+      estim_pos = detect_maxima_mex(img, window_size);
+
+    else
+      % Get the local maxima
+      bw = (img >= imdilate(img, mask));
 
-    % Shrink them to single pixel values
-    bw = bwmorph(bw, 'shrink', Inf);
+      % Shrink them to single pixel values
+      bw = bwmorph(bw, 'shrink', Inf);
 
-    % And get the list of candidates
-    [coord_y, coord_x] = find(bw);
+      % And get the list of candidates
+      [coord_y, coord_x] = find(bw);
 
-    % Invert to carthesian coordinates
-    estim_pos = [coord_x, coord_y];
+      % Invert to carthesian coordinates
+      estim_pos = [coord_x, coord_y];
+    end
 
     % And store the results
     maxs{i} = estim_pos;
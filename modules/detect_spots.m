@@ -63,6 +63,9 @@ function spots = detect_spots(imgs, thresh, max_size, intens_thresh)
     avgs = 1;
   end
 
+  % Check whether the MEX implementation is available
+  use_mex = (exist('detect_maxima_mex') == 3);
+
   % We iterate over the frames
   for i = 1:nframes
 
@@ -72,22 +75,28 @@ function spots = detect_spots(imgs, thresh, max_size, intens_thresh)
     % Performs the actual spot detection "a trous" algorithm [1]
     atrous = imatrou(img, max_size, thresh);
 
-    % Compute the local average
-    if (intens_thresh > 0)
-      avgs = imfilter(img, mask_avg);
-    end
+    % The MEX function performs all the steps below in a single pass
+    if (use_mex)
+      estim_pos = detect_maxima_mex(img, (tmp_size-1)/2, intens_thresh, atrous);
 
-    % Get the local maxima
-    bw = (atrous > 0) & (img >= imdilate(img, mask)) & (avgs >= intens_thresh);
+    else
+      % Compute the local average
+      if (intens_thresh > 0)
+        avgs = imfilter(img, mask_avg);
+      end
 
-    % Shrink them to single pixel values
-    bw = bwmorph(bw, 'shrink', Inf);
+      % Get the local maxima
+      bw = (atrous > 0) & (img >= imdilate(img, mask)) & (avgs >= intens_thresh);
 
-    % And get the list of candidates
-    [coord_y, coord_x] = find(bw);
+      % Shrink them to single pixel values
+      bw = bwmorph(bw, 'shrink', Inf);
 
-    % Invert to carthesian coordinates
-    estim_pos = [coord_x, coord_y];
+      % And get the list of candidates
+      [coord_y, coord_x] = find(bw);
+
+      % Invert to carthesian coordinates
+      estim_pos = [coord_x, coord_y];
+    end
 
     % And store the results
     spots{i} = estim_pos;
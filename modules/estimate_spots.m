@@ -108,6 +108,9 @@ function [gauss_params] = estimate_spots(imgs, estim_pos, wsize, thresh, niter,
   XZ = X .* Z;
   YZ = Y .* Z;
 
+  % Check whether the MEX implementation is available
+  use_mex = (exist('estimate_spots_mex') == 3);
+
   % Now loop over each plane of the stack
   for nimg = 1:p
 
@@ -118,30 +121,43 @@ function [gauss_params] = estimate_spots(imgs, estim_pos, wsize, thresh, niter,
     % Get the number of candidate positions
     nspots = size(curr_pos, 1);
 
-    % Initialize the parameter matrix
-    curr_params = NaN(nspots, 4);
-
-    % Now loop over all spots
-    for i=1:nspots
-      pos = curr_pos(i,:);
-
-      % Interpolate the sub-window
-      window = bilinear_mex(img, X+pos(1), Y+pos(2), false);
-
-      % We keep only the brightest pixels as suggested in [1].
-      goods = (window(:) > thresh);
+    % The MEX engine fits all the spots at once, in parallel
+    if (use_mex)
+      if (fit_intens)
+        curr_params = estimate_spots_mex(img, curr_pos, wsize, thresh, niter, stop, ...
+                                         weight, []);
+      else
+        curr_params = estimate_spots_mex(img, curr_pos, wsize, thresh, niter, stop, ...
+                                         weight, fit_full);
+      end
 
-      % Avoid empty windows
-      if (any(goods))
-        % Fit either a centered or a full symmetric 2d gaussian (or just the amplitude)
-        if (fit_full)
-          curr_params(i,:) = regress_2d_gaussian(window(goods), niter, ...
-                                                            weight, stop);
-        elseif (~fit_intens)
-          curr_params(i,:) = regress_2d_centered_gaussian(window(goods), ...
-                                                            niter, weight, stop);
-        else
-          curr_params(i,:) = regress_2d_amplitudes(window(goods), pos(3:end));
+    else
+      % Initialize the parameter matrix
+      curr_params = NaN(nspots, 4);
+
+      % Interpolate all the sub-windows at once
+      windows = bilinear_mex(img, X, Y, false, curr_pos);
+
+      % Now loop over all spots
+      for i=1:nspots
+        pos = curr_pos(i,:);
+        window = windows(:,:,i);
+
+        % We keep only the brightest pixels as suggested in [1].
+        goods = (window(:) > thresh);
+
+        % Avoid empty windows
+        if (any(goods))
+          % Fit either a centered or a full symmetric 2d gaussian (or just the amplitude)
+          if (fit_full)
+            curr_params(i,:) = regress_2d_gaussian(window(goods), niter, ...
+                                                              weight, stop);
+          elseif (~fit_intens)
+            curr_params(i,:) = regress_2d_centered_gaussian(window(goods), ...
+                                                              niter, weight, stop);
+          else
+            curr_params(i,:) = regress_2d_amplitudes(window(goods), pos(3:end));
+          end
         end
       end
     end
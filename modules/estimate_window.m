@@ -7,7 +7,15 @@ function params = estimate_window(imgs, estim_pos, wsize)
 %   PARAMS is a Nx(5+) matrix with rows corresponding to the following parameters:
 %     [center_x, center_y, width, (height), mean, standard_deviation, ...] where
 %     height can be ignored if the window is square, and where "..." refers to
-%     additional data from POS.
+%     additional data from POS. The mean is computed as by IMFILTER and the standard
+%     deviation as by STDFILT.
+%
+%   PARAMS = ESTIMATE_WINDOW(IMG, POS, WSIZES) uses a different window for each spot,
+%   WSIZES having one row per row of POS.
+%
+%   PARAMS = ESTIMATE_WINDOW(STACK, ...) estimates the windows in each plane
+%   separately, returning a cell vector of PARAMS. Note that POS (and WSIZES) should
+%   also be cell vectors corresponding to the planes of STACK.
 %
 % Gonczy & Naef labs, EPFL
 % Simon Blanchoud
@@ -29,27 +37,67 @@ function params = estimate_window(imgs, estim_pos, wsize)
   % Initialize the output
   params = cell(p, 1);
 
-  % Create a mask to compute the local statistics
-  mask = ones(2*wsize + 1);
-  navg = 1/numel(mask);
-
   % Now loop over each plane of the stack
   for nimg = 1:p
 
     % Extract the current image and positions
-    img = imgs(:,:,nimg);
+    img = double(imgs(:,:,nimg));
     curr_pos = estim_pos{nimg};
 
-    % Get the corresponding indexes
-    estim_pos = sub2ind([m,n], curr_pos(:,2), curr_pos(:,1));
+    % Get the number of candidate positions
+    nspots = size(curr_pos, 1);
+
+    % Get the size of the windows, common to all spots or not
+    if (iscell(wsize))
+      curr_size = wsize{nimg};
+    else
+      curr_size = wsize;
+    end
+    if (size(curr_size, 1) ~= nspots)
+      curr_size = repmat(curr_size(1,:), nspots, 1);
+    end
+
+    % The windows as half-open intervals of 0-based indexes, the sizes applying
+    % to the rows and the columns as in ones(2*wsize+1)
+    x = round(curr_pos(:,1));
+    y = round(curr_pos(:,2));
+    rows = [y - 1 - curr_size(:,1), y + curr_size(:,1)];
+    cols = [x - 1 - curr_size(:,end), x + curr_size(:,end)];
+    npix = (2*curr_size(:,1) + 1) .* (2*curr_size(:,end) + 1);
 
-    % Get the local statistics
-    local_mean = imfilter(img, mask*navg);
-    local_stds = stdfilt(img, mask);
+    % Missing and infinite values would spread through the summed-area tables, so
+    % we count them instead
+    invalids = ~isfinite(img);
+
+    % Center the image to preserve the precision of the tables
+    offset = mean(img(~invalids));
+    if (~isfinite(offset))
+      offset = 0;
+    end
+    img = img - offset;
+    img(invalids) = 0;
+
+    % The summed-area tables, with an additional row and column of zeros
+    sum_img = zeros(m+1, n+1);
+    sum_img(2:end, 2:end) = cumsum(cumsum(img, 1), 2);
+    sum_img2 = zeros(m+1, n+1);
+    sum_img2(2:end, 2:end) = cumsum(cumsum(img.^2, 1), 2);
+    sum_invalids = zeros(m+1, n+1);
+    sum_invalids(2:end, 2:end) = cumsum(cumsum(double(invalids), 1), 2);
+
+    % The local mean, with zero padding as imfilter
+    [local_mean, nclip] = clipped_sums(sum_img, rows, cols);
+    local_mean = (local_mean + offset*nclip) ./ npix;
+    local_mean(clipped_sums(sum_invalids, rows, cols) > 0) = NaN;
+
+    % The local standard deviation, with symmetric padding as stdfilt
+    local_stds = symmetric_sums(sum_img2, rows, cols) ./ (npix - 1) - ...
+                 symmetric_sums(sum_img, rows, cols).^2 ./ (npix .* (npix - 1));
+    local_stds(symmetric_sums(sum_invalids, rows, cols) > 0) = NaN;
+    local_stds = sqrt(max(local_stds, 0));
 
     % Store the properties of the windows
-    params{nimg} = [curr_pos(:,1:2) repmat(wsize, length(estim_pos), 1), ...
-                    local_mean(estim_pos) local_stds(estim_pos) curr_pos(:,3:end)];
+    params{nimg} = [curr_pos(:,1:2) curr_size local_mean local_stds curr_pos(:,3:end)];
   end
 
   % If we have only one plane, return the matrix alone
@@ -59,3 +107,80 @@ function params = estimate_window(imgs, estim_pos, wsize)
 
   return;
 end
+
+% Sums the summed-area table over the windows, the image being zero-padded as in
+% imfilter. NPIX is the number of pixels of the windows inside the image.
+function [sums, npix] = clipped_sums(table, rows, cols)
+
+  [h, w] = size(table);
+
+  % Clip the windows to the image
+  rows = min(max(rows, 0), h-1);
+  cols = min(max(cols, 0), w-1);
+  npix = (rows(:,2) - rows(:,1)) .* (cols(:,2) - cols(:,1));
+
+  % Indexes in the table
+  rows = rows + 1;
+  cols = cols + 1;
+
+  sums = table(sub2ind([h w], rows(:,2), cols(:,2))) - ...
+         table(sub2ind([h w], rows(:,1), cols(:,2))) - ...
+         table(sub2ind([h w], rows(:,2), cols(:,1))) + ...
+         table(sub2ind([h w], rows(:,1), cols(:,1)));
+
+  return;
+end
+
+% Sums the summed-area table over the windows, the image being padded symmetrically
+% as in stdfilt
+function sums = symmetric_sums(table, rows, cols)
+
+  sums = reflected_prefix(table, rows(:,2), cols(:,2)) - ...
+         reflected_prefix(table, rows(:,1), cols(:,2)) - ...
+         reflected_prefix(table, rows(:,2), cols(:,1)) + ...
+         reflected_prefix(table, rows(:,1), cols(:,1));
+
+  return;
+end
+
+% Sums the symmetrically padded image over the rows [0, t) and columns [0, u),
+% using a combination of at most four values of its summed-area table
+function sums = reflected_prefix(table, t, u)
+
+  [h, w] = size(table);
+
+  [tindx, tcoefs] = reflect_indexes(t, h-1);
+  [uindx, ucoefs] = reflect_indexes(u, w-1);
+
+  sums = zeros(size(t));
+  for i = 1:2
+    for j = 1:2
+      sums = sums + tcoefs(:,i) .* ucoefs(:,j) .* ...
+                    table(sub2ind([h w], tindx(:,i), uindx(:,j)));
+    end
+  end
+
+  return;
+end
+
+% Decomposes the sum of the first t values of a symmetrically padded line of n values
+% into a combination of sums of its first values, the padded line having a period of
+% 2n. INDX are the corresponding indexes in the summed-area table.
+function [indx, coefs] = reflect_indexes(t, n)
+
+  % The number of full periods and the remaining values
+  q = floor(t / (2*n));
+  r = t - q*2*n;
+
+  % Over the first half of the period, the values are in the original order
+  indx = [repmat(n+1, size(t)) r+1];
+  coefs = [2*q ones(size(t))];
+
+  % Over the second half, they are reflected
+  flip = (r > n);
+  indx(flip, 2) = 2*n - r(flip) + 1;
+  coefs(flip, 1) = 2*q(flip) + 2;
+  coefs(flip, 2) = -1;
+
+  return;
+end
@@ -11,8 +11,75 @@ function fused_spots = fuse_windows(spots, all_intensities, overlap_thresh)
 % Simon Blanchoud
 % 31.03.2015
 
+  % Group the overlapping spots, using a spatial grid when possible as the
+  % all-to-all comparison does not scale to large numbers of spots
+  if (exist('overlap_groups_mex') == 3)
+    groups = overlap_groups_mex(spots(:,1:2), spots(:,3:4), overlap_thresh);
+  else
+    groups = group_overlaps(spots, overlap_thresh);
+  end
+
+  % Sort the spots by group, keeping their order within each group. Spots which
+  % do not belong to any group (0) are discarded
+  [groups, indxs] = sort(groups);
+  indxs = indxs(groups > 0);
+  groups = groups(groups > 0);
+
+  % The range of spots of each group
+  ends = find(diff([groups; Inf]));
+  starts = [1; ends(1:end-1)+1];
+
+  % Prepare the output
+  fused_spots = NaN(length(ends), size(spots, 2));
+
+  % Loop over all groups to fuse their spots
+  for i = 1:length(ends)
+
+    % The current group
+    group = indxs(starts(i):ends(i));
+
+    % Fused with itself !
+    if (length(group) == 1)
+      fused_spots(i,:) = spots(group, :);
+
+    % Otherwise, need to create a new spot
+    else
+
+      % Get the spots to be fused
+      curr_spots = spots(group, :);
+
+      % Utilize the estimated signal for weighting the average
+      intensities = all_intensities(group);
+      intensities = intensities / sum(intensities);
+
+      % Compute the future position
+      target = bsxfun(@times, curr_spots(:,1:2), intensities);
+      target = sum(target, 1)/length(intensities);
+
+      % And their relative distance to the new position
+      center_dist = sqrt(sum(bsxfun(@minus, curr_spots(:,1:2), target).^2, 2));
+
+      % Gaussian-like distance kernel for weighting the average, weighted by the
+      % signal intensity once more
+      weights = exp(-center_dist ./ (2*mean(curr_spots(:, 3:4),2).^2));
+      weights = weights .* intensities;
+      weights = weights / sum(weights);
+
+      % Average and store the new spot
+      fused_spots(i,:) = sum(bsxfun(@times, curr_spots, weights), 1);
+    end
+  end
+
+  return;
+end
+
+% Groups the overlapping spots by comparing all of them, numbering the groups in
+% the order of their first spot and leaving the spots of no group to 0.
+function groups = group_overlaps(spots, overlap_thresh)
+
   % Prepare the output
-  fused_spots = NaN(0, size(spots, 2));
+  groups = zeros(size(spots, 1), 1);
+  ngroups = 0;
 
   % We first need to determine the all-to-all distance
   distx = abs(bsxfun(@minus, spots(:,1), spots(:,1).'));
@@ -30,58 +97,29 @@ function fused_spots = fuse_windows(spots, all_intensities, overlap_thresh)
   for i = 1:size(spots, 1)
 
     % Get the list of fusion required with the current spot
-    groups = fused(:,i);
-    prev_groups = false(size(groups));
+    group = fused(:,i);
+    prev_group = false(size(group));
 
     % Now loop to include all spots which need to be fused together in a chain-like
     % structure. In the worst case, we need to loop over all spots once.
     for j = 1:size(spots, 1)
 
       % Check for convergeance
-      if (~any(xor(groups, prev_groups)))
+      if (~any(xor(group, prev_group)))
         break;
       else
-        prev_groups = groups;
-        groups = any(fused(:, groups), 2);
+        prev_group = group;
+        group = any(fused(:, group), 2);
       end
     end
 
     % No group could exist if the current spots as already been fused
-    if (any(groups))
-
-      % Fused with itself !
-      if (sum(groups) == 1)
-        fused_spots = [fused_spots; spots(groups, :)];
-
-      % Otherwise, need to create a new spot
-      else
-
-        % Get the spots to be fused
-        curr_spots = spots(groups, :);
-
-        % Utilize the estimated signal for weighting the average
-        intensities = all_intensities(groups);
-        intensities = intensities / sum(intensities);
-
-        % Compute the future position
-        target = bsxfun(@times, curr_spots(:,1:2), intensities);
-        target = sum(target, 1)/length(intensities);
-
-        % And their relative distance to the new position
-        center_dist = sqrt(sum(bsxfun(@minus, curr_spots(:,1:2), target).^2, 2));
-
-        % Gaussian-like distance kernel for weighting the average, weighted by the
-        % signal intensity once more
-        weights = exp(-center_dist ./ (2*mean(curr_spots(:, 3:4),2).^2));
-        weights = weights .* intensities;
-        weights = weights / sum(weights);
-
-        % Average and store the new spot
-        fused_spots = [fused_spots; sum(bsxfun(@times, curr_spots, weights), 1)];
-      end
+    if (any(group))
+      ngroups = ngroups + 1;
+      groups(group) = ngroups;
 
       % Remove the fused spots from the list
-      fused(:, groups) = false;
+      fused(:, group) = false;
     end
   end
 
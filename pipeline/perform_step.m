@@ -172,10 +172,10 @@ function [varargout] = perform_step(cast_step, segment_type, varargin)
       % The various approaches
       switch segment_type
         case 'multiscale_gaussian_spots'
-          % We take advantage of the GaussMask2D library function for that !
-          draw = @(params,ssize)(GaussMask2D(params(3), ssize, params([2 1]), 0, 1) * params(4));
+          % The spots are drawn as in the GaussMask2D library function
+          draw = 'gaussian';
         case 'rectangular_local_maxima'
-          draw = @draw_window;
+          draw = 'window';
         otherwise
           draw = [];
           spots = [];
@@ -10,6 +10,12 @@ function detected = reconstruct_detection(imgs, spots, draw)
 %   using the detected SPOTS_GROUPS, organized in a cell vector with the same length as the
 %   number of planes in IMGS.
 %
+%   RIMGS = RECONSTRUCT_DETECTION(..., SHAPE) draws the spots using one of the
+%   following predefined shapes, which are splatted onto their local footprint
+%   only, in parallel over the planes, when reconstruct_detection_mex is available:
+%     - 'gaussian'  spots defined as [X Y SIGMA AMPLITUDE], as drawn by GaussMask2D
+%     - 'window'    spots defined as [X Y WIDTH HEIGHT MEAN], as drawn by draw_window
+%
 % Gonczy & Naef labs, EPFL
 % Simon Blanchoud
 % 07.07.2014
@@ -33,6 +39,26 @@ function detected = reconstruct_detection(imgs, spots, draw)
     return;
   end
 
+  % The predefined shapes
+  if (ischar(draw))
+    is_window = strncmp(draw, 'window', 6);
+
+    % Draw only the footprints of the spots, in C
+    if (exist('reconstruct_detection_mex') == 3)
+      detected = reconstruct_detection_mex(size_img, spots, is_window);
+      detected = cast(detected, class(imgs));
+
+      return;
+    end
+
+    % Otherwise, use the corresponding drawing functions
+    if (is_window)
+      draw = @draw_window;
+    else
+      draw = @(params,ssize)(GaussMask2D(params(3), ssize, params([2 1]), 0, 1) * params(4));
+    end
+  end
+
   % The temporary plane
   zero = zeros(size_img);
 
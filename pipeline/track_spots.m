@@ -191,6 +191,19 @@ function [links, opts] = track_spots(spots, funcs, max_move, max_gap, max_dist,
     return;
   end
 
+  % Use the native LAP solver if it has been compiled, it provides the same assignments
+  if (exist('lapjv_sparse_mex') == 3)
+    lap_solver = @lapjv_sparse_mex;
+  else
+    lap_solver = @lapjv_fast_sparse;
+  end
+
+  % If available, solve directly the rectangular problems with alternative costs
+  % instead of building the doubled matrices of [1]
+  use_alternative_lap = (exist('lap_alternative_sparse_mex') == 3);
+  use_batch_linking = (use_alternative_lap && exist('link_frames_mex') == 3 && ...
+                       strcmp(func2str(frame_linking_weight), 'linking_cost_sparse_mex'));
+
   % If we have a way to compute the intensity, do it !
   intensity_func = weighting_funcs{1};
   if (~isempty(intensity_func))
@@ -208,97 +221,31 @@ function [links, opts] = track_spots(spots, funcs, max_move, max_gap, max_dist,
     waitbar(0, hwait, ['Linking spots between consecutive frames...']);
   end
 
-  % Initialize some variables for the frame to frame to operate properly, at frame 1
-  % there is nothing before that so both are empty for now on
-  pts = [];
-  npts = 0;
-
-  % We store all assignments as we need them later to compute the average distance
-  all_assign = [];
-
-  % Loop over all frames forward
-  for i = 1:nframes
-
-    % Store the previous data
-    prev_pts = pts;
-    prev_npts = npts;
-
-    % And load the current data
-    pts = spots{i};
-    npts = size(pts, 1);
-
-    % Add two empty columns at the end of the array to simulate the indexes used later
-    pts = [pts zeros(npts, 2)];
-
-    % If one of the two is empty, no linking will happen
-    if (prev_npts > 0 && npts > 0)
+  % When using the default cost function, all frames can be linked at once, in parallel
+  if (use_batch_linking)
+    [links, all_assign] = link_frames_mex(spots, max_move, max_ratio);
+  else
 
-      % Get the spot-to-spot cost matrix for linking them
-      mutual_dist = frame_linking_weight(prev_pts, pts, max_move, max_ratio);
+    % We store all assignments as we need them later to compute the average distance
+    all_assign = [];
 
-      % Get the data from the resulting sparse matrix
-      [indxi, indxj, vals] = get_sparse_data_mex(mutual_dist);
+    % Loop over all frames forward
+    for i = 1:nframes
 
-      % Use some default values if no linkin is possible
-      if (isempty(vals))
-        curr_max = 1;
-        min_dist = 1;
+      % Link the current frame to the previous one
+      if (i > 1)
+        [links{i}, assign_dist] = link_consecutive_frames(spots{i-1}, spots{i}, i, ...
+                                          frame_linking_weight, max_move, max_ratio, ...
+                                          lap_solver, use_alternative_lap);
+        all_assign = [all_assign; assign_dist];
       else
-        curr_max = max(vals);
-        min_dist = min(vals);
+        links{i} = NaN(0, 3);
       end
 
-      % Build the data requried for the no-linking parts of the matrix [1]
-      ends_indx = [1:max(npts,prev_npts)].';
-      ends = ones(size(ends_indx))*curr_max;
-
-      % No build the full indexes for the final sparse matrix
-      indxii = [indxi; ...                         % Linking
-                ends_indx(1:prev_npts); ...        % End of a track
-                ends_indx(1:npts)+prev_npts; ...   % Start of a track
-                indxj+prev_npts];                  % Requried for symmetry
-
-      % Same for the other matrix indexes
-      indxj = [indxj; ends_indx(1:prev_npts)+npts; ends_indx(1:npts); indxi+npts];
-
-      % And the corresponding values
-      vals = [vals; ends(1:prev_npts); ends(1:npts); ones(size(vals))*min_dist];
-
-      % Now build the full sparse matrix using only the requried number of values
-      dist = sparse(indxii, indxj, vals, npts + prev_npts, npts + prev_npts, ...
-                    length(vals));
-
-      % And solve this using this alternative implementation of the Hungarian algorithm
-      [assign, cost] = lapjv_fast_sparse(dist);
-
-      % Keep only the relevant part of the assignments (others are required for symmetry)
-      assign = assign(1:prev_npts);
-
-      % And keep only the ones representing a link
-      indxs = 1:length(assign);
-      good_indx = (assign <= npts);
-      assign = assign(good_indx);
-      indxs = indxs(good_indx);
-
-      % Extract the corresponding costs for later use
-      assign_dist = dist(sub2ind(size(dist),indxs,assign));
-      all_assign = [all_assign; assign_dist(:)];
-
-      % Invert the assignment indexes as we store next -> prev links
-      [assign, perms] = sort(assign(:));
-
-      % And store everything
-      links{i} = [assign indxs(perms).' (i-ones(length(assign), 1))];
-    end
-
-    % Still store something to avoid errors later when accessing columns
-    if (isempty(links{i}))
-      links{i} = NaN(0, 3);
-    end
-
-    % Update the progress bar
-    if (do_display)
-      waitbar(i/nframes,hwait);
+      % Update the progress bar
+      if (do_display)
+        waitbar(i/nframes,hwait);
+      end
     end
   end
 
@@ -469,148 +416,17 @@ function [links, opts] = track_spots(spots, funcs, max_move, max_gap, max_dist,
       waitbar(0, hwait, ['Assigning bridging/splitting/merging of tracks... (please wait)']);
     end
 
-    % Get the final number of spots
-    nstarts = size(starts, 1);
-    nends = size(ends, 1);
-    ninterm = size(interm, 1);
-
-    % Compute the bridging costs
-    if (tracking_options(1))
-      mutual_dist = closing_weight(ends, starts, max_move, max_gap, max_dist, max_ratio);
-    else
-      mutual_dist = sparse(nends, nstarts);
-    end
-
-    if (do_display)
-      waitbar(1/6,hwait);
-    end
-
-    % The merging costs, we also need an alternative costs vector [1]
-    if (tracking_options(2))
-      [merge_weight, alt_merge_weight] = joining_weight(ends, interm, max_move, branching_gap, max_ratio, avg_movement, spots, links);
-    else
-      merge_weight = sparse(nends, ninterm);
-      alt_merge_weight = ones(ninterm, 1);
-    end
-
-    if (do_display)
-      waitbar(2/6,hwait);
-    end
-
-    % And the splitting costs, including the alternative costs vector
-    if (tracking_options(3))
-      [split_weight, alt_split_weight] = splitting_weight(starts, interm, max_move, branching_gap, max_ratio, avg_movement, spots, links);
-    else
-      split_weight = sparse(ninterm, nstarts);
-      alt_split_weight = ones(ninterm, 1);
-    end
-
-    if (do_display)
-      waitbar(3/6,hwait);
-    end
-
-    % Now build the full matrix [1]
-    % Note that end-end merging and start-start splitting is not allowed by this
-    % algorithm, which makes sense...
-
-    % Get the individual indexes and values from the different sparse matrices, and
-    % concatenate them into one single list.
-
-    % Bridging is the top left matrix
-    [indxi, indxj, vals] = get_sparse_data_mex(mutual_dist);
-    all_indxi = indxi;
-    all_indxj = indxj;
-    all_vals = vals;
-
-    % Merging is shifted on the right, after the bridging one
-    [indxi, indxj, vals] = get_sparse_data_mex(merge_weight);
-    all_indxi = [all_indxi; indxi];
-    all_indxj = [all_indxj; indxj+nstarts];
-    all_vals = [all_vals; vals];
-
-    % While splitting it under the bridging one
-    [indxi, indxj, vals] = get_sparse_data_mex(split_weight);
-    all_indxi = [all_indxi; indxj+nends];
-    all_indxj = [all_indxj; indxi];
-    all_vals = [all_vals; vals];
-
-    if (do_display)
-      waitbar(4/6,hwait);
-    end
-
-    % We need to extract the cost for no linking
-    if (isempty(all_vals))
-      alt_cost = 1;
-      min_dist = 0.1;
-    else
-      alt_cost = prctile(all_vals, 90) * 0.999;
-      min_dist = min(all_vals);
+    % Solve the assignment problem
+    if (~do_display)
+      hwait = [];
     end
+    new_links = close_track_gaps(ends, starts, interm, weighting_funcs(3:5), tracking_options, ...
+                                 max_move, max_gap, branching_gap, max_dist, max_ratio, ...
+                                 avg_movement, spots, links, hwait);
 
-    % Build a generic vector for these parts of the matrix
-    alt_indx = [1:max(max(nends,nstarts),ninterm)].';
-    alt_dist = ones(size(alt_indx))*alt_cost;
-
-    % Now build the full array of indexes
-    all_indxii = [all_indxi; ...                                 % Bridging/Merging/Splitting
-                  alt_indx(1:nends); ...                         % No gap, "d" in [1]
-                  alt_indx(1:nstarts)+nends+ninterm; ...         % No gap, "b" in [1]
-                  alt_indx(1:ninterm)+nends; ...                 % No splitting, "d'" in [1]
-                  alt_indx(1:ninterm)+nends+nstarts+ninterm; ... % No merging, "b'" [1]
-                  all_indxj+nends+ninterm];                      % The lower right block, for symmetry
-
-    % Same for the second coordinate
-    all_indxj = [all_indxj; ...
-                 alt_indx(1:nends)+nstarts+ninterm; ...
-                 alt_indx(1:nstarts); ...
-                 alt_indx(1:ninterm)+nstarts+ninterm+nends; ...
-                 alt_indx(1:ninterm)+nstarts; ...
-                 all_indxi+nstarts+ninterm];
-
-    % And the corresponding values
-    all_vals = [all_vals; ...
-                alt_dist(1:nends); ...
-                alt_dist(1:nstarts); ...
-                alt_split_weight; ...
-                alt_merge_weight; ...
-                ones(size(all_vals))*min_dist];
-
-    % Finally, build the whole sparse matrix
-    dist = sparse(all_indxii, all_indxj, all_vals, nstarts + nends + 2*ninterm, ...
-                  nstarts + nends + 2*ninterm, length(all_vals));
-
-    if (do_display)
-      waitbar(5/6,hwait);
-    end
-
-    % And solve it !
-    [assign, cost] = lapjv_fast_sparse(dist);
-
-    % Identify the type of assignment chosen
-    for i=1:nends+ninterm
-
-      % Bridging/Splitting
-      if (assign(i) <= nstarts)
-        target = starts(assign(i), :);
-
-      % Merging
-      elseif (assign(i) < nstarts + ninterm)
-        target = interm(assign(i) - nstarts, :);
-      else
-        continue;
-      end
-
-      % Bridging
-      if (i <= nends)
-        reference = ends(i,:);
-
-      % Splitting
-      else
-        reference = interm(i-nends,:);
-      end
-
-      % Update the link list accordingly
-      links{target(end)} = [links{target(end)}; [target(end-1), reference(end-1:end)]];
+    % Update the link list accordingly
+    for i=1:size(new_links, 1)
+      links{new_links(i,1)} = [links{new_links(i,1)}; new_links(i,2:end)];
     end
   end
 
@@ -0,0 +1,367 @@
+function [tracker, spots, links, frames] = track_spots_online(tracker, varargin)
+% TRACK_SPOTS_ONLINE tracks spots frame by frame, keeping only a bounded window of
+% frames in memory.
+%
+%   TRACKER = TRACK_SPOTS_ONLINE(FUNCS, MAX_MOVEMENT, MAX_GAP_LENGTH, MAX_DIST, ...
+%   MIN_SECTION_LENGTH, MAX_RATIO, ALLOW_BRANCHING_GAP) creates a new TRACKER using
+%   the cost functions FUNCS and the parameters of track_spots.m, with the same
+%   default values for the missing ones.
+%
+%   TRACKER = TRACK_SPOTS_ONLINE(OPTS) extracts the corresponding parameter values
+%   from OPTS.spot_tracking, as track_spots.m does.
+%
+%   [TRACKER, SPOTS, LINKS, FRAMES] = TRACK_SPOTS_ONLINE(TRACKER, NEW_SPOTS) links
+%   the NEW_SPOTS detected in the next frame to the previous one, and closes the
+%   gaps, merges and splits the tracks ending in the oldest frame of the window.
+%   This frame is then final and returned in SPOTS, along with its LINKS, FRAMES
+%   being its index in the recording. SPOTS, LINKS and FRAMES have the same format
+%   as in track_spots.m but only contain the frames finalized by this call, which
+%   are MAX_GAP_LENGTH+2 frames behind the last one provided.
+%
+%   [TRACKER, SPOTS, LINKS, FRAMES] = TRACK_SPOTS_ONLINE(TRACKER) finalizes all the
+%   frames remaining in the window, once the recording is over.
+%
+%   The frame-to-frame linking and the cost functions are the ones of track_spots.m.
+%   However, the gap closing problem is only solved over the frames of the window,
+%   and only the assignments of the tracks ending in its oldest frame are kept, all
+%   the candidates of these tracks being known at that point. Consequently, the
+%   cost for no linking is computed over the window, and the average movement over
+%   the frames provided so far. Sections shorter than MIN_SECTION_LENGTH are excluded
+%   from the gap closing as filter_tracking.m measures them, except for the ones
+%   still being tracked which are always considered. These are not removed from
+%   SPOTS, which can be done afterwards using filter_tracking.m.
+%
+% References:
+%   [1] Jaqaman K, Loerke D, Mettlen M, Kuwata H, Grinstein S, et al. Robust
+%       single-particle tracking in live-cell time-lapse sequences. Nat Methods 5:
+%       695-702 (2008).
+
+  % Input checking
+  if (nargin < 1)
+    error('CAST:track_spots_online', 'Not enough parameters provided (min=1)');
+  end
+
+  % Nothing is finalized by default
+  spots = cell(0, 1);
+  links = cell(0, 1);
+  frames = zeros(0, 1);
+
+  % Create a new tracker
+  if (~isstruct(tracker) || isfield(tracker, 'spot_tracking'))
+    tracker = init_tracker(tracker, varargin{:});
+
+    return;
+  end
+
+  % Either we get a new frame, and the oldest one of the window gets finalized
+  if (~isempty(varargin))
+    tracker = add_frame(tracker, varargin{1});
+    last = tracker.nframes - tracker.max_gap - 1;
+
+  % Or the recording is over and all the remaining ones are final
+  else
+    last = tracker.nframes;
+  end
+
+  % Finalize the frames in order
+  for i = tracker.nfinal+1:last
+    [tracker, spots{end+1,1}, links{end+1,1}] = finalize_frame(tracker, isempty(varargin));
+    frames(end+1,1) = i;
+  end
+
+  return;
+end
+
+% Creates the structure storing the parameters and the state of the tracker
+function tracker = init_tracker(funcs, max_move, max_gap, max_dist, min_length, max_ratio, allow_branching_gap)
+
+  % Check whether we got the options structure
+  if (isstruct(funcs))
+    opts = funcs;
+
+    % Get the function handlers and the parameters as track_spots does
+    tracker = init_tracker({'', ...
+                            opts.spot_tracking.linking_function, ...
+                            opts.spot_tracking.bridging_function, ...
+                            opts.spot_tracking.joining_function, ...
+                            opts.spot_tracking.splitting_function}, ...
+              opts.time_interval*opts.spot_tracking.spot_max_speed/opts.pixel_size, ...
+              opts.spot_tracking.bridging_max_gap, ...
+              opts.spot_tracking.bridging_max_dist/opts.pixel_size, ...
+              opts.spot_tracking.min_section_length, ...
+              opts.spot_tracking.max_intensity_ratio, ...
+              opts.spot_tracking.allow_branching_gap);
+
+    return;
+  end
+
+  % The default values of track_spots
+  if (nargin < 2)
+    max_move = Inf;
+  end
+  if (nargin < 3)
+    max_gap = 5;
+  end
+  if (nargin < 4)
+    max_dist = Inf;
+  end
+  if (nargin < 5)
+    min_length = 0;
+  end
+  if (nargin < 6)
+    max_ratio = Inf;
+  end
+  if (nargin < 7)
+    allow_branching_gap = false;
+  end
+
+  % For conveniance, always work with cell vector
+  if (~iscell(funcs))
+    funcs = {funcs};
+  end
+
+  % Create empty function handlers in case not enough where provided
+  weighting_funcs = cell(5, 1);
+  weighting_funcs(1:min(length(funcs), end)) = funcs(1:min(5, end));
+
+  % Make sure we at least got this handler !
+  frame_linking_weight = weighting_funcs{2};
+  if (isempty(frame_linking_weight) || isempty(frame_linking_weight(1, 1, 1, 1)))
+    error('CAST:track_spots_online', 'No valid frame to frame weighting function provided');
+  end
+
+  % Because the gap links two frames ...
+  branching_gap = max_gap*allow_branching_gap + 1;
+  max_gap = max_gap + 1;
+
+  % Check if we need to skip some functionalities
+  closing_weight = weighting_funcs{3};
+  joining_weight = weighting_funcs{4};
+  splitting_weight = weighting_funcs{5};
+  tracking_options = ~[isempty(closing_weight) || max_gap<2 || isempty(closing_weight(1, 1, 1, 1, 1, 1)), ...
+                       isempty(joining_weight) || isempty(joining_weight(1, 1, 1, 1)), ...
+                       isempty(splitting_weight) || isempty(splitting_weight(1, 1, 1, 1))];
+
+  % The parameters
+  tracker = struct();
+  tracker.funcs = weighting_funcs;
+  tracker.max_move = max_move;
+  tracker.max_gap = max_gap;
+  tracker.branching_gap = branching_gap;
+  tracker.max_dist = max_dist;
+  tracker.min_length = min_length;
+  tracker.max_ratio = max_ratio;
+  tracker.tracking_options = tracking_options;
+
+  % The solvers, as in track_spots
+  if (exist('lapjv_sparse_mex') == 3)
+    tracker.lap_solver = @lapjv_sparse_mex;
+  else
+    tracker.lap_solver = @lapjv_fast_sparse;
+  end
+  tracker.use_alternative_lap = (exist('lap_alternative_sparse_mex') == 3);
+
+  % The number of frames provided and finalized so far, and the index of the
+  % first frame of the window
+  tracker.nframes = 0;
+  tracker.nfinal = 0;
+  tracker.first = 1;
+
+  % The running sum of the frame-to-frame linking costs
+  tracker.sum_dists = 0;
+  tracker.ndists = 0;
+
+  % The window itself: the spots, the frame-to-frame links, the links closing the
+  % gaps, the number of frames tracked before each spot, and the spots already
+  % targeted by a gap closing link
+  tracker.spots = cell(0, 1);
+  tracker.links = cell(0, 1);
+  tracker.closures = cell(0, 1);
+  tracker.path_length = cell(0, 1);
+  tracker.claimed = cell(0, 1);
+
+  return;
+end
+
+% Adds a new frame to the window, linking it to the previous one
+function tracker = add_frame(tracker, pts)
+
+  % If we have a way to compute the intensity, do it !
+  intensity_func = tracker.funcs{1};
+  if (~isempty(intensity_func))
+    pts = [pts intensity_func(pts)];
+  end
+
+  % The position in the window
+  tracker.nframes = tracker.nframes + 1;
+  curr = tracker.nframes - tracker.first + 1;
+  npts = size(pts, 1);
+
+  % Link it to the previous frame
+  if (curr > 1)
+    [curr_links, dists] = link_consecutive_frames(tracker.spots{curr-1}, pts, tracker.nframes, ...
+                                  tracker.funcs{2}, tracker.max_move, tracker.max_ratio, ...
+                                  tracker.lap_solver, tracker.use_alternative_lap);
+
+    % Keep track of the average movement
+    dists = dists(isfinite(dists));
+    tracker.sum_dists = tracker.sum_dists + sum(dists);
+    tracker.ndists = tracker.ndists + length(dists);
+  else
+    curr_links = NaN(0, 3);
+  end
+
+  % Count the length of the paths as filter_tracking does
+  path_length = zeros(npts, 1);
+  if (~isempty(curr_links))
+    prev_length = tracker.path_length{curr-1};
+    path_length(curr_links(:,1)) = prev_length(curr_links(:,2)) + 1;
+  end
+
+  % And store everything
+  tracker.spots{curr,1} = pts;
+  tracker.links{curr,1} = curr_links;
+  tracker.closures{curr,1} = NaN(0, 3);
+  tracker.path_length{curr,1} = path_length;
+  tracker.claimed{curr,1} = false(npts, 1);
+
+  return;
+end
+
+% Closes the gaps of the tracks ending in the oldest frame of the window which is not
+% final yet, and returns the then final frame. IS_OVER states that no more frame
+% will be provided.
+function [tracker, spots, links] = finalize_frame(tracker, is_over)
+
+  % The frames are numbered relatively to the window, as the cost functions only
+  % need the spots and links of the window
+  offset = tracker.first - 1;
+  nwindow = tracker.nframes - offset;
+  ripe = tracker.nfinal + 1 - offset;
+
+  % Maybe skip the whole assignment part
+  if (any(tracker.tracking_options) && tracker.nframes > 2)
+
+    % The total length of the sections, the ones still tracked being always kept
+    section_length = tracker.path_length(1:nwindow);
+    if (~is_over)
+      section_length{nwindow}(:) = Inf;
+    end
+    for i = nwindow:-1:2
+      curr_links = tracker.links{i};
+      section_length{i-1}(curr_links(:,2)) = section_length{i}(curr_links(:,1));
+    end
+
+    % The window with the frames renumbered
+    win_spots = tracker.spots(1:nwindow);
+    win_links = tracker.links(1:nwindow);
+    for i = 1:nwindow
+      win_links{i}(:,3) = win_links{i}(:,3) - offset;
+    end
+
+    % We need to build several lists for bridging/merging/splitting, using all the
+    % spots of the window that are not final yet
+    ndim = -1;
+    for i = ripe:nwindow
+      if (~isempty(win_spots{i}))
+        ndim = size(win_spots{i}, 2);
+        break;
+      end
+    end
+    starts = zeros(0, ndim+2);
+    ends = zeros(0, ndim+2);
+    interm = zeros(0, ndim+2);
+    can_merge = false(0, 1);
+
+    for i = ripe:nwindow
+      npts = size(win_spots{i}, 1);
+      if (npts == 0)
+        continue;
+      end
+
+      % The connections of the spots
+      has_prev = false(npts, 1);
+      has_prev(win_links{i}(:,1)) = true;
+      has_next = false(npts, 1);
+      if (i < nwindow)
+        has_next(win_links{i+1}(:,2)) = true;
+      end
+
+      % Keep only the long enough sections
+      is_long = (section_length{i} > tracker.min_length);
+
+      % End points are spots not linked to any spot in the next frame
+      if (i < nwindow)
+        indx_ends = find(~has_next & is_long);
+        ends = [ends; win_spots{i}(indx_ends,:) indx_ends ones(size(indx_ends))*i];
+      end
+
+      % Start spots do not connect to any previous spot, nor did they receive a gap
+      % closing link from a finalized frame
+      if (i > ripe)
+        indx_starts = find(~has_prev & ~tracker.claimed{i} & is_long);
+        starts = [starts; win_spots{i}(indx_starts,:) indx_starts ones(size(indx_starts))*i];
+      end
+
+      % And intermediate spots are connected on both sides
+      if (any(tracker.tracking_options(2:3)) && i < nwindow)
+        indx_interm = find(has_prev & has_next & is_long);
+        interm = [interm; win_spots{i}(indx_interm,:) indx_interm ones(size(indx_interm))*i];
+        can_merge = [can_merge; ~tracker.claimed{i}(indx_interm)];
+      end
+    end
+
+    % Keep only the intermediate spots which could be either merging points or
+    % splitting points, as track_spots does
+    good_interm = false(size(interm, 1), 1);
+    if (tracker.tracking_options(2))
+      can_join = tracker.funcs{4}(ends, interm, tracker.max_move, tracker.branching_gap);
+      good_interm = good_interm | can_join(:);
+    end
+    if (tracker.tracking_options(3))
+      can_split = tracker.funcs{5}(starts, interm, tracker.max_move, tracker.branching_gap);
+      good_interm = good_interm | can_split(:);
+    end
+    interm = interm(good_interm, :);
+    can_merge = can_merge(good_interm);
+
+    % Solve the assignment over the whole window
+    if (size(ends, 1) + size(interm, 1) > 0)
+      avg_movement = tracker.sum_dists / tracker.ndists;
+      new_links = close_track_gaps(ends, starts, interm, tracker.funcs(3:5), tracker.tracking_options, ...
+                                   tracker.max_move, tracker.max_gap, tracker.branching_gap, ...
+                                   tracker.max_dist, tracker.max_ratio, avg_movement, ...
+                                   win_spots, win_links, [], can_merge);
+
+      % But keep only the links of the tracks ending in the oldest frame
+      new_links = new_links(new_links(:,4) == ripe, :);
+      for i = 1:size(new_links, 1)
+        target = new_links(i,1);
+        tracker.closures{target} = [tracker.closures{target}; ...
+                                    new_links(i,2:3) new_links(i,4)+offset];
+        tracker.claimed{target}(new_links(i,2)) = true;
+      end
+    end
+  end
+
+  % The frame is now final
+  spots = tracker.spots{ripe};
+  links = [tracker.links{ripe}; tracker.closures{ripe}];
+  tracker.nfinal = tracker.nfinal + 1;
+
+  % If we had a way to compute the intensity, we need to remove it now
+  if (~isempty(tracker.funcs{1}))
+    spots = spots(:, 1:end-1);
+  end
+
+  % Keep only the last final frame, required for the signal of its next spots
+  ndrop = ripe - 1;
+  tracker.spots(1:ndrop) = [];
+  tracker.links(1:ndrop) = [];
+  tracker.closures(1:ndrop) = [];
+  tracker.path_length(1:ndrop) = [];
+  tracker.claimed(1:ndrop) = [];
+  tracker.first = tracker.first + ndrop;
+
+  return;
+end